@@ -0,0 +1,202 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "carboncyclebatch.h"
+
+#include "model.h"
+#include "resourceunit.h"
+#include "soil.h"
+#include "snag.h"
+#include "threadrunner.h"
+
+struct CarbonCycleBlock {
+    CarbonCycleBatch *batch;
+    int begin;
+    int end;
+};
+
+/// pass 1: snag dynamics and soil inputs
+static void nc_snagDynamics(ResourceUnit *unit)
+{
+    try {
+        unit->calculateSnagDynamics();
+    } catch (const IException& e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
+/// pass 3: available nitrogen and debug outputs
+static void nc_finalizeCarbonCycle(ResourceUnit *unit)
+{
+    if (!unit->snag())
+        return;
+    try {
+        unit->finalizeCarbonCycle();
+    } catch (const IException& e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
+void CarbonCycleBatch::calculateYear(const QList<ResourceUnit *> &ru_list)
+{
+    Model *model = GlobalSettings::instance()->model();
+
+    // (1) snag dynamics (per resource unit)
+    model->threadExec().run(nc_snagDynamics);
+    model->threadExec().checkErrors();
+
+    // (2) update of the soil pools in blocks of resource units
+    mSoils.clear();
+    foreach(ResourceUnit *ru, ru_list)
+        if (ru->snag() && ru->soil())
+            mSoils.push_back(ru->soil());
+    const int n = mSoils.size();
+    QVector<double>* arrays[] = { &mInLabC, &mInLabN, &mInRefC, &mInRefN, &mRE, &mKyl, &mKyr, &mKo, &mH,
+                                  &mYLC, &mYLN, &mYRC, &mYRN, &mSOMC, &mSOMN, &mFluxC, &mFluxN,
+                                  &mNavLab, &mNavRef, &mNavSOM };
+    for (QVector<double> *a : arrays)
+        a->resize(n);
+
+    QVector<CarbonCycleBlock> blocks;
+    for (int i=0;i<n;i+=cBlockSize) {
+        CarbonCycleBlock b = { this, i, std::min(i+cBlockSize, n) };
+        blocks.push_back(b);
+    }
+    model->threadExec().run(calculateBlock, blocks);
+    model->threadExec().checkErrors();
+
+    // (3) available nitrogen, debug outputs (per resource unit)
+    model->threadExec().run(nc_finalizeCarbonCycle);
+}
+
+void CarbonCycleBatch::calculateBlock(CarbonCycleBlock &block)
+{
+    CarbonCycleBatch &b = *block.batch;
+    const SoilParams &sp = *Soil::mParams;
+    const int begin = block.begin;
+    const int end = block.end;
+
+    // gather: copy the state of the soils to the arrays
+    for (int i=begin;i<end;++i) {
+        const Soil *s = b.mSoils[i];
+        if (s->mRE==0.) {
+            GlobalSettings::instance()->model()->threadExec().throwError("Soil::calculateYear(): Invalid value for 're' (=0) for RU(index): " + QString::number(s->mRU->index()));
+            return;
+        }
+        if (isnan(s->mInputLab.C + s->mInputRef.C) || isnan(s->mKyr))
+            qDebug() << "soil input is NAN.";
+        b.mInLabC[i] = s->mInputLab.C; b.mInLabN[i] = s->mInputLab.N;
+        b.mInRefC[i] = s->mInputRef.C; b.mInRefN[i] = s->mInputRef.N;
+        b.mRE[i] = s->mRE; b.mKyl[i] = s->mKyl; b.mKyr[i] = s->mKyr; b.mKo[i] = s->mKo; b.mH[i] = s->mH;
+        b.mYLC[i] = s->mYL.C; b.mYLN[i] = s->mYL.N;
+        b.mYRC[i] = s->mYR.C; b.mYRN[i] = s->mYR.N;
+        b.mSOMC[i] = s->mSOM.C; b.mSOMN[i] = s->mSOM.N;
+    }
+
+    // update of the state variables: same equations (and order of operations) as in Soil::calculateYear()
+    const double t = 1.; // timestep (annual)
+    const double *in_lab_c = b.mInLabC.constData(), *in_lab_n = b.mInLabN.constData();
+    const double *in_ref_c = b.mInRefC.constData(), *in_ref_n = b.mInRefN.constData();
+    const double *re = b.mRE.constData(), *kyl = b.mKyl.constData(), *kyr = b.mKyr.constData();
+    const double *ko = b.mKo.constData(), *h = b.mH.constData();
+    double *yl_c = b.mYLC.data(), *yl_n = b.mYLN.data(), *yr_c = b.mYRC.data(), *yr_n = b.mYRN.data();
+    double *som_c = b.mSOMC.data(), *som_n = b.mSOMN.data();
+    double *flux_c = b.mFluxC.data(), *flux_n = b.mFluxN.data();
+    double *nav_lab = b.mNavLab.data(), *nav_ref = b.mNavRef.data(), *nav_som = b.mNavSOM.data();
+
+    for (int i=begin;i<end;++i) {
+        const double before_c = yl_c[i] + yr_c[i] + som_c[i];
+        const double before_n = yl_n[i] + yr_n[i] + som_n[i];
+        const double total_in_c = in_lab_c[i] + in_ref_c[i];
+        const double total_in_n = in_lab_n[i] + in_ref_n[i];
+
+        const double ylss = in_lab_c[i] / (kyl[i] * re[i]); // Yl steady state C (eq A13)
+        const double cl = sp.el * (1. - h[i])/sp.qb - h[i]*(1.-sp.el)/sp.qh;
+        const double lab_cn = in_lab_n[i]>0 ? in_lab_c[i]/in_lab_n[i] : 0.;
+        double ynlss = in_lab_c[i] / (kyl[i]*re[i]*(1.-h[i])) * ((1.-sp.el)/lab_cn + cl); // Yl steady state N
+        ynlss = in_lab_c[i]==0. || ynlss < 0. ? 0. : ynlss;
+
+        const double yrss = in_ref_c[i] / (kyr[i] * re[i]); // Yr steady state C (eq A14)
+        const double cr = sp.er * (1. - h[i])/sp.qb - h[i]*(1.-sp.er)/sp.qh;
+        const double ref_cn = in_ref_n[i]>0 ? in_ref_c[i]/in_ref_n[i] : 0.;
+        double ynrss = in_ref_c[i] / (kyr[i]*re[i]*(1.-h[i])) * ((1.-sp.er)/ref_cn + cr); // Yr steady state N
+        ynrss = in_ref_c[i]==0. || ynrss < 0. ? 0. : ynrss;
+
+        const double oss = h[i]*total_in_c / (ko[i]*re[i]); // O steady state C
+        const double onss = h[i]*total_in_c / (sp.qh*ko[i]*re[i]); // O steady state N
+
+        const double al = h[i]*(kyl[i]*re[i]* yl_c[i] - in_lab_c[i]) / ((ko[i]-kyl[i])*re[i]);
+        const double ar = h[i]*(kyr[i]*re[i]* yr_c[i] - in_ref_c[i]) / ((ko[i]-kyr[i])*re[i]);
+
+        const double lfactor = exp(-kyl[i]*re[i]*t);
+        const double rfactor = exp(-kyr[i]*re[i]*t);
+        const double ofactor = exp(-ko[i]*re[i]*t);
+
+        // young labile pool
+        const double ylc = yl_c[i], yln = yl_n[i];
+        yl_c[i] = ylss + (ylc-ylss)*lfactor;
+        const double new_yl_n = ynlss + (yln-ynlss-cl/(sp.el-h[i])*(ylc-ylss))*exp(-kyl[i]*re[i]*(1.-h[i])*t/(1.-sp.el)) + cl/(sp.el-h[i])*(ylc-ylss)*lfactor;
+        yl_n[i] = new_yl_n < 0. ? 0. : new_yl_n;
+
+        // young refractory pool
+        const double yrc = yr_c[i], yrn = yr_n[i];
+        yr_c[i] = yrss + (yrc-yrss)*rfactor;
+        const double new_yr_n = ynrss + (yrn-ynrss-cr/(sp.er-h[i])*(yrc-yrss))*exp(-kyr[i]*re[i]*(1.-h[i])*t/(1.-sp.er)) + cr/(sp.er-h[i])*(yrc-yrss)*rfactor;
+        yr_n[i] = new_yr_n < 0. ? 0. : new_yr_n;
+
+        // SOM pool (old)
+        const double oc = som_c[i], on = som_n[i];
+        som_c[i] = oss + (oc -oss - al - ar)*ofactor + al*lfactor + ar*rfactor;
+        som_n[i] = onss + (on - onss -(al+ar)/sp.qh)*ofactor + al/sp.qh * lfactor + ar/sp.qh * rfactor;
+
+        // flux to atmosphere (negative fluxes are removed when copying back)
+        flux_c[i] = before_c + total_in_c - (yl_c[i] + yr_c[i] + som_c[i]);
+        flux_n[i] = before_n + total_in_n - (yl_n[i] + yr_n[i] + som_n[i]);
+
+        // plant available nitrogen (kg/ha)
+        nav_lab[i] = kyl[i]*re[i]*(1.-h[i])/(1.-sp.el) * (yl_n[i] - sp.el*yl_c[i]/sp.qb) * 1000.;
+        nav_ref[i] = kyr[i]*re[i]*(1-h[i])/(1.-sp.er)* (yr_n[i] - sp.er*yr_c[i]/sp.qb) * 1000.;
+        nav_som[i] = ko[i]*re[i]*som_n[i]*(1.-sp.leaching) * 1000.;
+    }
+
+    // scatter: copy the results back to the soil objects
+    for (int i=begin;i<end;++i) {
+        Soil *s = b.mSoils[i];
+        s->mYL.C = yl_c[i]; s->mYL.N = yl_n[i]; s->mYL.setParameter(s->mKyl);
+        s->mYR.C = yr_c[i]; s->mYR.N = yr_n[i]; s->mYR.setParameter(s->mKyr);
+        s->mSOM.C = som_c[i]; s->mSOM.N = som_n[i];
+        if (!s->mYL.isValid() || !s->mYR.isValid() || !s->mSOM.isValid())
+            qDebug() << "Soil::calculateYear: invalid soil pools in yL, yR, or SOM";
+        if (flux_c[i] < 0.)
+            qDebug() << "negative flux to atmosphere?!?";
+        else
+            s->mTotalToAtmosphere += CNPair(flux_c[i], flux_n[i]);
+
+        s->mAvailableNitrogenFromLabile = nav_lab[i];
+        s->mAvailableNitrogenFromRefractory = nav_ref[i];
+        s->mAvailableNitrogen = nav_lab[i] + nav_ref[i] + nav_som[i];
+        if (s->mAvailableNitrogen<0.)
+            s->mAvailableNitrogen = 0.;
+        if (isnan(s->mAvailableNitrogen) || isnan(s->mYR.C))
+            qDebug() << "Available Nitrogen is NAN.";
+        // add nitrogen deposition
+        s->mAvailableNitrogen += Soil::mNitrogenDeposition;
+    }
+}
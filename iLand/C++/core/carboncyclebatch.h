@@ -0,0 +1,58 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef CARBONCYCLEBATCH_H
+#define CARBONCYCLEBATCH_H
+#include <QtCore/QVector>
+#include <QtCore/QList>
+
+class ResourceUnit;
+class Soil;
+struct CarbonCycleBlock;
+
+/** CarbonCycleBatch calculates the soil carbon and nitrogen dynamics (ICBM/2N) for all resource units in a batch.
+  @ingroup core
+  The batch mode is enabled with 'model.settings.soil.batched'. The carbon cycle is then processed in three passes:
+  (1) the snag dynamics (and the soil input) per resource unit (in parallel), (2) the update of the soil pools
+  for blocks of resource units, and (3) the calculation of available nitrogen and the debug outputs per resource unit.
+  In (2) the state of the soil pools of a block is copied to contiguous arrays (structure of arrays),
+  updated with a loop without function calls (other than exp()) that the compiler can vectorize, and copied back.
+  The equations and the order of operations are the same as in Soil::calculateYear(), i.e. the results are identical.
+  The Soil and Snag objects remain the owners of the state, i.e. outputs, snapshots and management access them as before.
+  */
+class CarbonCycleBatch
+{
+public:
+    CarbonCycleBatch() {}
+    /// run the carbon cycle (snags and soil) for all resource units in 'ru_list'
+    void calculateYear(const QList<ResourceUnit*> &ru_list);
+    /// number of resource units per block (a block is processed by one thread)
+    static const int cBlockSize = 256;
+private:
+    static void calculateBlock(CarbonCycleBlock &block); ///< gather, update, and scatter the soils of a block
+    // state of the soil of all resource units (index: position in mSoils)
+    QVector<Soil*> mSoils;
+    QVector<double> mInLabC, mInLabN, mInRefC, mInRefN; ///< inputs (t/ha)
+    QVector<double> mRE, mKyl, mKyr, mKo, mH; ///< climate factor and rates
+    QVector<double> mYLC, mYLN, mYRC, mYRN, mSOMC, mSOMN; ///< state variables (t/ha)
+    QVector<double> mFluxC, mFluxN; ///< flux to the atmosphere (t/ha)
+    QVector<double> mNavLab, mNavRef, mNavSOM; ///< available nitrogen (kg/ha)
+};
+
+#endif // CARBONCYCLEBATCH_H
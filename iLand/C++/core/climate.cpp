@@ -361,6 +361,8 @@ void Climate::nextYear()
     for (int i=0;i<12;i++)  {
         mPrecipitationMonth[i]=0.;
         mTemperatureMonth[i]=0.;
+        mMinTemperatureMonth[i]=0.;
+        mMaxTemperatureMonth[i]=0.;
     }
 
     for (const ClimateDay *d=begin();d!=end();++d) {
@@ -368,9 +370,13 @@ void Climate::nextYear()
         mMeanAnnualTemperature += d->temperature;
         mPrecipitationMonth[d->month-1]+= d->preciptitation;
         mTemperatureMonth[d->month-1] += d->temperature;
+        mMinTemperatureMonth[d->month-1] += d->min_temperature;
+        mMaxTemperatureMonth[d->month-1] += d->max_temperature;
     }
     for (int i=0;i<12;++i) {
         mTemperatureMonth[i] /= days(i);
+        mMinTemperatureMonth[i] /= days(i);
+        mMaxTemperatureMonth[i] /= days(i);
     }
     mMeanAnnualTemperature /= daysOfYear();
 
@@ -91,6 +91,9 @@ public:
     double annualPrecipitation() const { double r=0.; for (int i=0;i<12;++i) r+=mPrecipitationMonth[i]; return r;}
     /// get a array with mean temperatures (light hours) per month (deg C)
     const double *temperatureMonth() const { return mTemperatureMonth; }
+    /// get a array with mean daily minimum / maximum temperatures per month (deg C)
+    const double *minTemperatureMonth() const { return mMinTemperatureMonth; }
+    const double *maxTemperatureMonth() const { return mMaxTemperatureMonth; }
     /// retrieve the year provided in the climate table
     int climateDataYear() const { return mBegin->year; }
     // access to other subsystems
@@ -127,6 +130,8 @@ private:
     double mAnnualRadiation;  ///< this year's value for total radiation (MJ/m2)
     double mPrecipitationMonth[12]; ///< this years preciptitation sum (mm) per month
     double mTemperatureMonth[12]; ///< this years average temperature per month
+    double mMinTemperatureMonth[12]; ///< this years average of daily minimum temperatures per month
+    double mMaxTemperatureMonth[12]; ///< this years average of daily maximum temperatures per month
     double mMeanAnnualTemperature; ///< mean temperature of the current year
     static QVector<int> sampled_years; ///< list of sampled years to use
     // co2 concentrations
@@ -28,10 +28,80 @@
 #include "speciesset.h"
 
 
+// site parameters: key in the project file, member of SiteParameters, default value
+struct SiteParameterKey {
+    const char *key;
+    double SiteParameters::*member;
+    double default_value;
+};
+static const SiteParameterKey site_parameter_keys[] = {
+    { "model.site.soilDepth", &SiteParameters::soilDepth, 0. },
+    { "model.site.pctSand", &SiteParameters::pctSand, 0. },
+    { "model.site.pctSilt", &SiteParameters::pctSilt, 0. },
+    { "model.site.pctClay", &SiteParameters::pctClay, 0. },
+    { "model.site.availableNitrogen", &SiteParameters::availableNitrogen, 40. },
+    { "model.site.youngLabileC", &SiteParameters::youngLabileC, -1. },
+    { "model.site.youngLabileN", &SiteParameters::youngLabileN, -1. },
+    { "model.site.youngLabileDecompRate", &SiteParameters::youngLabileDecompRate, -1. },
+    { "model.site.youngRefractoryC", &SiteParameters::youngRefractoryC, -1. },
+    { "model.site.youngRefractoryN", &SiteParameters::youngRefractoryN, -1. },
+    { "model.site.youngRefractoryDecompRate", &SiteParameters::youngRefractoryDecompRate, -1. },
+    { "model.site.somC", &SiteParameters::somC, -1. },
+    { "model.site.somN", &SiteParameters::somN, -1. },
+    { "model.site.youngLabileAbovegroundFraction", &SiteParameters::youngLabileAbovegroundFraction, 0. },
+    { "model.site.youngRefractoryAbovegroundFraction", &SiteParameters::youngRefractoryAbovegroundFraction, 0. },
+    { "model.site.somDecompRate", &SiteParameters::somDecompRate, 0.02 },
+    { "model.site.soilHumificationRate", &SiteParameters::soilHumificationRate, 0.3 },
+    { "model.initialization.snags.swdC", &SiteParameters::swdC, 0. },
+    { "model.initialization.snags.swdCN", &SiteParameters::swdCN, 50. },
+    { "model.initialization.snags.swdDecompRate", &SiteParameters::swdDecompRate, 0. },
+    { "model.initialization.snags.swdCount", &SiteParameters::swdCount, 0. },
+    { "model.initialization.snags.swdHalfLife", &SiteParameters::swdHalfLife, 0. },
+    { "model.initialization.snags.otherC", &SiteParameters::otherC, 0. },
+    { "model.initialization.snags.otherCN", &SiteParameters::otherCN, 50. },
+    { "model.initialization.snags.otherAbovegroundFraction", &SiteParameters::otherAbovegroundFraction, 0.5 }
+};
+static const int n_site_parameter_keys = sizeof(site_parameter_keys) / sizeof(SiteParameterKey);
+
+static int siteParameterIndex(const QString &key)
+{
+    for (int i=0;i<n_site_parameter_keys;++i)
+        if (key == QLatin1String(site_parameter_keys[i].key))
+            return i;
+    return -1;
+}
+
+void SiteParameters::loadFromXml(const XmlHelper &xml)
+{
+    for (int i=0;i<n_site_parameter_keys;++i)
+        this->*(site_parameter_keys[i].member) = xml.valueDouble(site_parameter_keys[i].key, site_parameter_keys[i].default_value);
+}
+
+bool SiteParameters::setValue(const QString &key, const QVariant &value)
+{
+    int idx = siteParameterIndex(key);
+    if (idx<0)
+        return false;
+    bool ok;
+    double val = value.toDouble(&ok);
+    if (!ok)
+        throw IException(QString("Setup of the environment: invalid numeric value '%1' for the key '%2'.").arg(value.toString(), key));
+    this->*(site_parameter_keys[idx].member) = val;
+    return true;
+}
+
+bool SiteParameters::isSiteParameter(const QString &key)
+{
+    return siteParameterIndex(key) >= 0;
+}
+
 /** Represents the input of various variables with regard to climate, soil properties and more.
   @ingroup tools
     Data is read from various sources and presented to the core model with a standardized interface.
     see https://iland-model.org/simulation+extent
+    The environment table is compiled when loaded: site parameters (soil, initial carbon pools and snags) are
+    stored as SiteParameters for each row, species sets and climates are resolved to objects.
+    Only values of other columns are written to the project settings (XML) when moving to a position.
 */
 Environment::Environment()
 {
@@ -41,6 +111,9 @@ Environment::Environment()
     mCurrentSpeciesSet = 0;
     mCurrentClimate = 0;
     mCurrentID = 0;
+    mCurrentRow = -1;
+    mSpeciesColumn = mClimateColumn = mIdColumn = -1;
+    mDefaultSite.loadFromXml(GlobalSettings::instance()->settings());
 }
 Environment::~Environment()
 {
@@ -79,6 +152,7 @@ bool Environment::loadFromString(const QStringList &source)
         mRowCoordinates.clear();
         mCreatedObjects.clear();
         mCurrentID = 0;
+        mCurrentRow = -1;
 
         int index;
         if (mGridMode) {
@@ -108,6 +182,35 @@ bool Environment::loadFromString(const QStringList &source)
 
 
 
+        // ******** compile the table *******
+        // check the xml keys, and store the site parameters per row
+        mDefaultSite.loadFromXml(xml);
+        mXmlColumns.clear();
+        QVector<int> site_columns;
+        mIdColumn = mKeys.indexOf("id");
+        mSpeciesColumn = mKeys.indexOf(speciesKey);
+        mClimateColumn = mKeys.indexOf(climateKey);
+        for (int col=0;col<mKeys.count();++col) {
+            if (mKeys[col]=="id" || mKeys[col]=="x" || mKeys[col]=="y") // ignore "x", "y" and "id" keys
+                continue;
+            if (!xml.hasNode(mKeys[col])) {
+                throw IException("Setup of the environment: tried to set the value of the xml-key '" + mKeys[col] + "', but the node does not exist.");
+            }
+            if (xml.value(mKeys[col]).isEmpty()) {
+                throw IException("Setup of the environment: tried to set the value of the xml-key '" + mKeys[col] + "', but the node is empty (Note that nodes must not be empty in the XML file, even if they are to be overwritten).");
+            }
+            if (SiteParameters::isSiteParameter(mKeys[col]))
+                site_columns.push_back(col);
+            else if (col!=mSpeciesColumn && col!=mClimateColumn)
+                mXmlColumns.push_back(col);
+        }
+        mSites.fill(mDefaultSite, mInfile->rowCount());
+        for (int row=0;row<mInfile->rowCount();row++)
+            for (int i=0;i<site_columns.size();++i)
+                mSites[row].setValue(mKeys[site_columns[i]], mInfile->value(row, site_columns[i]));
+        if (!mXmlColumns.isEmpty())
+            qDebug() << "Environment: columns not compiled (values are written to the project settings for each resource unit):" << mXmlColumns.size();
+
         // ******** setup of Species Sets *******
         if ((index = mKeys.indexOf(speciesKey))>-1) {
             DebugTimer t("environment:load species");
@@ -186,8 +289,10 @@ void Environment::setPosition(const QPointF position)
         id = mGrid->value(position);
         mCurrentID = id;
         key = QString::number(id);
-        if (id==-1)
+        if (id==-1) {
+            mCurrentRow = -1;
             return; // no data for the resource unit
+        }
     } else {
         // access data in the matrix by resource unit indices
         ix = int(position.x() / 100.); // suppose size of 1 ha for each coordinate
@@ -197,43 +302,44 @@ void Environment::setPosition(const QPointF position)
         key=QString("%1_%2").arg(ix).arg(iy);
     }
 
-    if (mRowCoordinates.contains(key)) {
-        XmlHelper xml(GlobalSettings::instance()->settings());
-        int row = mRowCoordinates[key];
-        QString value;
+    QHash<QString, int>::const_iterator it = mRowCoordinates.constFind(key);
+    if (it != mRowCoordinates.constEnd()) {
+        int row = it.value();
+        mCurrentRow = row;
         if (logLevelInfo()) qDebug() << "settting up point" << position << "with row" << row;
-        for (int col=0;col<mInfile->colCount(); col++) {
-            if (mKeys[col]=="id") {
-                mCurrentID = mInfile->value(row, col).toInt();
-                continue;
-            }
-            if (mKeys[col]=="x" || mKeys[col]=="y") // ignore "x" and "y" keys
-                continue;
-            value = mInfile->value(row,col).toString();
-            if (logLevelInfo()) qDebug() << "set" << mKeys[col] << "to" << value;
-            if (!xml.hasNode(mKeys[col])) {
-                throw IException("Setup of the environment: tried to set the value of the xml-key '" + mKeys[col] + "', but the node does not exist.");
-            }
-            if (!xml.setNodeValue(mKeys[col], value)) {
-                throw IException("Setup of the environment: tried to set the value of the xml-key '" + mKeys[col] + "', but the node is empty (Note that nodes must not be empty in the XML file, even if they are to be overwritten).");
-            }
-            // special handling for constructed objects:
-            if (mKeys[col]==speciesKey)
-                mCurrentSpeciesSet = (SpeciesSet*)mCreatedObjects[value];
-            if (mKeys[col]==climateKey) {
-                mCurrentClimate = (Climate*)mCreatedObjects[value];
-                if (mCurrentClimate==nullptr) {
-                    // create only those climate sets that are really used in the current landscape
-                    Climate *climate = new Climate();
-                    mClimate.push_back(climate);
-                    mCreatedObjects[value]=(void*)climate;
-                    climate->setup(mClimate.size()<2); // debug log only for the first climate
-                    mCurrentClimate = climate;
+        if (mIdColumn>=0)
+            mCurrentID = mInfile->value(row, mIdColumn).toInt();
 
+        // values that are not compiled are still written to the project settings
+        if (!mXmlColumns.isEmpty()) {
+            XmlHelper xml(GlobalSettings::instance()->settings());
+            for (int i=0;i<mXmlColumns.size();++i) {
+                int col = mXmlColumns[i];
+                QString value = mInfile->value(row,col).toString();
+                if (logLevelInfo()) qDebug() << "set" << mKeys[col] << "to" << value;
+                if (!xml.setNodeValue(mKeys[col], value)) {
+                    throw IException("Setup of the environment: tried to set the value of the xml-key '" + mKeys[col] + "', but the node is empty (Note that nodes must not be empty in the XML file, even if they are to be overwritten).");
                 }
             }
+        }
 
-
+        // special handling for constructed objects:
+        if (mSpeciesColumn>=0)
+            mCurrentSpeciesSet = (SpeciesSet*)mCreatedObjects[mInfile->value(row, mSpeciesColumn).toString()];
+        if (mClimateColumn>=0) {
+            QString value = mInfile->value(row, mClimateColumn).toString();
+            mCurrentClimate = (Climate*)mCreatedObjects[value];
+            if (mCurrentClimate==nullptr) {
+                // create only those climate sets that are really used in the current landscape
+                // the climate reads the name of the table from the project settings
+                XmlHelper xml(GlobalSettings::instance()->settings());
+                xml.setNodeValue(climateKey, value);
+                Climate *climate = new Climate();
+                mClimate.push_back(climate);
+                mCreatedObjects[value]=(void*)climate;
+                climate->setup(mClimate.size()<2); // debug log only for the first climate
+                mCurrentClimate = climate;
+            }
         }
 
     } else {
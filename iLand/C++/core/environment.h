@@ -25,6 +25,33 @@ class Climate;
 class SpeciesSet;
 class CSVFile;
 class GisGrid;
+class XmlHelper;
+
+/** SiteParameters are the site specific (typed) parameters of a resource unit.
+    The values are taken from the project file (model.site, model.initialization.snags) and can be
+    overridden per resource unit by the environment file. The parameters are used during the setup
+    of the resource unit (ResourceUnit::setup(), WaterCycle, Permafrost, Soil and Snag). */
+struct SiteParameters {
+    /// load the default values from the project file
+    void loadFromXml(const XmlHelper &xml);
+    /// set the value for 'key' (the xml-key of the project file). Returns false if 'key' is not a site parameter.
+    bool setValue(const QString &key, const QVariant &value);
+    /// returns true if 'key' (xml-key of the project file) is a site parameter
+    static bool isSiteParameter(const QString &key);
+    // soil physics
+    double soilDepth; ///< soil depth (cm)
+    double pctSand, pctSilt, pctClay; ///< soil texture (%)
+    double availableNitrogen; ///< plant available nitrogen (kg/ha*yr)
+    // soil carbon and nitrogen pools (kg/ha) and decomposition rates
+    double youngLabileC, youngLabileN, youngLabileDecompRate;
+    double youngRefractoryC, youngRefractoryN, youngRefractoryDecompRate;
+    double somC, somN;
+    double youngLabileAbovegroundFraction, youngRefractoryAbovegroundFraction;
+    double somDecompRate, soilHumificationRate;
+    // initial state of snags
+    double swdC, swdCN, swdDecompRate, swdCount, swdHalfLife;
+    double otherC, otherCN, otherAbovegroundFraction;
+};
 
 /** Environment specifes the geographical properties of the landscape.
     This is achieved by specifying (user defined) values (e.g. soil depth) for each resource unit.
@@ -49,6 +76,8 @@ public:
     Climate *climate() const { return mCurrentClimate;} ///< get climate at current pos
     SpeciesSet *speciesSet() const {return mCurrentSpeciesSet;} ///< get species set on current pos
     int currentID() const { return mCurrentID; } ///< current grid id (in grid mode the id of the stand grid, in matrix mode simply the an autogenerated index)
+    /// site parameters at the current position (the defaults of the project file if no environment file is used)
+    const SiteParameters &siteParameters() const { return mCurrentRow>=0 ? mSites[mCurrentRow] : mDefaultSite; }
 
 private:
     bool mGridMode;
@@ -58,6 +87,13 @@ private:
     QList<Climate*> mClimate; ///< created climates.
     QList<SpeciesSet*> mSpeciesSets; ///< created species sets
     QStringList mKeys;
+    int mCurrentRow; ///< current row in the environment table (-1: none)
+    SiteParameters mDefaultSite; ///< site parameters from the project file
+    QVector<SiteParameters> mSites; ///< site parameters for each row of the environment table
+    QVector<int> mXmlColumns; ///< columns that are not site parameters (values are written to the project settings)
+    int mSpeciesColumn; ///< column of the species set (or -1)
+    int mClimateColumn; ///< column of the climate (or -1)
+    int mIdColumn; ///< column of the (grid) id (or -1)
     QHash<QString, int> mRowCoordinates;
     QHash<QString, void*> mCreatedObjects;
     CSVFile *mInfile;
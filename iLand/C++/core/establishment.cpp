@@ -27,6 +27,9 @@
 #include "watercycle.h"
 #include "permafrost.h"
 #include "microclimate.h"
+#include "speciesset.h"
+#include "globalsettings.h"
+#include "threadrunner.h"
 
 /** @class Establishment
     Establishment deals with the establishment process of saplings.
@@ -154,65 +157,96 @@ double Establishment::calculateSOLDepthLimitation()
 
 
 
-/** Calculate the abiotic environemnt for seedling for a given species and a given resource unit.
- The model is closely based on the TACA approach of Nitschke and Innes (2008), Ecol. Model 210, 263-277
- more details: https://iland-model.org/establishment#abiotic_environment
- a model mockup in R: script_establishment.r
+// static members
+QHash<QPair<const Climate*, const Species*>, TACAClimate> Establishment::mClimateCache;
+int Establishment::mClimateCacheYear = -1;
 
- */
-void Establishment::calculateAbioticEnvironment()
-{
-    //DebugTimer t("est_abiotic"); t.setSilent();
-    // make sure that required calculations (e.g. watercycle are already performed)
-    const_cast<ResourceUnitSpecies*>(mRUS)->calculate(true); // calculate the 3pg module and run the water cycle (this is done only if that did not happen up to now); true: call comes from regeneration
+struct TACAClimateJob {
+    const Climate *climate;
+    const Species *species;
+    TACAClimate result;
+};
 
-    const EstablishmentParameters &p = mRUS->species()->establishmentParameters();
-    const Phenology &pheno = mClimate->phenology(mRUS->species()->phenologyClass());
+static void nc_calculateTACAClimate(TACAClimateJob &job)
+{
+    job.result = Establishment::calculateTACAClimate(job.climate, job.species);
+}
 
-    mTACA_min_temp = true; // minimum temperature threshold
-    mTACA_chill = false;  // (total) chilling requirement
-    mTACA_gdd = false;   // gdd-thresholds
-    mTACA_frostfree = false; // frost free days in vegetation period
-    mTACA_frostAfterBuds = 0; // frost days after bud birst
-    mGDD = 0;
+/** Pre-calculate the climate part of the TACA model for all climates and active species.
+  The climate part does not depend on the resource unit (unless microclimate is used for establishment),
+  and is calculated therefore only once per climate and species (and not for every resource unit species).
+  The calculations run in parallel; the cache is only read during establishment. */
+void Establishment::calculateClimateCache(const QList<Climate *> &climates, const QList<SpeciesSet *> &species_sets)
+{
+    clearClimateCache();
+    Model *model = GlobalSettings::instance()->model();
+    // with microclimate the temperatures are modified on each resource unit: no caching
+    if (Model::settings().microclimateEnabled && model && !model->ruList().isEmpty()
+            && model->ruList().first()->microClimate() && model->ruList().first()->microClimate()->settings().establishment_effect)
+        return;
+
+    QVector<TACAClimateJob> jobs;
+    foreach(const Climate *c, climates)
+        foreach(const SpeciesSet *set, species_sets)
+            foreach(const Species *s, set->activeSpecies()) {
+                TACAClimateJob job;
+                job.climate = c;
+                job.species = s;
+                jobs.push_back(job);
+            }
+    if (model)
+        model->threadExec().run(nc_calculateTACAClimate, jobs);
+    else
+        for (int i=0;i<jobs.size();++i)
+            nc_calculateTACAClimate(jobs[i]);
+
+    mClimateCache.reserve(jobs.size());
+    for (int i=0;i<jobs.size();++i)
+        mClimateCache.insert(qMakePair(jobs[i].climate, jobs[i].species), jobs[i].result);
+    mClimateCacheYear = GlobalSettings::instance()->currentYear();
+}
 
-    // should we use microclimate temperatures?
-    bool use_micro_clim = Model::settings().microclimateEnabled && mRUS->ru()->microClimate()->settings().establishment_effect;
+void Establishment::clearClimateCache()
+{
+    mClimateCache.clear();
+    mClimateCacheYear = -1;
+}
 
+/** Calculate the climate dependent TACA flags (minimum temperature, chilling, GDD, frost) for a species.
+  The optional 'tmin_buffer' and 'tavg_buffer' are monthly offsets that are added to the daily minimum and mean temperature. */
+TACAClimate Establishment::calculateTACAClimate(const Climate *climate, const Species *species, const double *tmin_buffer, const double *tavg_buffer)
+{
+    const EstablishmentParameters &p = species->establishmentParameters();
+    const Phenology &pheno = climate->phenology(species->phenologyClass());
 
-    const ClimateDay *day = mClimate->begin();
+    TACAClimate r;
+    const ClimateDay *day = climate->begin();
     int doy = 0;
     double GDD=0.;
     double GDD_BudBirst = 0.;
     int chill_days = pheno.chillingDaysLastYear(); // chilling days of the last autumn
     int frost_free = 0;
-    mTACA_frostAfterBuds = 0;
+    int frost_after_buds = 0;
+    bool min_temp = true;
     bool chill_ok = false;
     bool buds_are_birst = false;
     int veg_period_end = pheno.vegetationPeriodEnd();
     if (veg_period_end >= 365)
-        veg_period_end = mClimate->sun().dayShorter10_5hrs();
+        veg_period_end = climate->sun().dayShorter10_5hrs();
 
-    for (; day!=mClimate->end(); ++day, ++doy) {
+    for (; day!=climate->end(); ++day, ++doy) {
 
         double day_tmin = day->min_temperature;
         double day_tavg = day->temperature;
 
-        if (use_micro_clim) {
-            // use microclimate calculations to modify the temperature
-            // for establishment
-            double mc_min_buf = mRUS->ru()->microClimate()->minimumMicroclimateBufferingRU(day->month-1);
-            double mc_max_buf = mRUS->ru()->microClimate()->maximumMicroclimateBufferingRU(day->month-1);
-            double mc_mean_buf = (mc_min_buf + mc_max_buf) / 2.;
-
-            day_tmin += mc_min_buf;
-            day_tavg += mc_mean_buf;
-
+        if (tmin_buffer) {
+            day_tmin += tmin_buffer[day->month-1];
+            day_tavg += tavg_buffer[day->month-1];
         }
 
         // minimum temperature: if temp too low -> set prob. to zero
         if (day_tmin < p.min_temp)
-            mTACA_min_temp = false;
+            min_temp = false;
 
         // count frost free days
         if (day_tmin > 0.)
@@ -239,12 +273,63 @@ void Establishment::calculateAbioticEnvironment()
                 buds_are_birst = true;
 
             if (doy<veg_period_end && buds_are_birst && day_tmin <= 0.)
-                mTACA_frostAfterBuds++;
+                frost_after_buds++;
         }
     }
-    // chilling requirement
-    if (chill_ok)
-        mTACA_chill = true;
+    r.min_temp = min_temp;
+    r.chill = chill_ok;
+    r.GDD = GDD;
+    r.frost_free = frost_free;
+    r.frost_after_buds = frost_after_buds;
+    return r;
+}
+
+/** Calculate the abiotic environemnt for seedling for a given species and a given resource unit.
+ The model is closely based on the TACA approach of Nitschke and Innes (2008), Ecol. Model 210, 263-277
+ more details: https://iland-model.org/establishment#abiotic_environment
+ a model mockup in R: script_establishment.r
+
+ */
+void Establishment::calculateAbioticEnvironment()
+{
+    //DebugTimer t("est_abiotic"); t.setSilent();
+    // make sure that required calculations (e.g. watercycle are already performed)
+    const_cast<ResourceUnitSpecies*>(mRUS)->calculate(true); // calculate the 3pg module and run the water cycle (this is done only if that did not happen up to now); true: call comes from regeneration
+
+    const EstablishmentParameters &p = mRUS->species()->establishmentParameters();
+
+    // should we use microclimate temperatures?
+    bool use_micro_clim = Model::settings().microclimateEnabled && mRUS->ru()->microClimate()->settings().establishment_effect;
+
+    TACAClimate taca;
+    if (use_micro_clim) {
+        // use microclimate calculations to modify the temperature
+        // for establishment: the buffering is specific for the resource unit
+        double tmin_buf[12], tavg_buf[12];
+        for (int m=0;m<12;++m) {
+            double mc_min_buf = mRUS->ru()->microClimate()->minimumMicroclimateBufferingRU(m);
+            double mc_max_buf = mRUS->ru()->microClimate()->maximumMicroclimateBufferingRU(m);
+            tmin_buf[m] = mc_min_buf;
+            tavg_buf[m] = (mc_min_buf + mc_max_buf) / 2.;
+        }
+        taca = calculateTACAClimate(mClimate, mRUS->species(), tmin_buf, tavg_buf);
+    } else {
+        // the climate part is shared by all resource units with the same climate
+        QHash<QPair<const Climate*, const Species*>, TACAClimate>::const_iterator it = mClimateCache.constEnd();
+        if (mClimateCacheYear == GlobalSettings::instance()->currentYear())
+            it = mClimateCache.constFind(qMakePair(mClimate, mRUS->species()));
+        if (it != mClimateCache.constEnd())
+            taca = it.value();
+        else
+            taca = calculateTACAClimate(mClimate, mRUS->species());
+    }
+
+    mTACA_min_temp = taca.min_temp; // minimum temperature threshold
+    mTACA_chill = taca.chill;  // (total) chilling requirement
+    mTACA_gdd = false;   // gdd-thresholds
+    mTACA_frostfree = false; // frost free days in vegetation period
+    mTACA_frostAfterBuds = taca.frost_after_buds; // frost days after bud birst
+    double GDD = taca.GDD;
 
     // GDD requirements
     mGDD = static_cast<int>(GDD);
@@ -252,7 +337,7 @@ void Establishment::calculateAbioticEnvironment()
         mTACA_gdd = true;
 
     // frost free days in the vegetation period
-    if (frost_free > p.frost_free)
+    if (taca.frost_free > p.frost_free)
         mTACA_frostfree = true;
 
     // if all requirements are met:
@@ -20,8 +20,24 @@
 #ifndef ESTABLISHMENT_H
 #define ESTABLISHMENT_H
 #include <QtCore/QPoint>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
 class Climate;
 class ResourceUnitSpecies;
+class Species;
+class SpeciesSet;
+
+/** TACAClimate holds the climate-driven part of the TACA model for a single species and a climate.
+  The values depend only on the daily climate, the phenology and the species parameters, and are therefore
+  shared by all resource units with the same climate (if microclimate does not modify the temperatures). */
+struct TACAClimate {
+    TACAClimate(): min_temp(true), chill(false), GDD(0.), frost_free(0), frost_after_buds(0) {}
+    bool min_temp; ///< minimum temperature threshold not violated
+    bool chill; ///< chilling requirement met
+    double GDD; ///< growing degree days (above species base temperature)
+    int frost_free; ///< number of frost free days
+    int frost_after_buds; ///< number of frost days after bud birst
+};
 
 class Establishment
 {
@@ -33,6 +49,14 @@ public:
     void clear();
     void calculateAbioticEnvironment(); ///< calculate the abiotic environment (TACA model)
     void writeDebugOutputs();
+    /// calculate the climate part of the TACA model for all combinations of 'climates' and the
+    /// active species of 'species_sets' (in parallel). The cache is valid for the current year.
+    static void calculateClimateCache(const QList<Climate*> &climates, const QList<SpeciesSet*> &species_sets);
+    static void clearClimateCache();
+    /// calculate the climate part of the TACA model. 'tmin_buffer' and 'tavg_buffer' are optional
+    /// arrays with monthly offsets (degree C) of the daily minimum / mean temperature (microclimate)
+    static TACAClimate calculateTACAClimate(const Climate *climate, const Species *species,
+                                            const double *tmin_buffer=nullptr, const double *tavg_buffer=nullptr);
     // some informations after execution
     double avgSeedDensity() const { return mPxDensity;} ///< average seed density on the RU
     double abioticEnvironment() const {return mPAbiotic; } ///< integrated value of abiotic environment (i.e.: TACA-climate + total iLand environment)
@@ -52,6 +76,9 @@ private:
     double calculateWaterLimitation();
     /// limitation if the depth of the soil organic layer is high (e.g. boreal forests)
     double calculateSOLDepthLimitation();
+    /// cached climate part of the TACA model per climate and species (see calculateClimateCache())
+    static QHash<QPair<const Climate*, const Species*>, TACAClimate> mClimateCache;
+    static int mClimateCacheYear; ///< year for which the cache is valid (-1: invalid)
 
     const Climate *mClimate; ///< link to the current climate
     const ResourceUnitSpecies *mRUS; ///< link to the resource unit species (links to production data and species respones)
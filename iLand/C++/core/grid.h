@@ -26,8 +26,11 @@
 #include <stdexcept>
 #include <limits>
 #include <cstring>
+#include <new>
+#include <type_traits>
 
 #include "global.h"
+#include "gridallocator.h"
 
 /** Grid class (template).
 @ingroup tools
@@ -54,12 +57,13 @@ public:
     // copy ctor
     Grid(const Grid<T>& toCopy);
     ~Grid() { clear(); }
-    void clear() { if (mData) delete[] mData; mData=0; }
+    void clear() { freeData(); }
 
     bool setup(const float cellsize, const int sizex, const int sizey);
     bool setup(const QRectF& rect, const double cellsize);
     bool setup(const Grid<T>& source) { clear();  mRect = source.mRect; return setup(source.mRect, source.mCellsize); }
-    void initialize(const T& value) {for( T *p = begin();p!=end(); ++p) *p=value; }
+    /// set all cells to 'value' (a value of 0 (all bits) releases the memory of memory mapped grids, see GridAllocator)
+    void initialize(const T& value);
     void wipe(); ///< write 0-bytes with memcpy to the whole area
     void wipe(const T value); ///< overwrite the whole area with "value" size of T must be the size of "int" ERRORNOUS!!!
     /// copies the content of the source grid to this grid.
@@ -179,6 +183,8 @@ public:
     /// returns the number of filled pixels
     int floodFill(QPoint start, T old_color, T color, int max_fill=-1);
 private:
+    static T *allocateData(const int count); ///< allocate (and construct) 'count' elements with the GridAllocator
+    void freeData(); ///< destruct and free the elements
 
     T* mData;
     T* mEnd; ///< pointer to 1 element behind the last
@@ -360,7 +366,7 @@ bool Grid<T>::setup(const float cellsize, const int sizex, const int sizey)
         // test if we can re-use the allocated memory.
         if (mSizeX*mSizeY > mCount || mCellsize != cellsize) {
             // we cannot re-use the memory - create new data
-            delete[] mData; mData=NULL;
+            freeData();
         }
     }
     mCellsize=cellsize;
@@ -368,7 +374,7 @@ bool Grid<T>::setup(const float cellsize, const int sizex, const int sizey)
     if (mCount<=0)
         return false;
     if (mData==NULL)
-        mData = new T[mCount];
+        mData = allocateData(mCount);
     mEnd = &(mData[mCount]);
     return true;
 }
@@ -474,7 +480,48 @@ void Grid<T>::limit(const T min_value, const T max_value)
 template <class T>
 void  Grid<T>::wipe()
 {
-    memset(mData, 0, mCount*sizeof(T));
+    GridAllocator::zero(mData, mCount*sizeof(T));
+}
+
+template <class T>
+void Grid<T>::initialize(const T& value)
+{
+    // a value with all bits 0: use wipe() (which does not touch the released pages of memory mapped grids)
+    if (std::is_trivially_copyable<T>::value) {
+        const unsigned char *b = reinterpret_cast<const unsigned char*>(&value);
+        bool is_zero = true;
+        for (size_t i=0;i<sizeof(T);++i)
+            if (b[i]) { is_zero = false; break; }
+        if (is_zero) {
+            wipe();
+            return;
+        }
+    }
+    for( T *p = begin();p!=end(); ++p)
+        *p=value;
+}
+
+template <class T>
+T *Grid<T>::allocateData(const int count)
+{
+    T *data = static_cast<T*>(GridAllocator::allocate(size_t(count) * sizeof(T)));
+    // trivial types are not initialized (as with new T[]); memory maps are zero-initialized anyway
+    if (!std::is_trivially_default_constructible<T>::value)
+        for (int i=0;i<count;++i)
+            new (data + i) T();
+    return data;
+}
+
+template <class T>
+void Grid<T>::freeData()
+{
+    if (!mData)
+        return;
+    if (!std::is_trivially_destructible<T>::value)
+        for (int i=0;i<mCount;++i)
+            mData[i].~T();
+    GridAllocator::deallocate(mData);
+    mData = nullptr;
 }
 template <class T>
 void  Grid<T>::wipe(const T value)
@@ -0,0 +1,91 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "lddsampler.h"
+
+#include <QtCore/QMap>
+#include <algorithm>
+
+// maximum number of integration points per ring
+static const double cMaxPointsPerRing = 4000000.;
+
+void LDDSampler::setup(const QVector<double> &distances, const QVector<double> &density)
+{
+    mRings.clear();
+    for (int r=0; r<density.size() && r+1<distances.size(); ++r) {
+        Ring ring;
+        ring.density = density[r];
+        ring.n_fixed = static_cast<int>(round(density[r]));
+        const double r_in = distances[r], r_out = distances[r+1];
+
+        // numerical integration over the distance (uniform between r_in and r_out) and the direction (uniform):
+        // midpoints of a regular grid, about 2 points per cell in both directions
+        double n_r = std::max(16., ceil((r_out - r_in) * 2.));
+        double n_phi = std::max(64., ceil(2. * M_PI * r_out * 2.));
+        if (n_r * n_phi > cMaxPointsPerRing) {
+            double f = sqrt(cMaxPointsPerRing / (n_r * n_phi));
+            n_r = std::max(16., floor(n_r * f));
+            n_phi = std::max(64., floor(n_phi * f));
+        }
+        const int nr = static_cast<int>(n_r), nphi = static_cast<int>(n_phi);
+        // the offsets are calculated exactly as in the reference implementation (truncation towards zero)
+        QMap<QPair<int,int>, int> hits; // key: (dy, dx), sorted (deterministic order)
+        for (int i=0;i<nr;++i) {
+            const double radius = r_in + (i + 0.5) / nr * (r_out - r_in);
+            for (int j=0;j<nphi;++j) {
+                const double phi = (j + 0.5) / nphi * 2. * M_PI;
+                hits[qMakePair(static_cast<int>(radius*sin(phi)), static_cast<int>(radius*cos(phi)))]++;
+            }
+        }
+        const double total = double(nr) * nphi;
+        for (QMap<QPair<int,int>, int>::const_iterator it=hits.constBegin(); it!=hits.constEnd(); ++it) {
+            Offset o = { it.key().second, it.key().first };
+            ring.offsets.push_back(o);
+            ring.probability.push_back(it.value() / total);
+        }
+
+        // alias table (Vose's method)
+        const int n = ring.offsets.size();
+        ring.threshold.resize(n);
+        ring.alias.resize(n);
+        QVector<double> scaled(n);
+        QVector<int> small, large;
+        for (int k=0;k<n;++k) {
+            scaled[k] = ring.probability[k] * n;
+            if (scaled[k] < 1.) small.push_back(k); else large.push_back(k);
+        }
+        while (!small.isEmpty() && !large.isEmpty()) {
+            int s = small.takeLast();
+            int l = large.last();
+            ring.threshold[s] = scaled[s];
+            ring.alias[s] = l;
+            scaled[l] = (scaled[l] + scaled[s]) - 1.;
+            if (scaled[l] < 1.) {
+                large.removeLast();
+                small.push_back(l);
+            }
+        }
+        // remaining entries have (up to rounding errors) a probability of 1
+        foreach(int k, large) { ring.threshold[k] = 1.; ring.alias[k] = k; }
+        foreach(int k, small) { ring.threshold[k] = 1.; ring.alias[k] = k; }
+
+        mRings.push_back(ring);
+    }
+}
@@ -0,0 +1,96 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef LDDSAMPLER_H
+#define LDDSAMPLER_H
+#include <QtCore/QVector>
+
+/** LDDSampler draws the target cells of long distance seed dispersal (LDD) with precomputed alias tables.
+  @ingroup core
+  The reference implementation (SeedDispersal::distributeSeeds()) picks for each LDD seed a distance (uniform
+  within the ring) and a direction (uniform), and truncates the resulting offset to integer cells. The sampler
+  tabulates the resulting discrete distribution of target offsets (dx, dy) for each ring (numerical integration over
+  distance and direction) and stores it as an alias table (Walker/Vose), i.e. drawing a target requires a single
+  random number and no trigonometry.
+  Random numbers are "counter based": each number is a hash of the stream (species and year), the source cell, the ring
+  and the draw. The result for a source cell therefore does not depend on the order in which cells are processed,
+  i.e. source cells can be processed in parallel with identical results.
+  The number of targets per ring is the same as in the reference (a Bernoulli draw for densities < 1, rounded
+  densities otherwise). See SeedDispersal::validateLDDSampler() for a comparison of the target distributions.
+  */
+class LDDSampler
+{
+public:
+    struct Offset {
+        int dx, dy;
+    };
+    LDDSampler() {}
+    /// build the tables: 'distances' are the ring borders (in cells, rings+1 values), 'density' the number of targets per ring
+    void setup(const QVector<double> &distances, const QVector<double> &density);
+    void clear() { mRings.clear(); }
+    bool isEmpty() const { return mRings.isEmpty(); }
+    int rings() const { return mRings.size(); }
+
+    /// number of target cells in ring 'ring' for the source cell 'cell'
+    int count(quint64 stream, quint64 cell, int ring) const {
+        const double d = mRings[ring].density;
+        if (d < 1.)
+            return uniform(stream, cell, ring, 0xffffffffu) < d ? 1 : 0;
+        return mRings[ring].n_fixed;
+    }
+    /// offset of the target cell 'i' (0..count-1) in ring 'ring' for the source cell 'cell'
+    Offset sample(quint64 stream, quint64 cell, int ring, quint32 i) const {
+        const Ring &r = mRings[ring];
+        const double u = uniform(stream, cell, ring, i) * r.offsets.size();
+        int k = static_cast<int>(u);
+        if (k >= r.offsets.size()) k = r.offsets.size()-1;
+        return (u - k) < r.threshold[k] ? r.offsets[k] : r.offsets[r.alias[k]];
+    }
+
+    /// counter based random number [0,1) for (stream, cell, ring, i)
+    static double uniform(quint64 stream, quint64 cell, quint32 ring, quint32 i) {
+        quint64 h = mix(stream ^ mix(cell ^ mix((static_cast<quint64>(ring) << 32) | i)));
+        return static_cast<double>(h >> 11) * (1. / 9007199254740992.); // 53 bits
+    }
+    /// stream key from a base seed and e.g. the year
+    static quint64 stream(quint64 seed, quint64 key) { return mix(seed ^ mix(key)); }
+
+    // access to the tables (validation)
+    const QVector<Offset> &offsets(int ring) const { return mRings[ring].offsets; }
+    const QVector<double> &probabilities(int ring) const { return mRings[ring].probability; }
+private:
+    /// splitmix64 finalizer
+    static quint64 mix(quint64 z) {
+        z += 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    struct Ring {
+        double density; ///< expected number of targets
+        int n_fixed; ///< number of targets (density>=1)
+        QVector<Offset> offsets; ///< possible target offsets (cells)
+        QVector<double> probability; ///< probability of each offset
+        QVector<double> threshold; ///< alias table: probability to keep offset k
+        QVector<int> alias; ///< alias table: alternative offset
+    };
+    QVector<Ring> mRings;
+};
+
+#endif // LDDSAMPLER_H
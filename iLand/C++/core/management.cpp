@@ -86,7 +86,7 @@ int Management::remain(int number)
         qDebug() << "remain called (number): " << number;
     Model *m = GlobalSettings::instance()->model();
     AllTreeIterator at(m);
-    QList<Tree*> trees;
+    QVector<Tree*> trees;
     while (Tree *t=at.next())
         trees.push_back(t);
     int to_kill = trees.count() - number;
@@ -159,6 +159,11 @@ void Management::cutAndDrop()
     mTrees.clear();
 }
 
+static bool treeIsDead(const TreeListEngine::Item &item)
+{
+    return item.first->isDead();
+}
+
 int Management::remove_percentiles(int pctfrom, int pctto, int number, bool management)
 {
     if (mTrees.isEmpty())
@@ -208,10 +213,7 @@ int Management::remove_percentiles(int pctfrom, int pctto, int number, bool mana
     if (logLevelDebug())
         qDebug() << count << "removed.";
     // clean up the tree list...
-    for (int i=mTrees.count()-1; i>=0; --i) {
-        if (mTrees[i].first->isDead())
-            mTrees.removeAt(i);
-    }
+    mTrees.erase(std::remove_if(mTrees.begin(), mTrees.end(), treeIsDead), mTrees.end());
     return count; // killed or manages
 }
 
@@ -220,29 +222,27 @@ int Management::remove_percentiles(int pctfrom, int pctto, int number, bool mana
   */
 int Management::remove_trees(QString expression, double fraction, bool management)
 {
-    TreeWrapper tw;
-    Expression expr(expression,&tw);
-    expr.enableIncSum();
     int n = 0;
-    QPair<Tree*, double> empty_tree(nullptr,0.);
-    QList<QPair<Tree*, double> >::iterator tp=mTrees.begin();
     try {
-        for (;tp!=mTrees.end();++tp) {
-            tw.setTree(tp->first);
+        // evaluate the expression for all trees (parallel), the random numbers are drawn in list order
+        QVector<double> values;
+        TreeListEngine::evaluate(expression, mTrees, values);
+        int n_keep = 0;
+        for (int i=0;i<mTrees.count();++i) {
+            Tree *t = mTrees[i].first;
             // if expression evaluates to true and if random number below threshold...
-            if (expr.calculate(tw) && drandom() <=fraction) {
+            if (values[i] && drandom() <=fraction) {
                 // remove from system
                 if (management)
-                    tp->first->remove(removeFoliage(), removeBranch(), removeStem()); // management with removal fractions
+                    t->remove(removeFoliage(), removeBranch(), removeStem()); // management with removal fractions
                 else
-                    tp->first->remove(); // kill
-
-                // remove from tree list
-                *tp = empty_tree;
+                    t->remove(); // kill
                 n++;
+            } else {
+                mTrees[n_keep++] = mTrees[i]; // keep in the tree list
             }
         }
-        mTrees.removeAll(empty_tree);
+        mTrees.resize(n_keep);
     } catch(const IException &e) {
         ScriptGlobal::throwError(e.message());
     }
@@ -252,35 +252,27 @@ int Management::remove_trees(QString expression, double fraction, bool managemen
 // calculate aggregates for all trees in the internal list
 double Management::aggregate_function(QString expression, QString filter, QString type)
 {
-    QList<QPair<Tree*, double> >::iterator tp=mTrees.begin();
-    TreeWrapper tw;
-    Expression expr(expression,&tw);
-
     double sum = 0.;
     int n=0;
     try {
-
+        QVector<double> values;
         if (filter.isEmpty()) {
             // without filtering
-            while (tp!=mTrees.end()) {
-                tw.setTree(tp->first);
-                sum += expr.calculate();
-                ++n;
-                ++tp;
-            }
+            TreeListEngine::evaluate(expression, mTrees, values);
         } else {
-            // with filtering
-            Expression filter_expr(filter,&tw);
-            filter_expr.enableIncSum();
-            while (tp!=mTrees.end()) {
-                tw.setTree(tp->first);
-                if (filter_expr.calculate()) {
-                    sum += expr.calculate();
-                    ++n;
-                }
-                ++tp;
-            }
+            // with filtering: evaluate the expression only for trees passing the filter
+            TreeListEngine::evaluate(filter, mTrees, values);
+            TreeListEngine::List filtered;
+            filtered.reserve(mTrees.count());
+            for (int i=0;i<mTrees.count();++i)
+                if (values[i])
+                    filtered.push_back(mTrees[i]);
+            TreeListEngine::evaluate(expression, filtered, values);
         }
+        // sum up in list order
+        for (int i=0;i<values.size();++i)
+            sum += values[i];
+        n = values.size();
 
     } catch(const IException &e) {
          ScriptGlobal::throwError(e.message());
@@ -371,13 +363,11 @@ int Management::filterIdList(QVariantList idList)
 //    foreach(const QVariant &v, idList)
 //        ids[v.toInt()] = 1;
 
-    QList<QPair<Tree*, double> >::iterator tp=mTrees.begin();
-    while (tp!=mTrees.end()) {
-        if (!ids.contains(tp->first->id()) )
-            tp = mTrees.erase(tp);
-        else
-            ++tp;
-    }
+    int n_keep = 0;
+    for (int i=0;i<mTrees.count();++i)
+        if (ids.contains(mTrees[i].first->id()))
+            mTrees[n_keep++] = mTrees[i];
+    mTrees.resize(n_keep);
     if (logLevelDebug())
         qDebug() << "Management::filter by id-list:" << mTrees.count();
     return mTrees.count();
@@ -385,28 +375,23 @@ int Management::filterIdList(QVariantList idList)
 
 int Management::filter(QString filter)
 {
-    TreeWrapper tw;
-    Expression expr(filter,&tw);
-    expr.enableIncSum();
     int n_before = mTrees.count();
-    QPair<Tree*, double> empty_tree(nullptr,0.);
     try {
-        for (QList< QPair<Tree*, double> >::iterator it=mTrees.begin(); it!=mTrees.end(); ++it) {
-
-            tw.setTree(it->first); // iterate
-
-            double value = expr.calculate(tw);
+        QVector<double> values;
+        TreeListEngine::evaluate(filter, mTrees, values);
+        int n_keep = 0;
+        for (int i=0;i<mTrees.count();++i) {
+            double value = values[i];
             // keep if expression returns true (1)
             bool keep = value==1.;
             // if value is >0 (i.e. not "false"), then draw a random number
             if (!keep && value>0.)
                 keep = drandom() < value;
 
-            if (!keep)
-                *it = empty_tree;
-
+            if (keep)
+                mTrees[n_keep++] = mTrees[i];
         }
-        mTrees.removeAll(empty_tree);
+        mTrees.resize(n_keep);
     } catch(const IException &e) {
         ScriptGlobal::throwError(e.message());
     }
@@ -431,23 +416,26 @@ int Management::loadResourceUnit(int ruindex)
 
 int Management::load(QString filter)
 {
-    TreeWrapper tw;
     Model *m = GlobalSettings::instance()->model();
     mTrees.clear();
     AllTreeIterator at(m);
-    if (filter.isEmpty()) {
-        while (Tree *t=at.nextLiving())
-            if (!t->isDead())
-                mTrees.push_back(QPair<Tree*, double>(t, 0.));
-    } else {
-        Expression expr(filter,&tw);
-        expr.enableIncSum();
+    while (Tree *t=at.nextLiving())
+        if (!t->isDead())
+            mTrees.push_back(QPair<Tree*, double>(t, 0.));
+    if (!filter.isEmpty()) {
         if (logLevelDebug())
             qDebug() << "filtering with" << filter;
-        while (Tree *t=at.nextLiving()) {
-            tw.setTree(t);
-            if (!t->isDead() && expr.execute())
-                mTrees.push_back(QPair<Tree*, double>(t, 0.));
+        try {
+            QVector<double> values;
+            TreeListEngine::evaluate(filter, mTrees, values);
+            int n_keep = 0;
+            for (int i=0;i<mTrees.count();++i)
+                if (values[i])
+                    mTrees[n_keep++] = mTrees[i];
+            mTrees.resize(n_keep);
+        } catch(const IException &e) {
+            mTrees.clear();
+            ScriptGlobal::throwError(e.message());
         }
     }
     return mTrees.count();
@@ -618,15 +606,40 @@ bool treePairValue(const QPair<Tree*, double> &p1, const QPair<Tree*, double> &p
 
 void Management::sort(QString statement)
 {
-    TreeWrapper tw;
-    Expression sorter(statement, &tw);
-    // fill the "value" part of the tree storage with a value for each tree
-    for (int i=0;i<mTrees.count(); ++i) {
-        tw.setTree(mTrees.at(i).first);
-        mTrees[i].second = sorter.execute();
-   }
-   // now sort the list....
-   std::sort(mTrees.begin(), mTrees.end(), treePairValue);
+    try {
+        // fill the "value" part of the tree storage with a value for each tree and sort the list
+        TreeListEngine::sort(mTrees, statement);
+    } catch(const IException &e) {
+        ScriptGlobal::throwError(e.message());
+    }
+}
+
+void Management::sortTop(QString statement, int n)
+{
+    try {
+        TreeListEngine::partialSort(mTrees, statement, n);
+    } catch(const IException &e) {
+        ScriptGlobal::throwError(e.message());
+    }
+}
+
+void Management::sortMulti(QStringList statements)
+{
+    try {
+        TreeListEngine::sortMultiKey(mTrees, statements);
+    } catch(const IException &e) {
+        ScriptGlobal::throwError(e.message());
+    }
+}
+
+double Management::percentileOf(QString expression, int pct)
+{
+    try {
+        return TreeListEngine::percentile(mTrees, expression, pct);
+    } catch(const IException &e) {
+        ScriptGlobal::throwError(e.message());
+    }
+    return -1.;
 }
 
 double Management::percentile(int pct)
@@ -25,6 +25,7 @@
 #include <QtCore/QVariantList>
 #include "scriptglobal.h"
 #include "scripttree.h"
+#include "treelistengine.h"
 
 class Tree;
 class QJSEngine;
@@ -119,6 +120,12 @@ public slots:
        */
     void slashSnags(MapGridWrapper *wrap, int key, double slash_fraction);
     void sort(QString statement); ///< sort trees in the list according to a criterion
+    /// sort only the first 'n' trees of the list according to 'statement' (faster than a full sort if only the top n trees are needed)
+    void sortTop(QString statement, int n);
+    /// sort trees by multiple criteria (the first expression is the primary key, ties are resolved by the next expression, ...)
+    void sortMulti(QStringList statements);
+    /// value of the 'pct' percentile (0..100) of 'expression' evaluated for the trees in the list (the list is not changed)
+    double percentileOf(QString expression, int pct);
     int filter(QString filter); ///< apply a filter on the list of trees (expression), return number of remaining trees.
     int filterIdList(QVariantList idList); ///< apply filter in form of a list of ids, return number of remaining trees
     void randomize(); ///< random shuffle of all trees in the list
@@ -131,7 +138,7 @@ private:
     // removal fractions
     double mRemoveFoliage, mRemoveBranch, mRemoveStem;
     QString mScriptFile;
-    QList<QPair<Tree*, double> > mTrees;
+    TreeListEngine::List mTrees;
     QJSEngine *mEngine;
     int mRemoved;
     QJSValue mTreeValue;
@@ -15,6 +15,12 @@ Microclimate::Microclimate(const ResourceUnit *ru)
 {
     mRU = ru;
     mCells = new MicroclimateCell[cHeightPerRU*cHeightPerRU];
+    mCoefficients = new CellCoefficients[cHeightPerRU*cHeightPerRU];
+    mVegetation = new CellVegetation[cHeightPerRU*cHeightPerRU];
+    mTrackedTrees = 0;
+    mYearsSinceScan = 0;
+    mVegetationValid = false;
+    mHasRUValues = false;
     mIsSetup = false;
     // setup of effect switches (static variable)
     mSettings.barkbeetle_effect = GlobalSettings::instance()->settings().valueBool("model.climate.microclimate.barkbeetle");
@@ -25,84 +31,155 @@ Microclimate::Microclimate(const ResourceUnit *ru)
 Microclimate::~Microclimate()
 {
     delete[] mCells;
+    delete[] mCoefficients;
+    delete[] mVegetation;
 }
 
 void Microclimate::calculateVegetation()
 {
-    QVector<double> ba_total(cHeightPerRU*cHeightPerRU, 0.);
-    QVector<double> lai_total(cHeightPerRU*cHeightPerRU, 0.);
-    QVector<double> shade_tol(cHeightPerRU*cHeightPerRU, 0.);
+    const int n_cells = cHeightPerRU*cHeightPerRU;
 
-    if (!mIsSetup)
+    bool changed = false;
+    if (!mIsSetup) {
         // calculate (only once) northness and other factors that only depend on elevation model
         calculateFixedFactors();
-
-
-    // loop over trees and calculate aggregate values
-    for ( QVector<Tree>::const_iterator t = mRU->constTrees().constBegin(); t != mRU->constTrees().constEnd(); ++t) {
-        int idx = cellIndex(t->position());
-        ba_total[idx] += t->basalArea();
-        lai_total[idx] += t->leafArea();
-        // shade-tolerance uses species parameter light response class
-        shade_tol[idx] += t->species()->lightResponseClass() * t->basalArea();
+        changed = true;
     }
 
-    // now write back to the microclimate store
-    for (int i=0;i<cHeightPerRU*cHeightPerRU; ++i) {
-        double lai = limit(lai_total[i] / cHeightPixelArea, 0.3, 9.4); // m2/m2
-        double stol = limit(ba_total[i] > 0. ? shade_tol[i] / ba_total[i] : 0., 1., 5.);
-        cell(i).setLAI( lai ); // calculate m2/m2
-        cell(i).setShadeToleranceMean( stol);
+    // the aggregates per cell are updated by the trees (growth, mortality, harvest, disturbances, recruitment).
+    // A full scan is done in the first year, every cFullScanInterval years, and if the number of trees
+    // does not match (i.e. trees were created or changed without notification, e.g. when loading a snapshot).
+    int n_trees = 0;
+    for ( QVector<Tree>::const_iterator t = mRU->constTrees().constBegin(); t != mRU->constTrees().constEnd(); ++t)
+        if (!t->isDead())
+            ++n_trees;
+    ++mYearsSinceScan;
+    if (!mVegetationValid || n_trees != mTrackedTrees || mYearsSinceScan >= cFullScanInterval)
+        scanTrees();
+
+    // now write back to the microclimate store; the regression terms are updated
+    // only for cells with changed (stored) values
+    for (int i=0;i<n_cells; ++i) {
+        const CellVegetation &v = mVegetation[i];
+        double lai = limit(v.leaf_area / cHeightPixelArea, 0.3, 9.4); // m2/m2
+        double stol = limit(v.basal_area > 0. ? v.shade_tol / v.basal_area : 0., 1., 5.);
+        MicroclimateCell &c = cell(i);
+        double old_lai = c.LAI();
+        double old_stol = c.shadeToleranceMean();
+        c.setLAI( lai ); // calculate m2/m2
+        c.setShadeToleranceMean( stol);
+        if (c.LAI() != old_lai || c.shadeToleranceMean() != old_stol || changed) {
+            updateCoefficients(i);
+            changed = true;
+        }
     }
 
     // do additionally calculate and buffer values on RU resolution for performance reasons
-    calculateRUMeanValues();
+    calculateRUMeanValues(changed);
+
+}
+
+void Microclimate::scanTrees()
+{
+    for (int i=0;i<cHeightPerRU*cHeightPerRU;++i) {
+        CellVegetation &v = mVegetation[i];
+        v.basal_area = v.leaf_area = v.shade_tol = 0.;
+        v.trees = 0;
+    }
+    mTrackedTrees = 0;
+    mVegetationValid = true; // addTree() is a no-op otherwise
+    for ( QVector<Tree>::const_iterator t = mRU->constTrees().constBegin(); t != mRU->constTrees().constEnd(); ++t)
+        if (!t->isDead())
+            addTree(&(*t));
+    mYearsSinceScan = 0;
+}
+
+void Microclimate::addTree(const Tree *tree)
+{
+    if (!mVegetationValid)
+        return;
+    if (!mRU->boundingBox().contains(tree->position())) {
+        // position not (yet) set: the next calculateVegetation() does a full scan
+        mVegetationValid = false;
+        return;
+    }
+    CellVegetation &v = mVegetation[cellIndex(tree->position())];
+    v.basal_area += tree->basalArea();
+    v.leaf_area += tree->leafArea();
+    // shade-tolerance uses species parameter light response class
+    v.shade_tol += tree->species()->lightResponseClass() * tree->basalArea();
+    ++v.trees;
+    ++mTrackedTrees;
+}
 
+void Microclimate::removeTree(const Tree *tree)
+{
+    if (!mVegetationValid)
+        return;
+    CellVegetation &v = mVegetation[cellIndex(tree->position())];
+    if (--v.trees <= 0) {
+        // reset empty cells (no accumulation of rounding errors)
+        v.basal_area = v.leaf_area = v.shade_tol = 0.;
+        v.trees = 0;
+    } else {
+        v.basal_area -= tree->basalArea();
+        v.leaf_area -= tree->leafArea();
+        v.shade_tol -= tree->species()->lightResponseClass() * tree->basalArea();
+    }
+    --mTrackedTrees;
 }
 
+void Microclimate::updateTree(const Tree *tree, double old_basal_area, double old_leaf_area)
+{
+    if (!mVegetationValid)
+        return;
+    CellVegetation &v = mVegetation[cellIndex(tree->position())];
+    const double d_ba = tree->basalArea() - old_basal_area;
+    v.basal_area += d_ba;
+    v.leaf_area += tree->leafArea() - old_leaf_area;
+    v.shade_tol += tree->species()->lightResponseClass() * d_ba;
+}
 
-void Microclimate::calculateRUMeanValues()
+void Microclimate::updateCoefficients(int index)
 {
+    const MicroclimateCell &c = constCell(index);
+    mCoefficients[index].min_base = c.minimumBufferingBase();
+    mCoefficients[index].max_base = c.maximumBufferingBase();
+}
 
 
-    // run over the year
-    double buffer_min;
-    double buffer_max;
-    int n;
-    const ClimateDay *cday;
+void Microclimate::calculateRUMeanValues(bool vegetation_changed)
+{
+    // mean min / max temperature per month (calculated once per climate and year)
+    const double *clim_tmin = mRU->climate()->minTemperatureMonth();
+    const double *clim_tmax = mRU->climate()->maxTemperatureMonth();
     double mean_tmin[12];
     double mean_tmax[12];
-
-    for (int i=0;i<12;++i) {
-        mean_tmin[i] = 0.;
-        mean_tmax[i] = 0.;
-    }
-    // calculate mean min / max temperature
-    for (cday = mRU->climate()->begin(); cday != mRU->climate()->end(); ++cday) {
-        mean_tmin[cday->month - 1] += cday->min_temperature;
-        mean_tmax[cday->month - 1] += cday->max_temperature;
-    }
+    bool climate_changed = !mHasRUValues;
     for (int i=0;i<12;++i) {
-        mean_tmin[i] /= mRU->climate()->days(i);
-        mean_tmax[i] /= mRU->climate()->days(i);
         // limit to values in statistical model
-        mean_tmin[i] = limit(mean_tmin[i], -12.4, 16.5);
-        mean_tmax[i] = limit(mean_tmax[i], -5.4, 44.9);
+        mean_tmin[i] = limit(clim_tmin[i], -12.4, 16.5);
+        mean_tmax[i] = limit(clim_tmax[i], -5.4, 44.9);
+        if (mean_tmin[i] != mLastMeanTMin[i] || mean_tmax[i] != mLastMeanTMax[i])
+            climate_changed = true;
     }
+    // nothing to do if neither the vegetation nor the climate changed
+    if (!vegetation_changed && !climate_changed)
+        return;
 
+    const int n = mValidCells.size();
+    const int *valid = mValidCells.constData();
     // run calculations
     for (int m=0;m<12;++m) {
-        // loop over all cells and calculate buffering
-        buffer_min=0.;
-        buffer_max=0.;
-        n=0;
-        for (int i=0;i < cHeightPerRU*cHeightPerRU; ++i) {
-            if (mCells[i].valid()) {
-
-                buffer_min += mCells[i].minimumMicroclimateBuffering(mean_tmin[m]);
-                buffer_max += mCells[i].maximumMicroclimateBuffering(mean_tmax[m]);
-                ++n;
-            }
+        // loop over all (valid) cells and calculate buffering
+        const double min_term = MicroclimateCell::cMinBufferSlope * mean_tmin[m];
+        const double max_term = MicroclimateCell::cMaxBufferSlope * mean_tmax[m];
+        double buffer_min=0.;
+        double buffer_max=0.;
+        for (int i=0;i < n; ++i) {
+            const CellCoefficients &cc = mCoefficients[valid[i]];
+            buffer_min += MicroclimateCell::limitBuffering(cc.min_base + min_term);
+            buffer_max += MicroclimateCell::limitBuffering(cc.max_base + max_term);
         }
 
         // calculate mean values for RU and save for later
@@ -123,8 +200,11 @@ void Microclimate::calculateRUMeanValues()
 
         mRUvalues[m] = QPair<float, float>(static_cast<float>(buffer_min),
                                              static_cast<float>(buffer_max));
+        mLastMeanTMin[m] = mean_tmin[m];
+        mLastMeanTMax[m] = mean_tmax[m];
 
     }
+    mHasRUValues = true;
 
 }
 
@@ -149,7 +229,7 @@ double Microclimate::meanMicroclimateBufferingRU(int month) const
 
 
 
-int Microclimate::cellIndex(const QPointF &coord)
+int Microclimate::cellIndex(const QPointF &coord) const
 {
     // convert to index
     QPointF local = coord - mRU->boundingBox().topLeft();
@@ -175,11 +255,14 @@ void Microclimate::calculateFixedFactors()
     const DEM *dem =  GlobalSettings::instance()->model()->dem();
 
     HeightGrid *hg = GlobalSettings::instance()->model()->heightGrid();
+    // the TPI is calculated once for the full DEM (see Model::beforeRun())
+    const FloatGrid *tpi_grid = dem->topographicPositionIndexGrid(cTPIRadius);
+    const FloatGrid *aspect_grid = dem->aspectGrid();
 
     for (int i=0;i<cHeightPerRU*cHeightPerRU; ++i) {
         QPointF p = cellCoord(i);
 
-        double aspect = dem->aspectGrid()->constValueAt(p)*M_PI / 180.;
+        double aspect = aspect_grid->constValueAt(p)*M_PI / 180.;
         double northness = cos(aspect);
 
         // slope
@@ -187,8 +270,7 @@ void Microclimate::calculateFixedFactors()
         //slope = atan(slope) * 180./M_PI; // convert degree, thanks Kristin for spotting the error in a previous version
 
         // topographic position
-        const int radius = 500;
-        double tpi = dem->topographicPositionIndex(p, radius);
+        double tpi = tpi_grid->constValueAt(p);
 
         // limit values to range of predictors in statistical model
         //northness = limit(northness, -1, 1)
@@ -200,6 +282,8 @@ void Microclimate::calculateFixedFactors()
         // we only process cells that are stockable
         if (!hg->constValueAt(p).isValid())
             cell(i).setInvalid();
+        else
+            mValidCells.push_back(i);
 
     }
 
@@ -378,36 +462,31 @@ double MicroclimateCell::maximumMicroclimateBuffering(const ResourceUnit *ru, in
     return maximumMicroclimateBuffering(mean_temp);
 }
 
-double MicroclimateCell::minimumMicroclimateBuffering(double macro_t_min) const
+double MicroclimateCell::minimumBufferingBase() const
 {
     // old: "Minimum temperature buffer ~ -1.7157325 - 0.0187969*North + 0.0161997*RelEmin500 + 0.0890564*lai + 0.3414672*stol + 0.8302521*GSI + 0.0208083*prop_evergreen - 0.0107308*GSI:prop_evergreen"
     // Buffer_minT = 0.6077 – 0.0088 * Macroclimate_minT + 0.3548 * Northness  + 0.0872 * Slope + 0.0202 * TPI - 0.0330 * LAI + 0.0502 * STol – 0.7601 * Evergreen – 0.8385 * GSI:Evergreen
     // version nov 2023: Tminbuffer = 1.4570 - 0.0248 × Tminmacroclimate + 0.2627 × Northness + 0.0158 × TPI + 0.0227 × LAI - 0.2031 × STol
+    // the temperature term (cMinBufferSlope * macro_t_min) is added in minimumMicroclimateBuffering()
     double buf = 1.4570 +
-                 -0.0248 *macro_t_min +
                  0.2627*northness() +
                  0.0158*topographicPositionIndex() +
                  0.0227*LAI() +
                  -0.2031*shadeToleranceMean() ;
-    if (abs(buf)>10)
-        buf=0;
     return buf;
 
 }
 
-double MicroclimateCell::maximumMicroclimateBuffering(double macro_t_max) const
+double MicroclimateCell::maximumBufferingBase() const
 {
     // old: "Maximum temperature buffer ~ 1.9058391 - 0.2528409*North - 0.0027037*RelEmin500 - 0.1549061*lai - 0.3806543*stol - 1.2863341*GSI - 0.8070951*prop_evergreen + 0.5004421*GSI:prop_evergreen"
     // Buffer_maxT = 2.7839 – 0.2729 * Macroclimate_maxT - 0.5403 * Northness  - 0.1127 * Slope + 0.0155 * TPI – 0.3182 * LAI + 0.1403 * STol – 1.1039 * Evergreen + 6.9670 * GSI:Evergreen
     // version nov 23: Tmaxbuffer = 0.9767 - 0.1932 × Tmaxmacroclimate - 0.5729 × Northness + 0.0140 × TPI - 0.3948 × LAI + 0.4419 × STol
+    // the temperature term (cMaxBufferSlope * macro_t_max) is added in maximumMicroclimateBuffering()
     double buf = 0.9767 +
-                 -0.1932*macro_t_max +
                  -0.5729*northness() +
                  0.0140*topographicPositionIndex() +
                  -0.3948*LAI() +
                  0.4419*shadeToleranceMean();
-
-    if (abs(buf)>10)
-        buf=0;
     return buf;
 }
@@ -5,6 +5,7 @@
 #include "grid.h"
 
 class ResourceUnit; // forward
+class Tree;
 
 // data structure for a single cell with 10m size
 // the MicroclimateCell stores vegetation information
@@ -51,8 +52,17 @@ public:
     double maximumMicroclimateBuffering(const ResourceUnit *ru, int month) const;
 
     /// faster calculation minimum microclimate buffering, when growingseasonindex is known
-    double minimumMicroclimateBuffering(double macro_t_min) const;
-    double maximumMicroclimateBuffering(double macro_t_max) const;
+    double minimumMicroclimateBuffering(double macro_t_min) const { return limitBuffering(minimumBufferingBase() + cMinBufferSlope*macro_t_min); }
+    double maximumMicroclimateBuffering(double macro_t_max) const { return limitBuffering(maximumBufferingBase() + cMaxBufferSlope*macro_t_max); }
+
+    /// the buffering regressions are linear in the macroclimate temperature: buffer = base + slope * T
+    /// the base values include all cell specific terms (topography and vegetation)
+    double minimumBufferingBase() const;
+    double maximumBufferingBase() const;
+    static constexpr double cMinBufferSlope = -0.0248; ///< slope of the macroclimate min. temperature
+    static constexpr double cMaxBufferSlope = -0.1932; ///< slope of the macroclimate max. temperature
+    /// values outside of +-10 degrees are considered invalid (and set to 0)
+    static double limitBuffering(double buf) { return std::abs(buf)>10 ? 0. : buf; }
 
 private:
     // use 16 bit per value
@@ -71,8 +81,17 @@ public:
     ~Microclimate();
 
     /// analyze vegetation on resource unit and calculate indices
+    /// RU means are only recalculated if the vegetation of a cell or the climate changed
     void calculateVegetation();
 
+    // incremental update of the vegetation aggregates of the cells (basal area, leaf area, shade tolerance)
+    /// a new (living) tree is added to the resource unit
+    void addTree(const Tree *tree);
+    /// a living tree is removed (died, harvested, killed by a disturbance)
+    void removeTree(const Tree *tree);
+    /// the dimensions of a living tree changed (growth, biomass removal); old values are the values before the change
+    void updateTree(const Tree *tree, double old_basal_area, double old_leaf_area);
+
     // get resource unit aggregates
 
     //void microclimateBuffering;
@@ -92,7 +111,7 @@ public:
     MicroclimateCell &cell(int index) { Q_ASSERT(index>=0 && index < 100); return mCells[index]; }
     const MicroclimateCell &constCell(int index) const { Q_ASSERT(index>=0 && index < 100); return mCells[index]; }
     /// get the cell located at a given metric location
-    int cellIndex(const QPointF &coord);
+    int cellIndex(const QPointF &coord) const;
     QPointF cellCoord(int index);
 
     // settings struct
@@ -102,12 +121,39 @@ public:
         bool establishment_effect;
     };
     const MicroClimateSettings &settings() const { return mSettings; }
+    /// radius (m) used for the topographic position index
+    static const int cTPIRadius = 500;
 private:
     void calculateFixedFactors();
-    void calculateRUMeanValues();
+    /// recalculate the vegetation aggregates of all cells from the trees of the resource unit
+    void scanTrees();
+    void calculateRUMeanValues(bool vegetation_changed);
+    void updateCoefficients(int index);
     const ResourceUnit *mRU;
     MicroclimateCell *mCells;
+    // precomputed regression terms per cell (only valid cells, see updateCoefficients())
+    struct CellCoefficients {
+        double min_base;
+        double max_base;
+    };
+    CellCoefficients *mCoefficients;
+    QVector<int> mValidCells; ///< indices of cells that are stockable
     QPair<float, float> mRUvalues[12]; // save min/max buffering per month
+    double mLastMeanTMin[12]; ///< macro climate values used for the last calculation of mRUvalues
+    double mLastMeanTMax[12];
+    bool mHasRUValues; ///< true if mRUvalues are calculated
+    // vegetation aggregates per cell, updated incrementally by the trees (see addTree(), removeTree(), updateTree())
+    struct CellVegetation {
+        double basal_area; ///< sum of basal area (m2)
+        double leaf_area; ///< sum of leaf area (m2)
+        double shade_tol; ///< sum of basal area * light response class
+        int trees; ///< number of living trees
+    };
+    CellVegetation *mVegetation;
+    int mTrackedTrees; ///< number of trees included in mVegetation
+    int mYearsSinceScan; ///< years since the last full scan of the trees
+    bool mVegetationValid; ///< false: the aggregates need a full scan of the trees
+    static const int cFullScanInterval = 10; ///< interval (years) of a full scan (to avoid drift of the incremental sums)
     bool mIsSetup;
 
     static MicroClimateSettings mSettings;
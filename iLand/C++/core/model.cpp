@@ -33,6 +33,9 @@
 
 #include "xmlhelper.h"
 #include "debugtimer.h"
+#include "tracer.h"
+#include "gridallocator.h"
+#include "statechecksum.h"
 #include "environment.h"
 #include "timeevents.h"
 #include "helper.h"
@@ -45,6 +48,7 @@
 #include "tree.h"
 #include "management.h"
 #include "saplings.h"
+#include "establishment.h"
 #include "modelsettings.h"
 #include "standstatistics.h"
 #include "mapgrid.h"
@@ -53,6 +57,8 @@
 #include "dem.h"
 #include "grasscover.h"
 #include "svdstate.h"
+#include "carboncyclebatch.h"
+#include "treeremovalevents.h"
 
 #include "outputmanager.h"
 
@@ -121,6 +127,7 @@ Tree *AllTreeIterator::current() const
 /// multithreaded execution of the microclimate routine
 static void nc_microclimate(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("microclimateRU", unit->index());
     try {
         unit->analyzeMicroclimate();
 
@@ -167,6 +174,8 @@ void Model::initialize()
    mGrassCover = nullptr;
    mSaplings=nullptr;
    mSVDStates=nullptr;
+   mCarbonCycleBatch=nullptr;
+   mScriptGCInterval = 1;
 }
 
 /** sets up the simulation space.
@@ -196,10 +205,12 @@ void Model::setupSpace()
         throw IException("setup of the world: definition of project area (width/height/buffer) invalid or too large.");
     }
     mGrid->initialize(1.f);
+    GridAllocator::setName(mGrid->begin(), "lif");
     if (mHeightGrid)
         delete mHeightGrid;
     mHeightGrid = new HeightGrid(total_grid, static_cast<float>(cellSize)*cPxPerHeight);
     mHeightGrid->wipe(); // set all to zero
+    GridAllocator::setName(mHeightGrid->begin(), "height");
     Tree::setGrid(mGrid, mHeightGrid);
 
     // setup the spatial location of the project area
@@ -313,7 +324,7 @@ void Model::setupSpace()
                     throw IException(err_msg);
                 }
                 new_ru->setSpeciesSet( mEnvironment->speciesSet() );
-                new_ru->setup();
+                new_ru->setup( mEnvironment->siteParameters() );
                 mRU.append(new_ru);
                 *p = new_ru; // save in the RUmap grid
             }
@@ -366,6 +377,9 @@ void Model::setupSpace()
 
         }
 
+        // release the memory of the LIF grid far outside of the project area (if enabled)
+        setupSparseGrid();
+
         // list of "valid" resource units
         QList<ResourceUnit*> valid_rus;
         foreach(ResourceUnit* ru, mRU)
@@ -429,6 +443,8 @@ void Model::setupSpace()
         threadRunner.setMultithreading(do_multithreading);
         threadRunner.print();
 
+        if (logLevelInfo())
+            GridAllocator::logUsage();
 
     } else  {
         throw IException("resourceUnitsAsGrid MUST be set to true - at least currently :)");
@@ -443,16 +459,20 @@ void Model::setupSpace()
 void Model::clear()
 {
     mSetup = false;
+    TreeRemovalEvents::clear();
     qDebug() << "Model clear: attempting to clear" << mRU.count() << "RU, " << mSpeciesSets.count() << "SpeciesSets.";
     // clear ressource units
     qDeleteAll(mRU); // delete ressource units (and trees)
     mRU.clear();
+    ResourceUnit::freeSaplingCellPool();
+    mLIFActiveSpans.clear();
 
     qDeleteAll(mSpeciesSets); // delete species sets
     mSpeciesSets.clear();
 
     // delete climate data
     qDeleteAll(mClimates);
+    Establishment::clearClimateCache(); // cache is keyed by climate (and species)
 
     // delete the grids
     if (mGrid)
@@ -483,6 +503,8 @@ void Model::clear()
         delete mSVDStates;
     if (mBiteEngine)
         delete  mBiteEngine;
+    if (mCarbonCycleBatch)
+        delete mCarbonCycleBatch;
 
     mGrid = nullptr;
     mHeightGrid = nullptr;
@@ -496,6 +518,7 @@ void Model::clear()
     mABEManagement = nullptr;
     mBiteEngine = nullptr;
     mSVDStates = nullptr;
+    mCarbonCycleBatch = nullptr;
 
     GlobalSettings::instance()->outputManager()->close();
 
@@ -538,6 +561,9 @@ void Model::loadProject()
     mSettings.print();
 
     DebugTimer::setResponsiveMode(xml.valueBool("system.settings.responsive"));
+    Tracer::setup(xml);
+    GridAllocator::setup(xml);
+    StateChecksum::setup(xml);
 
     // random seed: if stored value is <> 0, use this as the random seed (and produce hence always an equal sequence of random numbers)
     uint seed = xml.value("system.settings.randomSeed","0").toUInt();
@@ -548,6 +574,8 @@ void Model::loadProject()
     Expression::setLinearizationEnabled(do_linearization);
     if (do_linearization)
         qDebug() << "The linearization of expressions is enabled (performance optimization).";
+    // garbage collection of the javascript engine: every n years (0: never)
+    mScriptGCInterval = xml.valueInt("system.settings.scriptGarbageCollectionInterval", 1);
 
     // log level
     QString log_level = xml.value("system.settings.logLevel", "debug").toLower();
@@ -558,6 +586,11 @@ void Model::loadProject()
 
     // snag dynamics / soil model enabled? (info used during setup of world)
     changeSettings().carbonCycleEnabled = xml.valueBool("model.settings.carbonCycleEnabled", false);
+    if (mCarbonCycleBatch) {
+        delete mCarbonCycleBatch; mCarbonCycleBatch=nullptr;
+    }
+    if (settings().carbonCycleEnabled && xml.valueBool("model.settings.soil.batched", false))
+        mCarbonCycleBatch = new CarbonCycleBatch(); // soil dynamics of all resource units in a batch
     // class size of snag classes
     Snag::setupThresholds(xml.valueDouble("model.settings.soil.swdDBHClass12"),
                           xml.valueDouble("model.settings.soil.swdDBHClass23"));
@@ -675,6 +708,7 @@ void Model::initOutputDatabase()
 /// multithreaded run function for resource unit level establishment
 static void nc_establishment(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("establishmentRU", unit->index());
     Saplings *s = GlobalSettings::instance()->model()->saplings();
     try {
         s->establishment(unit);
@@ -688,6 +722,7 @@ static void nc_establishment(ResourceUnit *unit)
 /// multithreaded run function for resource unit level establishment
 static void nc_sapling_growth(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("saplingGrowthRU", unit->index());
     Saplings *s = GlobalSettings::instance()->model()->saplings();
     try {
         s->saplingGrowth(unit);
@@ -702,6 +737,7 @@ static void nc_sapling_growth(ResourceUnit *unit)
 /// multithreaded execution of the carbon cycle routine
 static void nc_carbonCycle(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("carbonCycleRU", unit->index());
     try {
         // (1) do calculations on snag dynamics for the resource unit
         unit->calculateCarbonCycle();
@@ -712,6 +748,56 @@ static void nc_carbonCycle(ResourceUnit *unit)
 
 }
 
+/// multithreaded bookkeeping of resource units: start of the year
+static void nc_newYear(ResourceUnit *unit)
+{
+    try {
+        unit->newYear();
+    } catch (const IException& e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
+/// multithreaded bookkeeping of resource units: statistics and carbon flows at the end of the year
+static void nc_yearEnd(ResourceUnit *unit)
+{
+    TRACE_SCOPE_RU("yearEndRU", unit->index());
+    try {
+        unit->yearEnd();
+    } catch (const IException& e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
+/// multithreaded removal of dead trees (and recalculation of statistics)
+static void nc_cleanTreeListRecalculate(ResourceUnit *unit)
+{
+    if (unit->hasDiedTrees()) {
+        unit->cleanTreeList();
+        unit->recreateStandStatistics(true);
+    }
+}
+
+/// multithreaded removal of dead trees (statistics are calculated later in yearEnd())
+static void nc_cleanTreeList(ResourceUnit *unit)
+{
+    if (unit->hasDiedTrees()) {
+        unit->cleanTreeList();
+        unit->recreateStandStatistics(false);
+    }
+}
+
+/// multithreaded creation of the initial stand statistics
+static void nc_createStandStatistics(ResourceUnit *unit)
+{
+    try {
+        unit->addTreeAgingForAllTrees();
+        unit->createStandStatistics();
+    } catch (const IException& e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
 
 /// beforeRun performs several steps before the models starts running.
 /// inter alia: * setup of the stands
@@ -758,6 +844,9 @@ void Model::beforeRun()
     if (Model::settings().microclimateEnabled) {
         MicroclimateVisualizer::setupVisualization();
         DebugTimer t("Microclimate setup");
+        // topographic indices are derived once for the full landscape (multithreaded)
+        if (mDEM)
+            mDEM->topographicPositionIndexGrid(Microclimate::cTPIRadius);
         executePerResourceUnit(nc_microclimate, false /* true to force single threaded execution */);
 
     }
@@ -795,6 +884,7 @@ void Model::beforeRun()
     GlobalSettings::instance()->outputManager()->execute("devstage"); // year=0
     GlobalSettings::instance()->outputManager()->execute("ecoviz"); // tree output for visualization, year 0
     GlobalSettings::instance()->outputManager()->execute("customagg"); // custom aggregation, much like dynamic stand, year 0
+    GlobalSettings::instance()->outputManager()->execute("raster"); // binary raster output, year 0
     GlobalSettings::instance()->outputManager()->save(); // commit database changes
 
 
@@ -817,24 +907,33 @@ void Model::beforeRun()
   */
 void Model::runYear()
 {
+    // write the trace events of the previous year (no worker threads are active here)
+    Tracer::flush();
+    TreeRemovalEvents::dispatch(); // removals between years (e.g. by scripts)
+    TRACE_SCOPE("runYear");
     DebugTimer t_all("Model::runYear()");
     GlobalSettings::instance()->systemStatistics()->reset();
     threadRunner.clearErrors();
     RandomGenerator::checkGenerator(); // see if we need to generate new numbers...
     // initalization at start of year for external modules
     mModules->yearBegin();
+    mModules->runPhase(YearLoopInterface::YearBegin);
 
     // execute scheduled events for the current year
-    if (mTimeEvents)
+    if (mTimeEvents) {
+        TRACE_SCOPE("timeEvents");
         mTimeEvents->run();
+    }
 
     // load the next year of the climate database (except for the first year - the first climate year is loaded immediately
     if (GlobalSettings::instance()->currentYear()>1) {
+        TRACE_SCOPE("climate");
         foreach(Climate *c, mClimates)
             c->nextYear();
     }
     // run microclimate
     if (Model::settings().microclimateEnabled) {
+        TRACE_SCOPE("microclimate");
         DebugTimer t("Microclimate");
         executePerResourceUnit(nc_microclimate, false /* true to force single threaded execution */);
     }
@@ -842,14 +941,18 @@ void Model::runYear()
     WaterCycle::resetPsiMin();
 
     // reset statistics
-    foreach(ResourceUnit *ru, mRU)
-        ru->newYear();
+    {
+    TRACE_SCOPE("newYear");
+    executePerResourceUnit(nc_newYear, false /* true: force single threaded operation */);
+    threadRunner.checkErrors();
 
     foreach(SpeciesSet *set, mSpeciesSets)
         set->newYear();
+    }
 
     // management classic
     if (mManagement) {
+        TRACE_SCOPE("management");
         setCurrentTask("Management");
         DebugTimer t("management");
         mManagement->run();
@@ -857,6 +960,7 @@ void Model::runYear()
     }
     // ... or ABE (the agent based variant)
     if (mABEManagement) {
+        TRACE_SCOPE("ABE");
         DebugTimer t("ABE:run");
         setCurrentTask("ABE");
         mABEManagement->run();
@@ -865,26 +969,48 @@ void Model::runYear()
 
     // if trees are dead/removed because of management, the tree lists
     // need to be cleaned (and the statistics need to be recreated)
+    {
+    TRACE_SCOPE("cleanTreeLists");
     cleanTreeLists(true); // recalculate statistics (LAIs per species needed later in production)
+    }
 
     // process a cycle of individual growth
     setCurrentTask("apply LIP");
+    mModules->runPhase(YearLoopInterface::BeforeApplyPattern);
     applyPattern(); // create Light Influence Patterns
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::ApplyPattern);
+    mModules->runPhase(YearLoopInterface::AfterApplyPattern);
     setCurrentTask("read LIP");
+    mModules->runPhase(YearLoopInterface::BeforeReadPattern);
     readPattern(); // readout light state of individual trees
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::ReadPattern);
+    mModules->runPhase(YearLoopInterface::AfterReadPattern);
 
     setCurrentTask("tree growth");
+    mModules->runPhase(YearLoopInterface::BeforeGrow);
     grow(); // let the trees grow (growth on stand-level, tree-level, mortality)
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::Grow);
+    mModules->runPhase(YearLoopInterface::AfterGrow);
 
+    {
+    TRACE_SCOPE("grassCover");
     mGrassCover->execute(); // evaluate the grass / herb cover (and its effect on regeneration)
+    }
 
     // regeneration
     if (settings().regenerationEnabled) {
+        TRACE_SCOPE("regeneration");
         // seed dispersal
         setCurrentTask("Seed dispersal");
         DebugTimer tseed("Seed dispersal, establishment, sapling growth");
+        {
+        TraceScope trace_seed("seedDispersal");
         foreach(SpeciesSet *set, mSpeciesSets)
             set->regeneration(); // parallel execution for each species set
+        }
 
         GlobalSettings::instance()->systemStatistics()->tSeedDistribution+=tseed.elapsed();
 
@@ -893,11 +1019,15 @@ void Model::runYear()
 
 
         { DebugTimer t("establishment");
+        TraceScope trace_est("establishment");
         setCurrentTask("Establishment");
+        // climate part of the TACA model: once per climate and species
+        Establishment::calculateClimateCache(mClimates, mSpeciesSets);
         executePerResourceUnit( nc_establishment, false /* true: force single threaded operation */);
         GlobalSettings::instance()->systemStatistics()->tEstablishment+=t.elapsed();
         }
         { DebugTimer t("sapling growth");
+        TraceScope trace_sap("saplingGrowth");
         setCurrentTask("sapling growth");
 
         foreach(SpeciesSet *set, mSpeciesSets) {
@@ -916,36 +1046,58 @@ void Model::runYear()
         threadRunner.checkErrors();
 
     }
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::Regeneration);
+    mModules->runPhase(YearLoopInterface::AfterRegeneration);
 
     // external modules/disturbances
     setCurrentTask("BITE");
     if (mBiteEngine) {
+        TRACE_SCOPE("BITE");
         mBiteEngine->setYear(GlobalSettings::instance()->currentYear());
         mBiteEngine->run();
     }
 
     setCurrentTask("Disturbance modules");
+    {
+    TRACE_SCOPE("modules");
     mModules->run();
     // cleanup of tree lists if external modules removed trees.
     cleanTreeLists(false); // do not recalculate statistics - this is done in ru->yearEnd()
+    }
 
 
     // calculate soil / snag dynamics
     if (settings().carbonCycleEnabled) {
+        TRACE_SCOPE("carbonCycle");
         DebugTimer ccycle("carbon cylce");
         setCurrentTask("carbon cycle");
-        executePerResourceUnit( nc_carbonCycle, false /* true: force single threaded operation */);
+        if (mCarbonCycleBatch)
+            mCarbonCycleBatch->calculateYear(mRU);
+        else
+            executePerResourceUnit( nc_carbonCycle, false /* true: force single threaded operation */);
         GlobalSettings::instance()->systemStatistics()->tCarbonCycle+=ccycle.elapsed();
 
     }
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::CarbonCycle);
+    mModules->runPhase(YearLoopInterface::AfterCarbonCycle);
 
 
     DebugTimer toutput("outputs");
     // calculate statistics
-    foreach(ResourceUnit *ru, mRU)
-        ru->yearEnd();
+    {
+    TRACE_SCOPE("yearEnd");
+    executePerResourceUnit(nc_yearEnd, false /* true: force single threaded operation */);
+    threadRunner.checkErrors();
+    // register SVD states in the order of resource units (deterministic state Ids)
+    if (mSVDStates)
+        foreach(ResourceUnit *ru, mRU)
+            ru->registerSVDState();
+    }
 
     if (mABEManagement) {
+        TRACE_SCOPE("ABE:yearEnd");
         DebugTimer t("ABE:yearEnd");
         setCurrentTask("ABE yearEnd");
         mABEManagement->yearEnd();
@@ -954,6 +1106,9 @@ void Model::runYear()
 
     threadRunner.checkErrors();
 
+    // pass the removed trees of the year to the removal outputs (in a deterministic order)
+    TreeRemovalEvents::dispatch();
+
     // create outputs
     setCurrentTask("Write outputs");
     OutputManager *om = GlobalSettings::instance()->outputManager();
@@ -979,18 +1134,27 @@ void Model::runYear()
     om->execute("devstage"); // spatial analysis of developement stages
     om->execute("ecoviz"); // tree output for visualization
     om->execute("customagg"); // custom aggregation, much like dynamic stand
+    om->execute("raster"); // spatial variables as binary rasters (written on a background thread)
 
+    GlobalSettings::instance()->systemStatistics()->mergePartials(); // counters from worker threads
     GlobalSettings::instance()->systemStatistics()->tWriteOutput+=toutput.elapsed();
     GlobalSettings::instance()->systemStatistics()->tTotalYear+=t_all.elapsed();
     GlobalSettings::instance()->systemStatistics()->writeOutput();
 
+    // compiled hooks of modules
+    mModules->runPhase(YearLoopInterface::YearEnd);
+    if (StateChecksum::enabled())
+        StateChecksum::record(StateChecksum::YearEnd); // verification mode: state at the end of the year
+
     // global javascript event
     GlobalSettings::instance()->executeJSFunction("onYearEnd");
 
     GlobalSettings::instance()->setCurrentYear(GlobalSettings::instance()->currentYear()+1);
 
     // try to clean up a bit of memory (useful if many large JS objects (e.g., grids) are used)
-    GlobalSettings::instance()->scriptEngine()->collectGarbage();
+    // the interval is configurable: a full garbage collection each year is expensive for large script heaps
+    if (mScriptGCInterval>0 && GlobalSettings::instance()->currentYear() % mScriptGCInterval == 0)
+        GlobalSettings::instance()->scriptEngine()->collectGarbage();
 }
 
 
@@ -1003,6 +1167,7 @@ void Model::afterStop()
 /// multithreaded running function for LIP printing
 static void nc_applyPattern(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("applyPatternRU", unit->index());
 
     QVector<Tree>::iterator tit;
     QVector<Tree>::iterator tend = unit->trees().end();
@@ -1036,6 +1201,7 @@ static void nc_applyPattern(ResourceUnit *unit)
 /// multithreaded running function for LIP value extraction
 static void nc_readPattern(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("readPatternRU", unit->index());
     QVector<Tree>::iterator tit;
     QVector<Tree>::iterator  tend = unit->trees().end();
     try {
@@ -1054,6 +1220,7 @@ static void nc_readPattern(ResourceUnit *unit)
 /// multithreaded running function for growth of individual trees
 static void nc_grow(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("growRU", unit->index());
     QVector<Tree>::iterator tit;
     QVector<Tree>::iterator  tend = unit->trees().end();
     try {
@@ -1073,12 +1240,13 @@ static void nc_grow(ResourceUnit *unit)
         GlobalSettings::instance()->model()->threadExec().throwError(e.message());
     }
 
-    GlobalSettings::instance()->systemStatistics()->treeCount+=unit->trees().count();
+    SystemStatistics::addCounts(unit->trees().count(), 0, 0);
 }
 
 /// multithreaded running function for resource level production
 static void nc_production(ResourceUnit *unit)
 {
+    TRACE_SCOPE_RU("productionRU", unit->index());
     try {
         unit->production();
     } catch (const IException &e) {
@@ -1098,6 +1266,8 @@ void Model::test()
         if (*p > 0.9f)
             count++;
     qDebug() << count << "LIF>0.9 of " << averaged.count();
+    if (settings().torusMode)
+        Tree::validateTorusKernels();
 }
 
 void Model::debugCheckAllTrees()
@@ -1119,6 +1289,7 @@ void Model::debugCheckAllTrees()
 void Model::applyPattern()
 {
 
+    TRACE_SCOPE("applyPattern");
     DebugTimer t("applyPattern()");
     // intialize grids...
     initializeGrid();
@@ -1136,6 +1307,7 @@ void Model::applyPattern()
 
 void Model::readPattern()
 {
+    TRACE_SCOPE("readPattern");
     DebugTimer t("readPattern()");
     threadRunner.run(nc_readPattern);
     GlobalSettings::instance()->systemStatistics()->tReadPattern+=t.elapsed();
@@ -1151,6 +1323,7 @@ void Model::readPattern()
   */
 void Model::grow()
 {
+    TRACE_SCOPE("grow");
 
 
     { DebugTimer t("growRU()");
@@ -1258,7 +1431,14 @@ void Model::calculateStockableArea()
 void Model::initializeGrid()
 {
     // fill the whole grid with a value of "1."
-    mGrid->initialize(1.f);
+    if (mLIFActiveSpans.isEmpty()) {
+        mGrid->initialize(1.f);
+    } else {
+        // sparse grid: the cells far outside of the project area are not touched
+        float *data = mGrid->begin();
+        for (int i=0;i<mLIFActiveSpans.size();i+=2)
+            std::fill(data + mLIFActiveSpans[i], data + mLIFActiveSpans[i+1], 1.f);
+    }
 
     // apply special values for grid cells border regions where out-of-area cells
     // radiate into the main LIF grid.
@@ -1295,6 +1475,91 @@ void Model::initializeGrid()
 
 }
 
+/** The sparse LIF grid (system.settings.gridMemory.sparse, requires memory maps, see GridAllocator).
+  A cell of the LIF grid is "active" if a valid height grid cell (i.e. a cell of the project area) is within 'cSparseDistance'
+  height cells; trees can neither write to nor read from cells outside this distance (the largest stamps have a radius of 64m).
+  Inactive cells are not initialized by initializeGrid() and the memory pages that contain only inactive cells are released;
+  the value of those cells is 0 (instead of 1). */
+void Model::setupSparseGrid()
+{
+    mLIFActiveSpans.clear();
+    if (!GridAllocator::sparse() || !GridAllocator::isMapped(mGrid->begin()))
+        return;
+    const int cSparseDistance = 8; // height grid cells (80m)
+    const int nx = mHeightGrid->sizeX();
+    const int ny = mHeightGrid->sizeY();
+    const int d = cSparseDistance;
+    // (1) horizontal pass: valid cell within +-d in the same row, kept for the last 2*d+1 rows (ring buffer)
+    // (2) vertical pass: number of rows (within +-d) with a horizontally "near" cell per column
+    QVector<char> near_rows((2*d+1) * nx, 0);
+    QVector<int> col_count(nx, 0);
+    QVector<int> prefix(nx+1);
+    QVector<char> active_row(nx);
+    int n_active = 0;
+    for (int y=0; y<ny+d; ++y) {
+        // add row y (if within the grid) to the window
+        if (y<ny) {
+            char *row = near_rows.data() + (y % (2*d+1)) * nx;
+            prefix[0] = 0;
+            for (int x=0;x<nx;++x)
+                prefix[x+1] = prefix[x] + (mHeightGrid->constValueAtIndex(x, y).isValid() ? 1 : 0);
+            for (int x=0;x<nx;++x) {
+                row[x] = prefix[std::min(x+d+1, nx)] - prefix[std::max(x-d, 0)] > 0 ? 1 : 0;
+                col_count[x] += row[x];
+            }
+        }
+        // the window is now rows y-2d .. y: the center row is yc = y-d
+        const int yc = y - d;
+        if (yc>=0) {
+            for (int x=0;x<nx;++x)
+                active_row[x] = col_count[x] > 0 ? 1 : 0;
+            // spans of active height cells -> spans of the (cPxPerHeight) LIF rows
+            for (int x=0;x<nx;) {
+                if (!active_row[x]) { ++x; continue; }
+                int x_end = x;
+                while (x_end<nx && active_row[x_end])
+                    ++x_end;
+                for (int ly=yc*cPxPerHeight; ly<(yc+1)*cPxPerHeight; ++ly) {
+                    mLIFActiveSpans.push_back(mGrid->index(x*cPxPerHeight, ly));
+                    mLIFActiveSpans.push_back(mGrid->index(x_end*cPxPerHeight, ly));
+                }
+                n_active += (x_end - x);
+                x = x_end;
+            }
+            // remove the row yc-d from the window
+            if (yc-d >= 0) {
+                const char *old_row = near_rows.data() + ((yc-d) % (2*d+1)) * nx;
+                for (int x=0;x<nx;++x)
+                    col_count[x] -= old_row[x];
+            }
+        }
+    }
+    // spans are created row by row (per height row), sort them by the linear index
+    QVector<QPair<int,int> > spans;
+    for (int i=0;i<mLIFActiveSpans.size();i+=2)
+        spans.push_back(QPair<int,int>(mLIFActiveSpans[i], mLIFActiveSpans[i+1]));
+    std::sort(spans.begin(), spans.end());
+    mLIFActiveSpans.clear();
+    for (int i=0;i<spans.size();++i) {
+        if (!mLIFActiveSpans.isEmpty() && mLIFActiveSpans.last()==spans[i].first)
+            mLIFActiveSpans.last() = spans[i].second; // merge adjacent spans
+        else
+            mLIFActiveSpans << spans[i].first << spans[i].second;
+    }
+
+    // release the memory of the gaps between the active spans
+    size_t released = 0;
+    int gap_start = 0;
+    for (int i=0;i<=mLIFActiveSpans.size();i+=2) {
+        int gap_end = i<mLIFActiveSpans.size() ? mLIFActiveSpans[i] : mGrid->count();
+        if (gap_end > gap_start)
+            released += GridAllocator::discard(mGrid->begin(), size_t(gap_start)*sizeof(float), size_t(gap_end-gap_start)*sizeof(float));
+        if (i<mLIFActiveSpans.size())
+            gap_start = mLIFActiveSpans[i+1];
+    }
+    qDebug() << "Sparse LIF grid:" << n_active << "of" << nx*ny << "height cells active," << released/(1024*1024) << "MB released.";
+}
+
 
 /// Force the creation of stand statistics.
 /// - stocked area (for resourceunit-areas)
@@ -1302,19 +1567,20 @@ void Model::initializeGrid()
 void Model::createStandStatistics()
 {
     calculateStockedArea();
-    foreach(ResourceUnit *ru, mRU) {
-        ru->addTreeAgingForAllTrees();
-        ru->createStandStatistics();
-    }
+    executePerResourceUnit(nc_createStandStatistics, false /* true: force single threaded operation */);
+    threadRunner.checkErrors();
+    // register the initial SVD states in the order of resource units
+    if (mSVDStates)
+        foreach(ResourceUnit *ru, mRU)
+            ru->registerSVDState();
 }
 
 void Model::cleanTreeLists(bool recalculate_stats)
 {
-    foreach(ResourceUnit *ru, GlobalSettings::instance()->model()->ruList()) {
-        if (ru->hasDiedTrees()) {
-            ru->cleanTreeList();
-            ru->recreateStandStatistics(recalculate_stats);
-        }
-    }
+    // each resource unit compacts only its own tree list
+    if (recalculate_stats)
+        executePerResourceUnit(nc_cleanTreeListRecalculate, false /* true: force single threaded operation */);
+    else
+        executePerResourceUnit(nc_cleanTreeList, false /* true: force single threaded operation */);
 }
 
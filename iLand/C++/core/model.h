@@ -45,6 +45,7 @@ class Modules;
 class DEM;
 class GrassCover;
 class SVDStates;
+class CarbonCycleBatch;
 namespace BITE { class BiteEngine; }
 
 struct HeightGridValue
@@ -160,6 +161,7 @@ private:
     void calculateStockedArea(); ///< calculate area stocked with trees for each RU
     void calculateStockableArea(); ///< calculate the stockable area for each RU (i.e.: with stand grid values <> -1)
     void initializeGrid(); ///< initialize the LIF grid
+    void setupSparseGrid(); ///< find the parts of the LIF grid that are far outside of the project area (sparse grid memory)
 
     void test();
     void debugCheckAllTrees();
@@ -168,6 +170,7 @@ private:
     static ModelSettings mSettings;
     QString mCurrentTask;
     bool mSetup;
+    int mScriptGCInterval; ///< interval (years) of the garbage collection of the javascript engine (0: never)
     /// container holding all ressource units
     QList<ResourceUnit*> mRU;
     /// grid specifying a map of ResourceUnits
@@ -184,6 +187,7 @@ private:
     // global grids...
     FloatGrid *mGrid; ///< the main LIF grid of the model (2x2m resolution)
     HeightGrid *mHeightGrid; ///< grid with 10m resolution that stores maximum-heights, tree counts and some flags
+    QVector<int> mLIFActiveSpans; ///< sparse LIF grid: pairs of (first, last+1) linear index of the active cells of the LIF grid (empty: all cells are active)
     Saplings *mSaplings;
     Management *mManagement; ///< management sub-module (simple mode)
     ABE::ForestManagementEngine *mABEManagement; ///< management sub-module (agent based management engine)
@@ -197,6 +201,7 @@ private:
     /// SVD States
     /// collection of all realized SVD states in the model
     SVDStates *mSVDStates;
+    CarbonCycleBatch *mCarbonCycleBatch; ///< batched calculation of the soil dynamics (if enabled)
 };
 
 class Tree;
@@ -28,11 +28,18 @@
 
 #include "model.h"
 #include "debugtimer.h"
+#include "tracer.h"
+#include "statechecksum.h"
+#include "treeremovalevents.h"
+#include "gridallocator.h"
+#include "benchmark.h"
+#include <QJsonDocument>
 #include "helper.h"
 #include "version.h"
 #include "expression.h"
 #include "expressionwrapper.h"
 #include "../output/outputmanager.h"
+#include "../output/rasterout.h"
 
 #include "species.h"
 #include "speciesset.h"
@@ -57,6 +64,7 @@ ModelController::ModelController()
     mYearsToRun = 0;
     mViewerWindow = 0;
     mDynamicOutputEnabled = false;
+    mDebugOutputStarted = false;
 }
 
 ModelController::~ModelController()
@@ -175,6 +183,7 @@ void ModelController::create()
 
     try {
         mHasError = false;
+        mDebugOutputStarted = false;
         DebugTimer::clearAllTimers();
         mModel = new Model();
 
@@ -187,6 +196,9 @@ void ModelController::create()
             return;
         }
 
+        if (!GlobalSettings::instance()->settings().paramValueString("debug_clear").isEmpty())
+            qWarning() << "The parameter 'debug_clear' is obsolete and ignored: with 'debugOutputAutoSave' the debug outputs are written every year and removed from memory.";
+
         // reset clock...
         GlobalSettings::instance()->setCurrentYear(1); // reset clock
         // initialization of trees, output on startup
@@ -208,6 +220,39 @@ void ModelController::create()
     mIsBusy = false;
 }
 
+/** run the benchmark of the year loop on a synthetic landscape (see Benchmark).
+  'arguments' are key=value pairs separated by spaces (e.g. "template=project.xml resourceUnits=400 years=20").
+  The benchmark creates (and deletes) its own model, i.e. it can only run if no model is loaded.
+  Returns the result as JSON (or an empty string on errors, see lastError()). */
+QString ModelController::runBenchmark(QString arguments)
+{
+    if (!canCreate()) {
+        mHasError = true;
+        mLastError = "runBenchmark: a model is loaded. Destroy the model before running the benchmark.";
+        qDebug() << mLastError;
+        return QString();
+    }
+    QString result;
+    mHasError = false;
+    mIsBusy = true;
+    try {
+        DebugTimer::clearAllTimers();
+        Benchmark bench(Benchmark::parseArguments(arguments.split(' ', Qt::SkipEmptyParts)));
+        result = QString::fromUtf8(QJsonDocument(bench.run()).toJson());
+        qDebug() << "Benchmark result:" << result;
+    } catch(const IException &e) {
+        mLastError = e.message();
+        mHasError = true;
+        qDebug() << mLastError;
+    }
+    GlobalSettings::instance()->setCurrentYear(0);
+    // the benchmark loads a modified copy of the project: restore the settings of the project file
+    if (!mInitFile.isEmpty())
+        setFileName(mInitFile);
+    mIsBusy = false;
+    return result;
+}
+
 void ModelController::destroy()
 {
     if (canDestroy()) {
@@ -302,8 +347,15 @@ bool ModelController::internalRun()
 void ModelController::internalStop()
 {
     if (mRunning) {
+        // removals after the last dispatch of the year loop (e.g. in the final 'onYearEnd')
+        TreeRemovalEvents::dispatch();
         GlobalSettings::instance()->outputManager()->save();
         DebugTimer::printAllTimers();
+        Tracer::finalize(); // write trace file and summary
+        StateChecksum::finalize(); // close the checksum log
+        // memory usage at the end of the run (e.g. for sizing jobs on large landscapes)
+        if (logLevelInfo())
+            GridAllocator::logUsage();
         saveDebugOutputs(true);
         //if (GlobalSettings::instance()->dbout().isOpen())
         //    GlobalSettings::instance()->dbout().close();
@@ -431,11 +483,12 @@ void ModelController::setupDynamicOutput(QString fieldList)
 {
     mDynFieldList.clear();
     if (!fieldList.isEmpty()) {
-        QRegularExpression re("((?:\\[.+\\]|\\w+)\\.\\w+)");
+        QRegularExpression re("((?:\\[[^\\]]+\\]|\\w+)\\.\\w+)"); // "var.agg" or "[expression].agg"
         for (const QRegularExpressionMatch &match : re.globalMatch(fieldList)) {
             mDynFieldList.append(match.captured(1));
         }
 
+        mDynStatistics.setFields(mDynFieldList); // parsed once (with the first year)
         mDynFieldList.prepend("count");
         mDynFieldList.prepend("year"); // fixed fields.
     }
@@ -449,97 +502,30 @@ QString ModelController::dynamicOutput()
     return mDynData.join("\n");
 }
 
-const QStringList aggList = QStringList() << "mean" << "sum" << "min" << "max" << "p25" << "p50" << "p75" << "p5"<< "p10" << "p90" << "p95";
 void ModelController::fetchDynamicOutput()
 {
     if (!mDynamicOutputEnabled || mDynFieldList.isEmpty())
         return;
     DebugTimer t("dynamic output");
-    QStringList var;
-    QString lastVar = "";
-    QVector<double> data;
-    AllTreeIterator at(mModel);
-    TreeWrapper tw;
-    int var_index;
-    StatData stat;
-    double value;
+    // all fields are calculated in a single pass over the trees
+    mDynStatistics.calculate(mModel);
     QStringList line;
-    Expression custom_expr;
-    bool simple_expression;
-    foreach (QString field, mDynFieldList) {
-        if (field=="count" || field=="year")
-            continue;
-// - removed this to get rid of QRegExp - not sure if it is still used?
-//        if (field.count()>0 && field.at(0)=='[') {
-//            //QRegularExpression rex("\\[(.+)\\]\\.(\\w+)");
-//            QRegExp rex("\\[(.+)\\]\\.(\\w+)");
-//            rex.indexIn(field);
-//            var = rex.capturedTexts();
-//            var.pop_front(); // drop first element (contains the full string)
-//            simple_expression = false;
-//        } else {
-        var = field.split(QRegularExpression("\\W+"), Qt::SkipEmptyParts);
-        simple_expression = true;
-        //}
-        if (var.count()!=2)
-                throw IException(QString("Invalid variable name for dynamic output:") + field);
-        if (var.first()!=lastVar) {
-            // load new field
-            data.clear();
-            at.reset(); var_index = 0;
-            if (simple_expression) {
-                var_index = tw.variableIndex(var.first());
-                if (var_index<0)
-                    throw IException(QString("Invalid variable name for dynamic output:") + var.first());
-
-            } else {
-                custom_expr.setExpression(var.first());
-                custom_expr.setModelObject(&tw);
-            }
-            while (Tree *t = at.next()) {
-                tw.setTree(t);
-                if (simple_expression)
-                    value = tw.value(var_index);
-                else
-                    value = custom_expr.execute();
-                data.push_back(value);
-            }
-            stat.setData(data);
-        }
-        // fetch data
-        var_index = aggList.indexOf(var[1]);
-        switch (var_index) {
-            case 0: value = stat.mean(); break;
-            case 1: value = stat.sum(); break;
-            case 2: value = stat.min(); break;
-            case 3: value = stat.max(); break;
-            case 4: value = stat.percentile25(); break;
-            case 5: value = stat.median(); break;
-            case 6: value = stat.percentile75(); break;
-            case 7: value = stat.percentile(5); break;
-            case 8: value = stat.percentile(10); break;
-            case 9: value = stat.percentile(90); break;
-            case 10: value = stat.percentile(95); break;
-            default: throw IException(QString("Invalid aggregate expression for dynamic output: %1\nallowed:%2")
-                                  .arg(var[1]).arg(aggList.join(" ")));
-        }
-        line+=QString::number(value);
-    }
-    line.prepend( QString::number(data.size()) );
-    line.prepend( QString::number(GlobalSettings::instance()->currentYear()) );
+    line += QString::number(GlobalSettings::instance()->currentYear());
+    line += QString::number(mDynStatistics.count());
+    for (int i=0;i<mDynStatistics.fields().size();++i)
+        line += QString::number(mDynStatistics.value(i));
     mDynData.append(line.join(";"));
 }
 
 void ModelController::saveDebugOutputs(bool is_final)
 {
+    // collect the debug data that was created by the worker threads
+    GlobalSettings::instance()->mergeDebugLists();
+
     // save to files if switch is true
     if (!GlobalSettings::instance()->settings().valueBool("system.settings.debugOutputAutoSave"))
         return;
 
-    bool clear_data = GlobalSettings::instance()->settings().paramValueBool("debug_clear");
-    bool do_append=false;
-    if (clear_data && currentYear()>2) // >2: is called after incrementing the year counter
-        do_append = true;
     QString p = GlobalSettings::instance()->path("debug_", "temp");
 
     if (is_final) {
@@ -548,14 +534,15 @@ void ModelController::saveDebugOutputs(bool is_final)
     }
 
 
-    // write outputs
-    saveDebugOutputsCore(p, do_append);
+    // write outputs: the data is streamed to the files, i.e. the first call creates
+    // new files, and data of later years is appended.
+    saveDebugOutputsCore(p, mDebugOutputStarted);
+    mDebugOutputStarted = true;
 
     if (logLevelDebug())
         qDebug() << "saved debug outputs to" << p;
 
-    if (clear_data)
-        GlobalSettings::instance()->clearDebugLists();  // clear debug data
+    GlobalSettings::instance()->clearDebugLists();  // clear debug data (already written)
 
 
 }
@@ -666,6 +653,7 @@ void ModelController::addGrid(const FloatGrid *grid, const QString &name, const
 
 void ModelController::addLayers(const LayeredGridBase *layers, const QString &name)
 {
+    RasterOut::addLayers(layers, name); // layers are available for the raster output
 #ifdef ILAND_GUI
     if (mViewerWindow)
         mViewerWindow->addLayers(layers, name);
@@ -676,6 +664,7 @@ void ModelController::addLayers(const LayeredGridBase *layers, const QString &na
 }
 void ModelController::removeLayers(const LayeredGridBase *layers)
 {
+    RasterOut::removeLayers(layers);
 #ifdef ILAND_GUI
     if (mViewerWindow)
         mViewerWindow->removeLayers(layers);
@@ -23,6 +23,7 @@
 #include <QHash>
 #include "grid.h"
 #include "layeredgrid.h"
+#include "dynamicstatistics.h"
 class Model;
 class MainWindow;
 class MapGrid;
@@ -100,13 +101,14 @@ public slots:
     void cancel(); ///< cancel execution of the model
     void repaint(); ///< force a repaint of the main drawing window
     void saveDebugOutputJs(bool do_clear); ///< save debug outputs, called from Javascript
+    QString runBenchmark(QString arguments); ///< run the year loop benchmark (see Benchmark) and return the result as JSON (only if no model is loaded)
 private slots:
     void runloop();
 private:
     bool internalRun(); ///< runs the main loop
     void internalStop(); ///< save outputs, stop the model execution
     void fetchDynamicOutput(); ///< execute the dynamic output and fetch data
-    void saveDebugOutputs(bool is_final); ///< save debug outputs to file, is_final is true when the model stops
+    void saveDebugOutputs(bool is_final); ///< merge debug outputs of the year and stream to files, is_final is true when the model stops
     void saveDebugOutputsCore(QString p, bool do_append); ///< core function for saving debug outputs
     MainWindow *mViewerWindow;
     Model *mModel;
@@ -121,7 +123,9 @@ private:
     int mYearsToRun;
     QString mInitFile;
     bool mDynamicOutputEnabled;
+    bool mDebugOutputStarted; ///< true if debug output files were already created for the current model
     QStringList mDynFieldList;
+    DynamicStatistics mDynStatistics; ///< calculates the fields of the dynamic output
     QStringList mDynData;
     QString mLastLoadedJSFile;
     QTime mStartTime;
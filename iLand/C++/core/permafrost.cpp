@@ -24,6 +24,7 @@
 #include "resourceunit.h"
 #include "soil.h"
 #include "modelcontroller.h"
+#include "environment.h"
 
 
 // #include <QMessageBox>
@@ -48,7 +49,7 @@ Permafrost::~Permafrost()
     permafrostLayers.clearGrid(); // reset
 }
 
-void Permafrost::setup(WaterCycle *wc)
+void Permafrost::setup(WaterCycle *wc, const SiteParameters &site)
 {
     mWC = wc;
     const XmlHelper &xml=GlobalSettings::instance()->settings();
@@ -100,7 +101,7 @@ void Permafrost::setup(WaterCycle *wc)
         mWC->mPermanentWiltingPoint = mPWP * (1. - fraction_frozen);
     }
 
-    setupThermalConductivity();
+    setupThermalConductivity(site);
 
     setupMossLayer();
 
@@ -347,14 +348,12 @@ void Permafrost::calculateMoss()
      // stats.mossFCanopy = f_dryout;
 }
 
-void Permafrost::setupThermalConductivity()
+void Permafrost::setupThermalConductivity(const SiteParameters &site)
 {
     // Calcluation of thermal conductivity based on the approach
     // of Farouki 1981 (as described in Bonan 2019)
-    const XmlHelper &xml=GlobalSettings::instance()->settings();
-
-    double pct_sand = xml.valueDouble("model.site.pctSand");
-    double pct_clay = xml.valueDouble("model.site.pctClay");
+    double pct_sand = site.pctSand;
+    double pct_clay = site.pctClay;
 
     mSoilIsCoarse = pct_sand >= 50; // fine-texture soil: < 50% sand
 
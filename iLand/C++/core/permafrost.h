@@ -25,6 +25,7 @@
 class WaterCycle; // forward
 struct ClimateDay; // forward
 class ResourceUnit; // forward
+struct SiteParameters; // forward
 class WaterOut; // forward
 
 namespace Water {
@@ -50,7 +51,7 @@ class Permafrost
 public:
     Permafrost();
     ~Permafrost();
-    void setup(WaterCycle *wc);
+    void setup(WaterCycle *wc, const SiteParameters &site);
     void setFromSnapshot(double moss_biomss, double soil_temp, double depth_frozen, double water_frozen);
 
     //const SStats &stats() const { return stats; }
@@ -90,7 +91,7 @@ private:
 
 
     /// setup of thermal properties of the soil on RU
-    void setupThermalConductivity();
+    void setupThermalConductivity(const SiteParameters &site);
 
     /// thermal conductivity of the mineral soil [W / m2 / K]
     double thermalConductivity(bool from_below) const;
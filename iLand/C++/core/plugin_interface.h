@@ -83,6 +83,42 @@ public:
     virtual void treeDeath(const Tree *tree, const int removal_type)=0;
 };
 
+/** YearLoopInterface provides compiled hooks for the phases of the simulation year (see Model::runYear()).
+    A module declares the phases it is interested in with phases() (bit mask, see phaseFlag()); onPhase() is then called
+    once per year and phase in the main thread. In addition, a module can request a call per resource unit
+    (resourceUnitPhases() and onResourceUnit()): these calls run in parallel (ThreadRunner), i.e. the code must only
+    modify data of the given resource unit. Per resource unit calls are executed after onPhase() of the same phase.
+    phases() and resourceUnitPhases() are queried when the module is registered.
+    Modules are called in the order of registration. Static plugins are enabled with 'modules.<name>.enabled';
+    code linked directly into the executable can use Modules::addExtension().
+*/
+class YearLoopInterface
+{
+public:
+    enum Phase { YearBegin=0, ///< start of the year (after DisturbanceInterface::yearBegin())
+                 BeforeApplyPattern, AfterApplyPattern, ///< around the stamping of the LIPs (light influence patterns)
+                 BeforeReadPattern, AfterReadPattern, ///< around the reading of the light state of the trees
+                 BeforeGrow, AfterGrow, ///< around the growth and mortality of the trees
+                 AfterRegeneration, ///< after seed dispersal, establishment and sapling growth (also called if regeneration is disabled)
+                 AfterCarbonCycle, ///< after the soil and snag dynamics (also called if the carbon cycle is disabled)
+                 YearEnd, ///< end of the year (after the outputs, before the 'onYearEnd' javascript event)
+                 PhaseCount };
+    static int phaseFlag(const Phase phase) { return 1 << phase; }
+    static QString phaseName(const Phase phase) {
+        static const char *names[] = { "yearBegin", "beforeApplyPattern", "afterApplyPattern", "beforeReadPattern", "afterReadPattern",
+                                       "beforeGrow", "afterGrow", "afterRegeneration", "afterCarbonCycle", "yearEnd" };
+        return phase>=0 && phase<PhaseCount ? QString(names[phase]) : QString("invalid"); }
+
+    virtual ~YearLoopInterface() {}
+    virtual QString name()=0; ///< a unique name of the module
+    virtual int phases() const=0; ///< phases for onPhase() (a combination of phaseFlag() values)
+    virtual int resourceUnitPhases() const { return 0; } ///< phases for onResourceUnit() (a combination of phaseFlag() values)
+    /// called once in the main thread
+    virtual void onPhase(const Phase phase) { Q_UNUSED(phase); }
+    /// called for each resource unit (in parallel)
+    virtual void onResourceUnit(const Phase phase, ResourceUnit *ru) { Q_UNUSED(phase); Q_UNUSED(ru); }
+};
+
 Q_DECLARE_INTERFACE(DisturbanceInterface, "org.iland-model.DisturbanceInterface/1.0")
 
 Q_DECLARE_INTERFACE(WaterInterface, "org.iland-model.WaterInterface/1.0")
@@ -91,4 +127,6 @@ Q_DECLARE_INTERFACE(SetupResourceUnitInterface, "org.iland-model.SetupResourceUn
 
 Q_DECLARE_INTERFACE(TreeDeathInterface, "org.iland-model.TreeDeathInterface/1.0")
 
+Q_DECLARE_INTERFACE(YearLoopInterface, "org.iland-model.YearLoopInterface/1.0")
+
 #endif // PLUGIN_INTERFACE_H
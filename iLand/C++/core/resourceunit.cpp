@@ -43,6 +43,12 @@
 #include "svdstate.h"
 #include "statdata.h"
 #include "microclimate.h"
+#include "environment.h"
+#include "tracer.h"
+#include "gridallocator.h"
+
+#include <new>
+#include <type_traits>
 
 double ResourceUnitVariables::nitrogenAvailableDelta = 0;
 
@@ -58,8 +64,7 @@ ResourceUnit::~ResourceUnit()
 
     qDeleteAll(mRUSpecies);
 
-    if (mSaplings)
-        delete[] mSaplings;
+    // the sapling cells are owned by the pool (see freeSaplingCellPool())
 
     mSnag = 0;
     mSoil = 0;
@@ -93,7 +98,34 @@ ResourceUnit::ResourceUnit(const int index)
     mSVDState.clear();
 }
 
-void ResourceUnit::setup()
+// the sapling cells of all resource units are allocated in large blocks with the GridAllocator
+// (i.e. they can be memory mapped for large landscapes, see system.settings.gridMemory)
+static const int cSaplingPoolRUs = 256; // resource units per block
+static QVector<SaplingCell*> sapling_pool_blocks;
+static int sapling_pool_used = cSaplingPoolRUs; // number of used slots in the last block
+static_assert(std::is_trivially_destructible<SaplingCell>::value, "SaplingCell: the pool does not call destructors");
+
+SaplingCell *ResourceUnit::allocateSaplingCells()
+{
+    if (sapling_pool_used >= cSaplingPoolRUs) {
+        SaplingCell *block = static_cast<SaplingCell*>(GridAllocator::allocate(sizeof(SaplingCell) * cPxPerHectare * cSaplingPoolRUs));
+        GridAllocator::setName(block, "saplings");
+        sapling_pool_blocks.push_back(block);
+        sapling_pool_used = 0;
+    }
+    return sapling_pool_blocks.last() + cPxPerHectare * sapling_pool_used++;
+}
+
+void ResourceUnit::freeSaplingCellPool()
+{
+    // SaplingCell is trivially destructible: the memory is just released
+    foreach(SaplingCell *block, sapling_pool_blocks)
+        GridAllocator::deallocate(block);
+    sapling_pool_blocks.clear();
+    sapling_pool_used = cSaplingPoolRUs;
+}
+
+void ResourceUnit::setup(const SiteParameters &site)
 {
     if (mSnag)
         delete mSnag;
@@ -102,31 +134,27 @@ void ResourceUnit::setup()
         delete mSoil;
     mSoil=nullptr;
     if (Model::settings().carbonCycleEnabled) {
-        mSoil = new Soil(this);
+        mSoil = new Soil(this, &site);
         mSnag = new Snag;
-        mSnag->setup(this);
-        const XmlHelper &xml=GlobalSettings::instance()->settings();
+        mSnag->setup(this, site);
 
         // setup contents of the soil of the RU; use values for C and N (kg/ha)
-        mSoil->setInitialState(CNPool(xml.valueDouble("model.site.youngLabileC", -1),
-                                      xml.valueDouble("model.site.youngLabileN", -1),
-                                      xml.valueDouble("model.site.youngLabileDecompRate", -1)),
-                               CNPool(xml.valueDouble("model.site.youngRefractoryC", -1),
-                                      xml.valueDouble("model.site.youngRefractoryN", -1),
-                                      xml.valueDouble("model.site.youngRefractoryDecompRate", -1)),
-                               CNPair(xml.valueDouble("model.site.somC", -1), xml.valueDouble("model.site.somN", -1)),
-                               xml.valueDouble("model.site.youngLabileAbovegroundFraction"),
-                               xml.valueDouble("model.site.youngRefractoryAbovegroundFraction"));
+        mSoil->setInitialState(CNPool(site.youngLabileC, site.youngLabileN, site.youngLabileDecompRate),
+                               CNPool(site.youngRefractoryC, site.youngRefractoryN, site.youngRefractoryDecompRate),
+                               CNPair(site.somC, site.somN),
+                               site.youngLabileAbovegroundFraction,
+                               site.youngRefractoryAbovegroundFraction);
     }
 
-    mWater->setup(this);
+    mWater->setup(this, site);
 
-    if (mSaplings)
-        delete mSaplings;
     if (Model::settings().regenerationEnabled) {
-        mSaplings = new SaplingCell[cPxPerHectare];
-        for (int i=0;i<cPxPerHectare;++i)
+        if (!mSaplings)
+            mSaplings = allocateSaplingCells();
+        for (int i=0;i<cPxPerHectare;++i) {
+            new (mSaplings + i) SaplingCell();
             mSaplings[i].ru = this;
+        }
     }
 
     if (Model::settings().microclimateEnabled) {
@@ -134,7 +162,7 @@ void ResourceUnit::setup()
     }
 
     // setup variables
-    mUnitVariables.nitrogenAvailable = GlobalSettings::instance()->settings().valueDouble("model.site.availableNitrogen", 40);
+    mUnitVariables.nitrogenAvailable = site.availableNitrogen;
 
     // if dynamic coupling of soil nitrogen is enabled, a starting value for available N is calculated
     if (mSoil && Model::settings().useDynamicAvailableNitrogen && Model::settings().carbonCycleEnabled) {
@@ -417,7 +445,10 @@ void ResourceUnit::production()
     QList<ResourceUnitSpecies*>::const_iterator iend = mRUSpecies.constEnd();
 
     // soil water model - this determines soil water contents needed for response calculations
+    {
+    TRACE_SCOPE_RU("waterRU", index());
     mWater->run();
+    }
 
     // invoke species specific calculation (3PG)
     for (i=mRUSpecies.constBegin(); i!=iend; ++i) {
@@ -497,13 +528,13 @@ void ResourceUnit::yearEnd()
 
     }
 
-    // SVD States: update state
-    updateSVDState();
+    // SVD States: classify the state (the state is registered in registerSVDState())
+    classifySVDState();
 
 
 }
 
-void ResourceUnit::updateSVDState()
+void ResourceUnit::classifySVDState()
 {
     if (GlobalSettings::instance()->model()->svdStates()){
         if (!mSVDState.localComposition) {
@@ -514,7 +545,20 @@ void ResourceUnit::updateSVDState()
             // create history vector
             mSVDState.disturbanceEvents = new QVector<RUSVDState::SVDDisturbanceEvent>();
         }
-        int stateId=GlobalSettings::instance()->model()->svdStates()->evaluateState(this);
+        mSVDState.currentState = GlobalSettings::instance()->model()->svdStates()->classifyState(this);
+    }
+}
+
+void ResourceUnit::registerSVDState()
+{
+    if (GlobalSettings::instance()->model()->svdStates()){
+        // Ids of new states are assigned here; therefore this is executed in the (fixed) order of resource units
+        SVDStates *svd = GlobalSettings::instance()->model()->svdStates();
+        int stateId;
+        if (svd->isStateValid(mSVDState.stateId) && svd->state(mSVDState.stateId) == mSVDState.currentState)
+            stateId = mSVDState.stateId; // unchanged since last year: no lookup in the hash table required
+        else
+            stateId = svd->registerState(mSVDState.currentState);
         if (mSVDState.stateId==stateId)
             mSVDState.time++;
         else {
@@ -571,7 +615,7 @@ void ResourceUnit::createStandStatistics()
     if (mAverageAging<0. || mAverageAging>1.)
         qDebug() << "Average aging invalid: (RU, LAI):" << index() << mStatistics.leafAreaIndex();
 
-    updateSVDState(); // initial state (if SVD enabled)
+    classifySVDState(); // initial state (if SVD enabled; registered by registerSVDState())
 }
 
 /** recreate statistics. This is necessary after events that changed the structure
@@ -612,9 +656,19 @@ void ResourceUnit::analyzeMicroclimate()
 
 void ResourceUnit::calculateCarbonCycle()
 {
-    if (!snag())
+    if (!calculateSnagDynamics())
         return;
 
+    soil()->calculateYear(); // update the ICBM/2N model
+
+    finalizeCarbonCycle();
+}
+
+bool ResourceUnit::calculateSnagDynamics()
+{
+    if (!snag())
+        return false;
+
     // (1) calculate the snag dynamics
     // because all carbon/nitrogen-flows from trees to the soil are routed through the snag-layer,
     // all soil inputs (litter + deadwood) are collected in the Snag-object.
@@ -624,8 +678,11 @@ void ResourceUnit::calculateCarbonCycle()
 
     soil()->setSoilInput( snag()->labileFlux(), snag()->refractoryFlux(),
                           snag()->labileFluxAbovegroundCarbon(), snag()->refractoryFluxAbovegroundCarbon());
+    return true;
+}
 
-    soil()->calculateYear(); // update the ICBM/2N model
+void ResourceUnit::finalizeCarbonCycle()
+{
     // use available nitrogen?
     if (Model::settings().useDynamicAvailableNitrogen)
         mUnitVariables.nitrogenAvailable = soil()->availableNitrogen();
@@ -23,6 +23,7 @@
 #include "tree.h"
 #include "resourceunitspecies.h"
 #include "standstatistics.h"
+#include "svdstate.h"
 #include <QtCore/QVector>
 #include <QtCore/QRectF>
 // forward declarations
@@ -32,6 +33,7 @@ class WaterCycle;
 class Snag;
 class Soil;
 struct SaplingCell;
+struct SiteParameters;
 class Microclimate;
 class SVDStates; class SVDStateOut;
 
@@ -52,7 +54,7 @@ public:
     ResourceUnit(const int index);
     ~ResourceUnit();
     // setup/maintenance
-    void setup(); ///< setup operations after the creation of the model space.
+    void setup(const SiteParameters &site); ///< setup operations after the creation of the model space.
     void setSpeciesSet(SpeciesSet *set);
     void setClimate(Climate* climate) { mClimate = climate; }
     void setBoundingBox(const QRectF &bb);
@@ -86,6 +88,7 @@ public:
     const ResourceUnitVariables &resouceUnitVariables() const { return mUnitVariables; } ///< access to variables that are specific to resourceUnit (e.g. nitrogenAvailable)
     const StandStatistics &statistics() const {return mStatistics; }
     const Microclimate *microClimate() const { return mMicroclimate; }
+    Microclimate *microClimate() { return mMicroclimate; }
 
     // properties
     int index() const { return mIndex; }
@@ -132,7 +135,7 @@ public:
     void addTreeAgingForAllTrees(); ///< calculate average tree aging for all trees of a RU. Used directly after stand initialization.
     // stocked area calculation
     void countStockedPixel(bool pixelIsStocked) { mPixelCount++; if (pixelIsStocked) mStockedPixelCount++; }
-    void createStandStatistics(); ///< helping function to create an initial state for stand statistics
+    void createStandStatistics(); ///< helping function to create an initial state for stand statistics (call registerSVDState() afterwards)
     void recreateStandStatistics(bool recalculate_stats); ///< re-build stand statistics after some change happened to the resource unit
     void setStockableArea(const double area) { mStockableArea = area; } ///< set stockable area (m2)
     void setCreateDebugOutput(const bool do_dbg) { mCreateDebugOutput = do_dbg; } ///< enable/disable output generation for RU
@@ -144,6 +147,9 @@ public:
     // snag dynamics, soil carbon and nitrogen cycle
     void snagNewYear() { if (snag()) snag()->newYear(); } ///< clean transfer pools
     void calculateCarbonCycle(); ///< calculate snag dynamics at the end of a year
+    // steps of the carbon cycle (calculateCarbonCycle() = calculateSnagDynamics() + soil()->calculateYear() + finalizeCarbonCycle())
+    bool calculateSnagDynamics(); ///< snag dynamics and input to the soil; returns false if the carbon cycle is not simulated for the RU
+    void finalizeCarbonCycle(); ///< use the available nitrogen of the soil and create debug outputs (after the soil update)
     // model flow
     void newYear(); ///< reset values for a new simulation year
     // LIP/LIF-cylcle -> Model
@@ -151,10 +157,15 @@ public:
     void beforeGrow(); ///< called before growth of individuals
     // the growth of individuals -> Model
     void afterGrow(); ///< called after the growth of individuals
-    void yearEnd(); ///< called at the end of a year (after regeneration??)
+    void yearEnd(); ///< called at the end of a year (after regeneration??); can run in parallel, call registerSVDState() afterwards
+    void registerSVDState(); ///< (if enabled) update the state of the RU with the state classified in yearEnd() (serial, in the order of RUs)
+
+    /// free the memory of the sapling cells of all resource units (after the resource units are deleted)
+    static void freeSaplingCellPool();
 
 private:
-    void updateSVDState(); ///< (if enabled) update the state of the RU
+    static SaplingCell *allocateSaplingCells(); ///< get the memory for the sapling cells of a resource unit (from a pool)
+    void classifySVDState(); ///< (if enabled) calculate the current state of the RU (thread safe)
     int mIndex; ///< internal index
     int mID; ///< ID provided by external stand grid
     bool mHasDeadTrees; ///< flag that indicates if currently dead trees are in the tree list
@@ -194,6 +205,7 @@ private:
             double info;
         };
         QVector<SVDDisturbanceEvent> *disturbanceEvents;
+        SVDState currentState; ///< the state classified in yearEnd() (not yet registered)
 
         void clear() { stateId=previousStateId=time=previousTime=0; }
     } mSVDState;
@@ -0,0 +1,88 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "responsetable.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool ResponseTable::setup(const Function &func, const double low, const double high, const double tolerance, const int max_steps)
+{
+    if (!(high > low))
+        throw IException(QString("ResponseTable: invalid range [%1, %2].").arg(low).arg(high));
+    mFunc = func;
+    mLow = low;
+    mHigh = high;
+    int steps = 16;
+    while (true) {
+        const double step = (high - low) / steps;
+        mValues.resize(steps + 1);
+        for (int i=0;i<=steps;++i)
+            mValues[i] = func(low + i*step);
+        mInvStep = 1. / step;
+        mMaxError = 0.;
+        for (int i=0;i<steps;++i) {
+            for (int k=1;k<4;++k) {
+                const double x = low + (i + 0.25*k)*step;
+                mMaxError = std::max(mMaxError, fabs(value(x) - func(x)));
+            }
+        }
+        if (mMaxError <= tolerance || steps >= max_steps)
+            break;
+        steps *= 2;
+    }
+    return mMaxError <= tolerance;
+}
+
+bool ResponseTable2D::setup(const Function &func, const double low_x, const double high_x, const double low_y, const double high_y,
+                            const double tolerance, const int max_steps)
+{
+    if (!(high_x > low_x) || !(high_y > low_y))
+        throw IException(QString("ResponseTable2D: invalid range [%1, %2] x [%3, %4].").arg(low_x).arg(high_x).arg(low_y).arg(high_y));
+    mFunc = func;
+    mLowX = low_x; mHighX = high_x;
+    mLowY = low_y; mHighY = high_y;
+    int steps = 8;
+    while (true) {
+        mStepsX = mStepsY = steps;
+        const double step_x = (high_x - low_x) / steps;
+        const double step_y = (high_y - low_y) / steps;
+        mValues.resize((steps+1)*(steps+1));
+        for (int ix=0;ix<=steps;++ix)
+            for (int iy=0;iy<=steps;++iy)
+                mValues[ix*(steps+1) + iy] = func(low_x + ix*step_x, low_y + iy*step_y);
+        mInvStepX = 1. / step_x;
+        mInvStepY = 1. / step_y;
+        mMaxError = 0.;
+        for (int ix=0;ix<steps;++ix) {
+            for (int iy=0;iy<steps;++iy) {
+                const double x = low_x + ix*step_x, y = low_y + iy*step_y;
+                const double px[3] = { x + 0.5*step_x, x + 0.5*step_x, x };
+                const double py[3] = { y + 0.5*step_y, y, y + 0.5*step_y };
+                for (int k=0;k<3;++k)
+                    mMaxError = std::max(mMaxError, fabs(value(px[k], py[k]) - func(px[k], py[k])));
+            }
+        }
+        if (mMaxError <= tolerance || steps >= max_steps)
+            break;
+        steps *= 2;
+    }
+    return mMaxError <= tolerance;
+}
@@ -0,0 +1,107 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef RESPONSETABLE_H
+#define RESPONSETABLE_H
+#include <QtCore/QVector>
+#include <functional>
+
+/** ResponseTable approximates a smooth function of one variable by linear interpolation in a dense table.
+  @ingroup core
+  The table covers the range [low, high] with equidistant steps. During setup() the number of steps is doubled until
+  the maximum absolute error (tested at 3 points within each interval) is below the given tolerance (or the maximum
+  number of steps is reached). Values outside of the range are calculated with the original function.
+  Used by SpeciesSet for the light response, the LRI correction and the nitrogen response.
+  */
+class ResponseTable
+{
+public:
+    typedef std::function<double(double)> Function;
+    ResponseTable(): mLow(0.), mHigh(0.), mInvStep(0.), mMaxError(0.) {}
+    /// build the table for 'func' in the range [low, high]. Returns true if the 'tolerance' (max. absolute error) is met.
+    bool setup(const Function &func, const double low, const double high, const double tolerance, const int max_steps=65536);
+    void clear() { mValues.clear(); mFunc = Function(); }
+    bool isValid() const { return mValues.size() > 1; }
+
+    /// approximated value for 'x'
+    double value(const double x) const {
+        if (x<mLow || x>mHigh)
+            return mFunc(x);
+        double t = (x - mLow) * mInvStep;
+        int i = static_cast<int>(t);
+        if (i > mValues.size()-2) i = mValues.size()-2;
+        const double *v = mValues.constData() + i;
+        return v[0] + (t - i) * (v[1] - v[0]);
+    }
+
+    int steps() const { return mValues.size()-1; } ///< number of intervals of the table
+    double maxError() const { return mMaxError; } ///< maximum absolute error found during setup
+    double low() const { return mLow; }
+    double high() const { return mHigh; }
+private:
+    Function mFunc; ///< the original function
+    QVector<double> mValues; ///< function values at low + i*step
+    double mLow, mHigh; ///< range of the table
+    double mInvStep; ///< 1/step width
+    double mMaxError; ///< max. absolute error (setup)
+};
+
+/** ResponseTable2D is the ResponseTable for functions of two variables (bilinear interpolation on a regular grid).
+  @ingroup core
+  Steps in both directions are doubled until the tolerance is met (tested at the cell centers and edge midpoints).
+  */
+class ResponseTable2D
+{
+public:
+    typedef std::function<double(double, double)> Function;
+    ResponseTable2D(): mLowX(0.), mHighX(0.), mLowY(0.), mHighY(0.), mInvStepX(0.), mInvStepY(0.), mStepsX(0), mStepsY(0), mMaxError(0.) {}
+    /// build the table for 'func' in the range [low_x, high_x] x [low_y, high_y]. Returns true if the 'tolerance' is met.
+    bool setup(const Function &func, const double low_x, const double high_x, const double low_y, const double high_y,
+               const double tolerance, const int max_steps=512);
+    void clear() { mValues.clear(); mFunc = Function(); }
+    bool isValid() const { return !mValues.isEmpty(); }
+
+    /// approximated value for (x,y)
+    double value(const double x, const double y) const {
+        if (x<mLowX || x>mHighX || y<mLowY || y>mHighY)
+            return mFunc(x, y);
+        double tx = (x - mLowX) * mInvStepX;
+        double ty = (y - mLowY) * mInvStepY;
+        int ix = static_cast<int>(tx), iy = static_cast<int>(ty);
+        if (ix > mStepsX-1) ix = mStepsX-1;
+        if (iy > mStepsY-1) iy = mStepsY-1;
+        const double fx = tx - ix, fy = ty - iy;
+        const double *v = mValues.constData() + ix*(mStepsY+1) + iy;
+        const double *v1 = v + (mStepsY+1);
+        return (v[0] + fy*(v[1]-v[0])) * (1.-fx) + (v1[0] + fy*(v1[1]-v1[0])) * fx;
+    }
+
+    int stepsX() const { return mStepsX; }
+    int stepsY() const { return mStepsY; }
+    double maxError() const { return mMaxError; }
+private:
+    Function mFunc;
+    QVector<double> mValues; ///< (stepsX+1) x (stepsY+1) values, y varies fastest
+    double mLowX, mHighX, mLowY, mHighY;
+    double mInvStepX, mInvStepY;
+    int mStepsX, mStepsY;
+    double mMaxError;
+};
+
+#endif // RESPONSETABLE_H
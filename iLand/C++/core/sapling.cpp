@@ -445,8 +445,7 @@ void Sapling::calculateGrowth()
         cleanupStorage();
 
 //    mRUS->statistics().add(this);
-    GlobalSettings::instance()->systemStatistics()->saplingCount+=mLiving;
-    GlobalSettings::instance()->systemStatistics()->newSaplings+=mAdded;
+    SystemStatistics::addCounts(0, mLiving, mAdded);
     mAdded = 0; // reset
 
     //qDebug() << ru->index() << species->id()<< ": (living/avg.height):" <<  mLiving << mAvgHeight;
@@ -28,6 +28,7 @@
 #include "seeddispersal.h"
 #include "mapgrid.h"
 #include "grasscover.h"
+#include "microclimate.h"
 
 double Saplings::mRecruitmentVariation = 0.1; // +/- 10%
 double Saplings::mBrowsingPressure = 0.;
@@ -588,6 +589,8 @@ bool Saplings::growSapling(const ResourceUnit *ru, SaplingCell &scell, SaplingTr
             bigtree.setup();
             const Tree *t = &bigtree;
             const_cast<ResourceUnitSpecies*>(rus)->statistics().add(t, nullptr); // count the newly created trees already in the stats
+            if (ru->microClimate())
+                const_cast<ResourceUnit*>(ru)->microClimate()->addTree(t);
             // account for the carbon that is *added* by the new trees
             total_carbon_added += (bigtree.biomassStem()+bigtree.biomassBranch()+bigtree.biomassFoliage()+bigtree.biomassCoarseRoot()+bigtree.biomassFineRoot())*biomassCFraction;
         }
@@ -810,8 +813,7 @@ void SaplingStat::calculate(const Species *species, ResourceUnit *ru)
         mCarbonGain.clear();
 
 
-    GlobalSettings::instance()->systemStatistics()->saplingCount+=mLiving;
-    GlobalSettings::instance()->systemStatistics()->newSaplings+=mAdded;
+    SystemStatistics::addCounts(0, mLiving, mAdded);
 
 }
 
@@ -25,6 +25,8 @@
 #include "helper.h"
 #include "species.h"
 #include "tree.h"
+#include "threadrunner.h"
+#include <QAtomicInt>
 #ifdef ILAND_GUI
 #include <QtGui/QImage>
 #endif
@@ -70,6 +72,8 @@ void SeedDispersal::setup()
 
     mSourceMap.setup(mSeedMap);
     mSourceMap.initialize(0.);
+    GridAllocator::setName(mSeedMap.begin(), "seedMap");
+    GridAllocator::setName(mSourceMap.begin(), "seedSourceMap");
 
     mExternalSeedMap.clear();
     mIndexFactor = int(seedmap_size) / cPxSize; // ratio seed grid / lip-grid:
@@ -92,11 +96,23 @@ void SeedDispersal::setup()
     mKernelThresholdLDD = xml.valueDouble(".longDistanceDispersal.thresholdLDD", 0.0001);
     mLDDSeedlings = static_cast<float>(xml.valueDouble(".longDistanceDispersal.LDDSeedlings", 0.0001));
     mLDDRings = xml.valueInt(".longDistanceDispersal.rings", 4);
+    // 'reference' (default): random distance and direction for each seed, 'alias': precomputed target distributions
+    QString sampler = xml.value(".longDistanceDispersal.sampler", "reference");
+    if (sampler!="reference" && sampler!="alias")
+        throw IException(QString("SeedDispersal:setup(): invalid value '%1' for 'longDistanceDispersal.sampler' (allowed: reference, alias).").arg(sampler));
+    mLDDAliasSampling = sampler=="alias";
+    // the seed of the random streams is drawn during the (serial) setup, i.e. it depends on the random seed of the model.
+    // The reference sampler does not draw the seed (the sequence of random numbers is the same as in earlier versions).
+    mLDDSeed = 0;
+    if (mLDDAliasSampling)
+        mLDDSeed = (static_cast<quint64>(irandom(0, 0x7fffffff)) << 32) ^ static_cast<quint64>(irandom(0, 0x7fffffff));
 
     mLDDSeedlings = qMax(mLDDSeedlings, static_cast<float>(mKernelThresholdArea));
 
     // long distance dispersal
     float ldd_area = static_cast<float>(setupLDD());
+    if (mLDDAliasSampling && xml.valueBool(".longDistanceDispersal.validateSampler", false))
+        validateLDDSampler();
 
     createKernel(mKernelSeedYear,  1.f - ldd_area);
 
@@ -444,6 +460,15 @@ double SeedDispersal::setupLDD()
     if (logLevelInfo())
         qDebug() << "Setup LDD for" << species()->name() << ", using probability: "<< mLDDSeedlings<< ": Distances:" << mLDDDistance << ", seed pixels:" << mLDDDensity << "covered prob:" << ldd_sum;
 
+    mLDDSampler.clear();
+    if (mLDDAliasSampling) {
+        // the sampler works with distances in cells of the seed map
+        QVector<double> distances;
+        foreach(double d, mLDDDistance)
+            distances.push_back(d / mSeedMap.cellsize());
+        mLDDSampler.setup(distances, mLDDDensity);
+    }
+
     return ldd_sum;
 }
 
@@ -624,7 +649,7 @@ void SeedDispersal::clearSaplingMap()
         mSaplingSourceMap.initialize(0.f);
 }
 
-static int _debug_ldd=0;
+static QAtomicInt _debug_ldd(0); // incremented from the parallel per-species runs
 void SeedDispersal::execute()
 {
 #ifdef ILAND_GUI
@@ -696,7 +721,7 @@ void SeedDispersal::execute()
         mDumpNextYearFileName = QString();
     }
     if (logLevelDebug())
-        qDebug() << "LDD-count:" << _debug_ldd;
+        qDebug() << "LDD-count:" << _debug_ldd.load();
 
 #endif
 }
@@ -755,7 +780,7 @@ void SeedDispersal::distributeSeeds(Grid<float> *seed_map)
                     }
                 }
                 // long distance dispersal
-                if (!serotiny && !mLDDDensity.isEmpty()) {
+                if (!serotiny && !mLDDDensity.isEmpty() && !mLDDAliasSampling) {
                     QPoint pt=sourcemap.indexOf(src);
 
                     for (int r=0;r<mLDDDensity.size(); ++r) {
@@ -806,7 +831,7 @@ void SeedDispersal::distributeSeeds(Grid<float> *seed_map)
                     }
                 }
                 // long distance dispersal
-                if (!serotiny && !mLDDDensity.isEmpty()) {
+                if (!serotiny && !mLDDDensity.isEmpty() && !mLDDAliasSampling) {
 
                     for (int r=0;r<mLDDDensity.size(); ++r) {
                         float ldd_val = mLDDSeedlings / fec; // pixels will have this probability [note: fecundity will be multiplied below]
@@ -836,7 +861,9 @@ void SeedDispersal::distributeSeeds(Grid<float> *seed_map)
         }
     } // torus
 
-
+    // long distance dispersal with the LDDSampler
+    if (!serotiny && mLDDAliasSampling && !mLDDSampler.isEmpty())
+        distributeLDD(sourcemap, mLDDSeedlings / fec);
 
     // now the seed sources (0..1) are spatially distributed by the kernel (and LDD) without altering the magnitude;
     // now we include the fecundity (=seedling potential per m2 crown area), and convert to the establishment probability p_seed.
@@ -849,3 +876,150 @@ void SeedDispersal::distributeSeeds(Grid<float> *seed_map)
         }
     }
 }
+
+// a chunk of rows of the source map for the LDDSampler
+struct LDDChunk {
+    const SeedDispersal *sd;
+    const Grid<float> *source;
+    quint64 stream;
+    int begin; ///< first (linear) index of the source map
+    int end;
+    QVector<int> targets; ///< (linear) index of the target cells on the seed map
+};
+
+void SeedDispersal::lddChunk(LDDChunk &chunk)
+{
+    const SeedDispersal &sd = *chunk.sd;
+    const Grid<float> &source = *chunk.source;
+    const LDDSampler &sampler = sd.mLDDSampler;
+    const Grid<float> &seed_map = sd.mSeedMap;
+    const bool torus = GlobalSettings::instance()->model()->settings().torusMode;
+    const int seedmap_offset = source.indexAt(QPointF(0., 0.)).x(); // torus: the seed maps have x extra rows/columns
+    const int seedpx_per_ru = static_cast<int>((cRUSize/source.cellsize()));
+    chunk.targets.clear();
+    for (int idx=chunk.begin; idx<chunk.end; ++idx) {
+        if (!(source.constValueAtIndex(idx) > 0.f))
+            continue;
+        const QPoint pt = source.indexOf(idx);
+        QPoint offset_ru, offset_in_ru;
+        if (torus) {
+            // same as in distributeSeeds()
+            offset_ru = QPoint(((pt.x()-seedmap_offset) / seedpx_per_ru) * seedpx_per_ru + seedmap_offset,
+                               ((pt.y()-seedmap_offset) / seedpx_per_ru) * seedpx_per_ru + seedmap_offset);
+            offset_in_ru = QPoint((pt.x()-seedmap_offset) % seedpx_per_ru, (pt.y()-seedmap_offset) % seedpx_per_ru);
+        }
+        for (int r=0; r<sampler.rings(); ++r) {
+            const int n = sampler.count(chunk.stream, static_cast<quint64>(idx), r);
+            for (int i=0;i<n;++i) {
+                const LDDSampler::Offset o = sampler.sample(chunk.stream, static_cast<quint64>(idx), r, static_cast<quint32>(i));
+                QPoint target = torus ? offset_ru + QPoint(MOD((offset_in_ru.x()+o.dx),seedpx_per_ru), MOD((offset_in_ru.y()+o.dy),seedpx_per_ru))
+                                      : QPoint(pt.x() + o.dx, pt.y() + o.dy);
+                if (seed_map.isIndexValid(target))
+                    chunk.targets.push_back(target.y()*seed_map.sizeX() + target.x());
+            }
+        }
+    }
+}
+
+void SeedDispersal::distributeLDD(const Grid<float> &sourcemap, const float ldd_val)
+{
+    // the chunks depend only on the size of the map; the random numbers depend only on the year and the source cell,
+    // i.e. the result does not depend on the number of threads.
+    const quint64 stream = LDDSampler::stream(mLDDSeed, static_cast<quint64>(GlobalSettings::instance()->currentYear()));
+    const int rows_per_chunk = 16;
+    QVector<LDDChunk> chunks;
+    for (int y=0; y<sourcemap.sizeY(); y+=rows_per_chunk) {
+        LDDChunk c;
+        c.sd = this;
+        c.source = &sourcemap;
+        c.stream = stream;
+        c.begin = y * sourcemap.sizeX();
+        c.end = std::min(y + rows_per_chunk, sourcemap.sizeY()) * sourcemap.sizeX();
+        chunks.push_back(c);
+    }
+    // seed dispersal of species runs already in parallel (SpeciesSet::regeneration()): no nested threads
+    if (ThreadRunner::isParallelRunActive()) {
+        for (int i=0;i<chunks.size();++i)
+            lddChunk(chunks[i]);
+    } else {
+        GlobalSettings::instance()->model()->threadExec().run(lddChunk, chunks);
+    }
+    // apply the targets (in the order of the chunks)
+    float *seed_data = mSeedMap.begin();
+    for (int i=0;i<chunks.size();++i) {
+        foreach(int target, chunks[i].targets)
+            seed_data[target] += ldd_val;
+        _debug_ldd += chunks[i].targets.size();
+    }
+}
+
+double SeedDispersal::validateLDDSampler(int n) const
+{
+    if (mLDDDensity.isEmpty() || n<=0)
+        return 0.;
+    // use the tables of the model, or build them (if the reference sampler is used for the simulation)
+    LDDSampler local_sampler;
+    const LDDSampler *sampler = &mLDDSampler;
+    if (mLDDSampler.isEmpty()) {
+        QVector<double> distances;
+        foreach(double d, mLDDDistance)
+            distances.push_back(d / mSeedMap.cellsize());
+        local_sampler.setup(distances, mLDDDensity);
+        sampler = &local_sampler;
+    }
+    // the validation uses its own (counter based) random streams, the random number generator of the model is not used.
+    const quint64 validation_seed = 0x4c44447465737431ull;
+    const quint64 stream = LDDSampler::stream(validation_seed, 1);
+    const quint64 ref_stream = LDDSampler::stream(validation_seed, 2);
+    // histograms of the target offsets are compared in coarse classes (distance x direction): with
+    // n samples per ring, the total variation distance of two samples of the same distribution is about sqrt(classes/(2*pi*n)).
+    // The check fails if the distance is larger than 5 times this sampling noise.
+    const int n_dist = 10, n_dir = 16;
+    const double noise = sqrt(n_dist*n_dir/(2.*M_PI*n));
+    const double cellsize = mSeedMap.cellsize();
+    double max_tv = 0.;
+    QStringList errors;
+    for (int r=0; r<sampler->rings(); ++r) {
+        const double r_in = mLDDDistance[r] / cellsize, r_out = mLDDDistance[r+1] / cellsize;
+        QVector<double> h_ref(n_dist*n_dir, 0.), h_alias(n_dist*n_dir, 0.);
+        const double r_min = std::max(r_in - 1.5, 0.), r_range = (r_out + 1.5) - r_min; // truncation moves targets inwards
+        for (int i=0;i<n;++i) {
+            // reference: as in distributeSeeds()
+            double radius = (mLDDDistance[r] + LDDSampler::uniform(ref_stream, static_cast<quint64>(i), r, 0)*(mLDDDistance[r+1]-mLDDDistance[r])) / cellsize;
+            double phi = LDDSampler::uniform(ref_stream, static_cast<quint64>(i), r, 1)*2.*M_PI;
+            QPoint ref(static_cast<int>(radius*cos(phi)), static_cast<int>(radius*sin(phi)));
+            LDDSampler::Offset o = sampler->sample(stream, static_cast<quint64>(i), r, 0);
+            const QPoint pts[2] = { ref, QPoint(o.dx, o.dy) };
+            for (int k=0;k<2;++k) {
+                double d = sqrt(double(pts[k].x())*pts[k].x() + double(pts[k].y())*pts[k].y());
+                double a = atan2(double(pts[k].y()), double(pts[k].x())) + M_PI; // 0..2pi
+                int cd = qBound(0, static_cast<int>((d - r_min) / r_range * n_dist), n_dist-1);
+                int ca = qBound(0, static_cast<int>(a / (2.*M_PI) * n_dir), n_dir-1);
+                (k==0 ? h_ref : h_alias)[cd*n_dir + ca] += 1.;
+            }
+        }
+        double tv = 0.;
+        for (int i=0;i<h_ref.size();++i)
+            tv += fabs(h_ref[i] - h_alias[i]) / n;
+        tv *= 0.5;
+        // number of targets per source cell: Bernoulli (density<1) or fixed (rounded density), as in distributeSeeds()
+        double mean_n = 0.;
+        for (int i=0;i<n;++i)
+            mean_n += sampler->count(stream, static_cast<quint64>(i), r);
+        mean_n /= n;
+        const double d = mLDDDensity[r];
+        const double expected_n = d<1. ? d : round(d);
+        const double count_tolerance = d<1. ? 5.*sqrt(d*(1.-d)/n) + 1e-12 : 1e-12;
+        qDebug() << "validateLDDSampler:" << species()->id() << "ring" << r << "distance (cells)" << r_in << "-" << r_out
+                 << "targets/source (expected, sampler):" << expected_n << mean_n << "table size:" << sampler->offsets(r).size()
+                 << "total variation distance:" << tv << "(sampling noise about" << noise << ")";
+        if (tv > 5.*noise)
+            errors.push_back(QString("ring %1: total variation distance %2 > %3").arg(r).arg(tv).arg(5.*noise));
+        if (fabs(mean_n - expected_n) > count_tolerance)
+            errors.push_back(QString("ring %1: targets per source cell %2, expected %3").arg(r).arg(mean_n).arg(expected_n));
+        max_tv = std::max(max_tv, tv);
+    }
+    if (!errors.isEmpty())
+        throw IException(QString("SeedDispersal: validation of the LDD sampler failed for species '%1': %2").arg(species()->id(), errors.join("; ")));
+    return max_tv;
+}
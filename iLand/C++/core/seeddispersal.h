@@ -21,8 +21,10 @@
 #define SEEDDISPERSAL_H
 #include <QHash>
 #include "grid.h"
+#include "lddsampler.h"
 class Species;
 class Tree;
+struct LDDChunk;
 
 class SeedDispersal
 {
@@ -58,6 +60,11 @@ public:
     // debug and helpers
     void loadFromImage(const QString &fileName); ///< debug function...
     void dumpMapNextYear(QString file_name) { mDumpNextYearFileName = file_name; }
+    /// compare the distribution of LDD targets of the alias sampler with the reference implementation;
+    /// 'n' samples per ring. Returns the largest total variation distance (over all rings) of the histograms of targets.
+    /// Throws an IException if the distributions or the number of targets differ by more than the sampling noise.
+    /// The validation does not use the random number generator of the model.
+    double validateLDDSampler(int n=1000000) const;
 private:
     void createKernel(Grid<float> &kernel, const float scale_area); ///< initializes / creates the kernel
     double setupLDD(); ///< initialize long distance seed dispersal
@@ -68,6 +75,9 @@ private:
 
     /// do the actual seed distribution processing
     void distributeSeeds(Grid<float> *seed_map=0);
+    /// long distance dispersal with the LDDSampler (source cells are processed in parallel chunks)
+    void distributeLDD(const Grid<float> &sourcemap, const float ldd_val);
+    static void lddChunk(LDDChunk &chunk); ///< find the LDD target cells for a chunk of source cells
 
 
     double mTM_as1, mTM_as2, mTM_ks; ///< seed dispersal paramaters (treemig)
@@ -88,6 +98,9 @@ private:
     QVector<double> mLDDDensity;  ///< long distance dispersal # of cells that should be affected in each "ring"
     int mLDDRings; ///< # of rings (with equal probability) for LDD
     float mLDDSeedlings; ///< each LDD pixel has this probability
+    bool mLDDAliasSampling; ///< true: use the LDDSampler, false: reference implementation (in distributeSeeds())
+    LDDSampler mLDDSampler; ///< precomputed target distributions of LDD
+    quint64 mLDDSeed; ///< seed of the (counter based) random streams of the LDDSampler
     bool mHasPendingSerotiny; ///< true if active (unprocessed) pixels are on the extra-serotiny map
     bool mSetup;
     Species *mSpecies;
@@ -26,6 +26,7 @@
 #include "model.h"
 #include "species.h"
 #include "microclimate.h"
+#include "environment.h"
 
 /** @class Snag
   @ingroup core
@@ -98,7 +99,7 @@ Snag::Snag()
     CNPair::setCFraction(biomassCFraction);
 }
 
-void Snag::setup( const ResourceUnit *ru)
+void Snag::setup( const ResourceUnit *ru, const SiteParameters &site)
 {
     mRU = ru;
     mClimateFactor = 0.;
@@ -120,20 +121,18 @@ void Snag::setup( const ResourceUnit *ru)
     if (mDBHLower<=0)
         throw IException("Snag::setupThresholds() not called or called with invalid parameters.");
 
-    // Inital values from XML file
-    XmlHelper xml=GlobalSettings::instance()->settings();
-    double kyr = xml.valueDouble("model.site.youngRefractoryDecompRate", -1);
+    // Inital values from the project file (or the environment)
+    double kyr = site.youngRefractoryDecompRate;
     // put carbon of snags to the middle size class
-    xml.setCurrentNode("model.initialization.snags");
-    mSWD[1].C = xml.valueDouble(".swdC");
-    mSWD[1].N = mSWD[1].C / xml.valueDouble(".swdCN", 50.);
+    mSWD[1].C = site.swdC;
+    mSWD[1].N = mSWD[1].C / site.swdCN;
     mSWD[1].setParameter(kyr);
-    mKSW[1] = xml.valueDouble(".swdDecompRate");
-    mNumberOfSnags[1] = xml.valueDouble(".swdCount");
-    mHalfLife[1] = xml.valueDouble(".swdHalfLife");
+    mKSW[1] = site.swdDecompRate;
+    mNumberOfSnags[1] = site.swdCount;
+    mHalfLife[1] = site.swdHalfLife;
     // and for the Branch/coarse root pools: split the init value into five chunks
-    CNPool other(xml.valueDouble(".otherC"), xml.valueDouble(".otherC")/xml.valueDouble(".otherCN", 50.), kyr );
-    mOtherWoodAbovegroundFrac = xml.valueDouble(".otherAbovegroundFraction", 0.5);
+    CNPool other(site.otherC, site.otherC/site.otherCN, kyr );
+    mOtherWoodAbovegroundFrac = site.otherAbovegroundFraction;
     mTotalSnagCarbon = other.C + mSWD[1].C;
 
     other *= 0.2;
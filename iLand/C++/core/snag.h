@@ -24,6 +24,7 @@
 class Tree; // forward
 class Species; // forward
 class ResourceUnit; // forward
+struct SiteParameters; // forward
 
 /** CNPair stores a duple of carbon and nitrogen (kg/ha)
     use addBiomass(biomass, cnratio) to add biomass; use operators (+, +=, *, *=) for simple operations. */
@@ -80,7 +81,7 @@ class Snag
 public:
     Snag();
     static void setupThresholds(const double lower, const double upper); ///< setup class thresholds, needs to be called only once... (static)
-    void setup( const ResourceUnit *ru); ///< initial setup routine.
+    void setup( const ResourceUnit *ru, const SiteParameters &site); ///< initial setup routine.
     void scaleInitialState(); ///< used to scale the input to the actual area of the resource unit
     void newYear(); ///< to be executed at the beginning of a simulation year. This cleans up the transfer pools.
     void calculateYear(); ///< to be called at the end of the year (after tree growth, harvesting). Calculates flow to the soil.
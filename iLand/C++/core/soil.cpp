@@ -22,6 +22,7 @@
 #include "xmlhelper.h" // for load settings
 #include "exception.h"
 #include "resourceunit.h"
+#include "environment.h"
 /** @class Soil provides an implementation of the ICBM/2N soil carbon and nitrogen dynamics model.
   @ingroup core
   The ICBM/2N model was developed by Kaetterer and Andren (2001) and used by others (e.g. Xenakis et al, 2008).
@@ -37,23 +38,19 @@ double Soil::mNitrogenDeposition = 0.;
 // (proportional to its mineralization in the mineral soil horizon) is leached
 // see separate wiki-page (https://iland-model.org/soil+parametrization+and+initialization)
 // and R-script on parameter estimation and initialization
-static struct SoilParams {
-    // ICBM/2N parameters
-    SoilParams(): qb(5.), qh(25.), leaching(0.15), el(0.0577), er(0.073), is_setup(false) {}
-    double qb; ///< C/N ratio of soil microbes
-    double qh; ///< C/N ratio of SOM
-    double leaching; ///< how many percent of the mineralized nitrogen in O is not available for plants but is leached
-    double el; ///< microbal efficiency in the labile pool, auxiliary parameter (see parameterization example)
-    double er; ///< microbal efficiency in the refractory pool, auxiliary parameter (see parameterization example)
-    bool is_setup;
-} global_soilpar;
+static SoilParams global_soilpar;
 SoilParams *Soil::mParams = &global_soilpar; // save a ptr to the single value container as a static class variable
 
-void Soil::fetchParameters()
+void Soil::fetchParameters(const SiteParameters *site)
 {
-    XmlHelper xml_site(GlobalSettings::instance()->settings().node("model.site"));
-    mKo = xml_site.valueDouble("somDecompRate", 0.02);
-    mH =  xml_site.valueDouble("soilHumificationRate", 0.3);
+    if (site) {
+        mKo = site->somDecompRate;
+        mH = site->soilHumificationRate;
+    } else {
+        XmlHelper xml_site(GlobalSettings::instance()->settings().node("model.site"));
+        mKo = xml_site.valueDouble("somDecompRate", 0.02);
+        mH =  xml_site.valueDouble("soilHumificationRate", 0.3);
+    }
 
     if (mParams->is_setup || !GlobalSettings::instance()->model())
         return;
@@ -70,7 +67,7 @@ void Soil::fetchParameters()
 }
 
 
-Soil::Soil(ResourceUnit *ru)
+Soil::Soil(ResourceUnit *ru, const SiteParameters *site)
 {
     mRU = ru;
     mRE = 0.;
@@ -80,7 +77,7 @@ Soil::Soil(ResourceUnit *ru)
     mH = 0.;
     mKo = 0.;
     mYLaboveground_frac = mYRaboveground_frac = 0.;
-    fetchParameters();
+    fetchParameters(site);
 }
 
 // reset of bookkeeping variables
@@ -21,15 +21,26 @@
 #define SOIL_H
 
 #include "snag.h"
-struct SoilParams; // forward
+/// global parameters of the ICBM/2N model (see soil.cpp)
+struct SoilParams {
+    // ICBM/2N parameters
+    SoilParams(): qb(5.), qh(25.), leaching(0.15), el(0.0577), er(0.073), is_setup(false) {}
+    double qb; ///< C/N ratio of soil microbes
+    double qh; ///< C/N ratio of SOM
+    double leaching; ///< how many percent of the mineralized nitrogen in O is not available for plants but is leached
+    double el; ///< microbal efficiency in the labile pool, auxiliary parameter (see parameterization example)
+    double er; ///< microbal efficiency in the refractory pool, auxiliary parameter (see parameterization example)
+    bool is_setup;
+};
 class ResourceUnit; // forward
 class SoilInputOut; // forward
+struct SiteParameters; // forward
 
 class Soil
 {
 public:
     // lifecycle
-    Soil(ResourceUnit *ru=0);
+    Soil(ResourceUnit *ru=0, const SiteParameters *site=nullptr);
     /// set initial pool contents
     void setInitialState(const CNPool &young_labile_kg_ha, const CNPool &young_refractory_kg_ha, const CNPair &SOM_kg_ha, double young_labile_aboveground_frac, double young_refractory_aboveground_frac);
 
@@ -65,7 +76,7 @@ public:
     QList<QVariant> debugList(); ///< return a debug output
 private:
     ResourceUnit *mRU; ///< link to containing resource unit
-    void fetchParameters(); ///< set iland parameters for soil
+    void fetchParameters(const SiteParameters *site); ///< set iland parameters for soil (site specific values from 'site' if provided)
     static SoilParams *mParams; // static container for parameters
     // variables
     double mRE; ///< climate factor 're' (see Snag::calculateClimateFactors())
@@ -93,6 +104,7 @@ private:
     static double mNitrogenDeposition; ///< annual nitrogen deposition (kg N/ha*yr)
     friend class Snapshot;
     friend class SoilInputOut;
+    friend class CarbonCycleBatch;
 };
 
 #endif // SOIL_H
@@ -42,6 +42,8 @@
 #include "watercycle.h"
 #include "debugtimer.h"
 
+#include <algorithm>
+
 SpeciesResponse::SpeciesResponse()
 {
     mSpecies=0;
@@ -142,10 +144,11 @@ void SpeciesResponse::calculate()
         mSoilWaterResponse[i]/=days;
         mTempResponse[i]/=days;
         mVpdResponse[i]/=days;
-        mCO2Response[i] = mSpecies->speciesSet()->co2Response(ambient_co2,
-                                                           mNitrogenResponse,
-                                                           mSoilWaterResponse[i]);
     }
+    // CO2 response for all months (yearly nitrogen response)
+    double nitrogen_resp[12];
+    std::fill(nitrogen_resp, nitrogen_resp+12, mNitrogenResponse);
+    mSpecies->speciesSet()->co2Response(ambient_co2, nitrogen_resp, mSoilWaterResponse, mCO2Response, 12);
 
 }
 
@@ -30,6 +30,8 @@
 #include "modelsettings.h"
 #include "debugtimer.h"
 
+#include <algorithm>
+
 /** @class SpeciesSet
     A SpeciesSet acts as a container for individual Species objects. In iLand, theoretically,
     multiple species sets can be used in parallel.
@@ -38,6 +40,7 @@
 SpeciesSet::SpeciesSet()
 {
     mSetupQuery = 0;
+    mUseResponseTables = false;
 }
 
 SpeciesSet::~SpeciesSet()
@@ -154,11 +157,59 @@ int SpeciesSet::setup()
     // x: LRI, y: relative heigth
     mLRICorrection.linearize2d(0., 1., 0., 1.);
 
+    setupResponseTables(xml);
+
     createRandomSpeciesOrder();
     return mSpecies.count();
 
 }
 
+/** setup of the tabulated responses (light, LRI correction, nitrogen).
+    The tables replace the evaluation of the expressions (and exp()) for each tree and year. The number of steps of each table
+    is increased until the max. absolute error is below 'tolerance' (system.settings.responseTables.tolerance).
+    The tables are used if 'system.settings.responseTables.enabled' is true.
+  */
+void SpeciesSet::setupResponseTables(const XmlHelper &xml)
+{
+    mUseResponseTables = false;
+    mLightResponseIntolerantTable.clear();
+    mLightResponseTolerantTable.clear();
+    mLRICorrectionTable.clear();
+    for (int i=0;i<3;++i)
+        mNitrogenTable[i].clear();
+    if (!xml.valueBool("system.settings.responseTables.enabled", false))
+        return;
+
+    const double tolerance = xml.valueDouble("system.settings.responseTables.tolerance", 0.00001);
+    if (tolerance<=0.)
+        throw IException("system.settings.responseTables.tolerance: the value must be > 0!");
+    QStringList not_met;
+    // light response: LRI 0..1 (the expressions are always calculated without linearization)
+    if (!mLightResponseIntolerantTable.setup([this](double x) { return mLightResponseIntolerant.calculate(x, 0., true); }, 0., 1., tolerance))
+        not_met << "lightResponse (shadeIntolerant)";
+    if (!mLightResponseTolerantTable.setup([this](double x) { return mLightResponseTolerant.calculate(x, 0., true); }, 0., 1., tolerance))
+        not_met << "lightResponse (shadeTolerant)";
+    // LRI correction: LRI 0..1, relative height 0..1
+    if (!mLRICorrectionTable.setup([this](double x, double y) { return mLRICorrection.calculate(x, y, true); }, 0., 1., 0., 1., tolerance))
+        not_met << "LRImodifier";
+    // nitrogen response: the table starts at the threshold of the class (the response is 0 below, and has a kink there)
+    const double na[3] = { mNitrogen_1a, mNitrogen_2a, mNitrogen_3a };
+    const double nb[3] = { mNitrogen_1b, mNitrogen_2b, mNitrogen_3b };
+    for (int i=0;i<3;++i) {
+        const double a = na[i], b = nb[i];
+        if (!mNitrogenTable[i].setup([this, a, b](double x) { return nitrogenResponse(x, a, b); }, b, b + 400., tolerance))
+            not_met << QString("nitrogen response class %1").arg(i+1);
+    }
+    mUseResponseTables = true;
+
+    qDebug() << "Response tables enabled (tolerance" << tolerance << "): light response" << mLightResponseIntolerantTable.steps() << "/" << mLightResponseTolerantTable.steps()
+             << "steps (max. error" << std::max(mLightResponseIntolerantTable.maxError(), mLightResponseTolerantTable.maxError())
+             << "), LRI modifier" << mLRICorrectionTable.stepsX() << "x" << mLRICorrectionTable.stepsY() << "steps (max. error" << mLRICorrectionTable.maxError()
+             << "), nitrogen" << mNitrogenTable[0].steps() << "/" << mNitrogenTable[1].steps() << "/" << mNitrogenTable[2].steps() << "steps";
+    if (!not_met.isEmpty())
+        qWarning() << "Response tables: the tolerance is not met for:" << not_met.join(", ") << "(max. table size reached)";
+}
+
 void SpeciesSet::setupRegeneration()
 {
     SeedDispersal::setupExternalSeeds();
@@ -264,6 +315,17 @@ inline double SpeciesSet::nitrogenResponse(const double &availableNitrogen, cons
 
 
 
+inline double SpeciesSet::nitrogenClassResponse(const double availableNitrogen, const int responseClass) const
+{
+    if (mUseResponseTables)
+        return mNitrogenTable[responseClass-1].value(availableNitrogen);
+    switch (responseClass) {
+    case 1: return nitrogenResponse(availableNitrogen, mNitrogen_1a, mNitrogen_1b);
+    case 2: return nitrogenResponse(availableNitrogen, mNitrogen_2a, mNitrogen_2b);
+    default: return nitrogenResponse(availableNitrogen, mNitrogen_3a, mNitrogen_3b);
+    }
+}
+
 /// calculate nitrogen response for a given amount of available nitrogen and a respone class
 /// for fractional values, the response value is interpolated between the fixedly defined classes (1,2,3)
 double SpeciesSet::nitrogenResponse(const double availableNitrogen, const double &responseClass) const
@@ -271,21 +333,21 @@ double SpeciesSet::nitrogenResponse(const double availableNitrogen, const double
     double value1, value2, value3;
     if (responseClass>2.) {
         if (responseClass==3.)
-            return nitrogenResponse(availableNitrogen, mNitrogen_3a, mNitrogen_3b);
+            return nitrogenClassResponse(availableNitrogen, 3);
         else {
             // interpolate between 2 and 3
-            value2 = nitrogenResponse(availableNitrogen, mNitrogen_2a, mNitrogen_2b);
-            value3 = nitrogenResponse(availableNitrogen, mNitrogen_3a, mNitrogen_3b);
+            value2 = nitrogenClassResponse(availableNitrogen, 2);
+            value3 = nitrogenClassResponse(availableNitrogen, 3);
             return value2 + (responseClass-2)*(value3-value2);
         }
     }
     if (responseClass==2.)
-        return nitrogenResponse(availableNitrogen, mNitrogen_2a, mNitrogen_2b);
+        return nitrogenClassResponse(availableNitrogen, 2);
     if (responseClass==1.)
-        return nitrogenResponse(availableNitrogen, mNitrogen_1a, mNitrogen_1b);
+        return nitrogenClassResponse(availableNitrogen, 1);
     // last ressort: interpolate between 1 and 2
-    value1 = nitrogenResponse(availableNitrogen, mNitrogen_1a, mNitrogen_1b);
-    value2 = nitrogenResponse(availableNitrogen, mNitrogen_2a, mNitrogen_2b);
+    value1 = nitrogenClassResponse(availableNitrogen, 1);
+    value2 = nitrogenClassResponse(availableNitrogen, 2);
     return value1 + (responseClass-1)*(value2-value1);
 }
 
@@ -315,6 +377,23 @@ double SpeciesSet::co2Response(const double ambientCO2, const double nitrogenRes
 
 }
 
+/// CO2 response for 'n' pairs of nitrogen and soil water response (e.g. the months of a year) at the same 'ambientCO2'.
+/// The calculation is the same as in co2Response(), but the loop has no function calls and can be vectorized.
+void SpeciesSet::co2Response(const double ambientCO2, const double *nitrogenResponse, const double *soilWaterResponse, double *result, const int n) const
+{
+    const double deltaC = mCO2base - mCO2comp;
+    const double c2 = 2*mCO2base - mCO2comp;
+    const double dC_amb = ambientCO2 - mCO2comp;
+    for (int i=0;i<n;++i) {
+        const double beta = mCO2beta0 * (2. - soilWaterResponse[i]) * nitrogenResponse[i];
+        const double r = 1. + M_LN2 * beta;
+        const double K2 = (c2 - r*deltaC) / ((r-1.)*deltaC*c2);
+        const double K1 = (1. + K2*deltaC) / deltaC;
+        const double response = mCO2p0 * K1*dC_amb / (1 + K2*dC_amb);
+        result[i] = nitrogenResponse[i]==0. ? 0. : response;
+    }
+}
+
 double SpeciesSet::co2Beta(const double nitrogenResponse, const double soilWaterResponse) const
 {
     double co2_water = 2. - soilWaterResponse;
@@ -328,8 +407,14 @@ double SpeciesSet::co2Beta(const double nitrogenResponse, const double soilWater
     @sa https://iland-model.org/allocation#reserve_and_allocation_to_stem_growth */
 double SpeciesSet::lightResponse(const double lightResourceIndex, const double lightResponseClass) const
 {
-    double low = mLightResponseIntolerant.calculate(lightResourceIndex);
-    double high = mLightResponseTolerant.calculate(lightResourceIndex);
+    double low, high;
+    if (mUseResponseTables) {
+        low = mLightResponseIntolerantTable.value(lightResourceIndex);
+        high = mLightResponseTolerantTable.value(lightResourceIndex);
+    } else {
+        low = mLightResponseIntolerant.calculate(lightResourceIndex);
+        high = mLightResponseTolerant.calculate(lightResourceIndex);
+    }
     double result = low + 0.25*(lightResponseClass-1.)*(high-low);
     return limit(result, 0., 1.);
 
@@ -23,8 +23,10 @@
 
 #include "stampcontainer.h"
 #include "expression.h"
+#include "responsetable.h"
 class Species;
 class SeedDispersal;
+class XmlHelper;
 
 class SpeciesSet
 {
@@ -48,7 +50,10 @@ public:
     double co2Response(const double ambientCO2, const double nitrogenResponse, const double soilWaterResponse) const;
     double co2Beta(const double nitrogenResponse, const double soilWaterResponse) const;
     double lightResponse(const double lightResourceIndex, const double lightResponseClass) const;
-    double LRIcorrection(const double lightResourceIndex, const double relativeHeight) const  { return mLRICorrection.calculate(lightResourceIndex, relativeHeight);}
+    double LRIcorrection(const double lightResourceIndex, const double relativeHeight) const  { return mUseResponseTables ? mLRICorrectionTable.value(lightResourceIndex, relativeHeight) : mLRICorrection.calculate(lightResourceIndex, relativeHeight);}
+    /// CO2 response for arrays of 'n' values (e.g. the months of a year)
+    void co2Response(const double ambientCO2, const double *nitrogenResponse, const double *soilWaterResponse, double *result, const int n) const;
+    bool responseTablesEnabled() const { return mUseResponseTables; } ///< true if responses are calculated with tables (see setupResponseTables())
     // maintenance
     void clear();
     int setup();
@@ -60,6 +65,8 @@ public:
 private:
     QString mName;
     double nitrogenResponse(const double &availableNitrogen, const double &NA, const double &NB) const;
+    double nitrogenClassResponse(const double availableNitrogen, const int responseClass) const; ///< response for class 1..3 (table or exact)
+    void setupResponseTables(const XmlHelper &xml);
     void createRandomSpeciesOrder();
     QList<Species*> mActiveSpecies; ///< list of species that are "active" (flag active in database)
     QMap<QString, Species*> mSpecies;
@@ -78,6 +85,12 @@ private:
     Expression mLightResponseIntolerant; ///< light response function for the the most shade tolerant species
     Expression mLightResponseTolerant; ///< light response function for the most shade intolerant species
     Expression mLRICorrection; ///< function to modfiy LRI during read
+    // tabulated responses
+    bool mUseResponseTables; ///< if true, the responses are calculated with the tables below
+    ResponseTable mLightResponseIntolerantTable; ///< light response (intolerant), LRI 0..1
+    ResponseTable mLightResponseTolerantTable; ///< light response (tolerant), LRI 0..1
+    ResponseTable mNitrogenTable[3]; ///< nitrogen response of the classes 1..3 (available nitrogen)
+    ResponseTable2D mLRICorrectionTable; ///< LRI modifier (x: LRI, y: relative height)
 
 };
 
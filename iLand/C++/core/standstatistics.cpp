@@ -248,6 +248,50 @@ void StandStatistics::add(const SaplingStat *sapling)
 
 }
 
+// partial sums of the counters of a single thread
+struct SystemStatisticsPartial {
+    int treeCount;
+    int saplingCount;
+    int newSaplings;
+};
+static QMutex partials_mutex; // only used when a thread creates its partial sums
+static QList<SystemStatisticsPartial*> stat_partials;
+static thread_local SystemStatisticsPartial *tls_stat_partial = nullptr;
+
+void SystemStatistics::reset()
+{
+    treeCount=0; saplingCount=0; newSaplings=0;
+    tManagement = 0.; tApplyPattern=tReadPattern=tTreeGrowth=0.;
+    tSeedDistribution=tSapling=tEstablishment=tCarbonCycle=tWriteOutput=tTotalYear=0.;
+    QMutexLocker m(&partials_mutex);
+    foreach(SystemStatisticsPartial *p, stat_partials)
+        p->treeCount = p->saplingCount = p->newSaplings = 0;
+}
+
+void SystemStatistics::addCounts(int trees, int saplings, int new_saplings)
+{
+    if (!tls_stat_partial) {
+        QMutexLocker m(&partials_mutex);
+        tls_stat_partial = new SystemStatisticsPartial();
+        tls_stat_partial->treeCount = tls_stat_partial->saplingCount = tls_stat_partial->newSaplings = 0;
+        stat_partials.append(tls_stat_partial);
+    }
+    tls_stat_partial->treeCount += trees;
+    tls_stat_partial->saplingCount += saplings;
+    tls_stat_partial->newSaplings += new_saplings;
+}
+
+void SystemStatistics::mergePartials()
+{
+    QMutexLocker m(&partials_mutex);
+    foreach(SystemStatisticsPartial *p, stat_partials) {
+        treeCount += p->treeCount;
+        saplingCount += p->saplingCount;
+        newSaplings += p->newSaplings;
+        p->treeCount = p->saplingCount = p->newSaplings = 0;
+    }
+}
+
 void SystemStatistics::writeOutput()
 {
     if (GlobalSettings::instance()->isDebugEnabled(GlobalSettings::dPerformance)) {
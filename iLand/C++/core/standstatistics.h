@@ -102,15 +102,19 @@ private:
 
 
 /** holds a couple of system statistics primarily aimed for performance and memory analyis.
+  The counters are updated from worker threads with addCounts(): each thread adds to its own partial sums,
+  which are added to the counters by mergePartials() (at the end of the year).
   */
 class SystemStatistics
 {
 public:
     SystemStatistics() { reset(); }
-    void reset() { treeCount=0; saplingCount=0; newSaplings=0;
-                   tManagement = 0.; tApplyPattern=tReadPattern=tTreeGrowth=0.;
-                   tSeedDistribution=tSapling=tEstablishment=tCarbonCycle=tWriteOutput=tTotalYear=0.; }
+    void reset();
     void writeOutput();
+    /// add to the counters from any thread (lock free)
+    static void addCounts(int trees, int saplings, int new_saplings);
+    /// add the partial sums of all threads to the counters (call only if no worker threads are active)
+    void mergePartials();
     // the system counters
     int treeCount;
     int saplingCount;
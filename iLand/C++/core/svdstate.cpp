@@ -4,6 +4,8 @@
 #include "species.h"
 #include "model.h"
 
+#include <algorithm>
+
 SVDStates *SVDState::svd = nullptr;
 
 SVDStates::SVDStates()
@@ -33,10 +35,13 @@ SVDStates::SVDStates()
         throw IException(QString("Setup of SVD States: invalid value for 'functioning': '%1', allowed values are '3', '5'.").arg(cls) );
 
 
+    mNSpecies = 0;
+    mValidateNeighborhoods = xml.valueBool("model.settings.svdStates.validateNeighborhood", false);
+
     qDebug() << "setup of SVDStates completed.";
 }
 
-int SVDStates::evaluateState(ResourceUnit *ru)
+SVDState SVDStates::classifyState(ResourceUnit *ru) const
 {
     SVDState s;
     bool rIrregular=false;
@@ -114,7 +119,12 @@ int SVDStates::evaluateState(ResourceUnit *ru)
             if (s.admixed_species_index[i]>-1)
                 s.composition = (s.composition << 6) + s.admixed_species_index[i];
     }
+    return s;
+}
 
+int SVDStates::registerState(const SVDState &state)
+{
+    SVDState s = state;
     // lookup state in the hash table and return
     if (!mStateLookup.contains(s)) {
         s.Id = mStates.size();
@@ -142,27 +152,122 @@ static QVector<QPoint> close_points =  QVector<QPoint>() << QPoint(-1,-1) << QPo
 
 void SVDStates::evaluateNeighborhood(ResourceUnit *ru)
 {
-    if (!ru->mSVDState.localComposition) {
-        // create vectors on the heap only when really needed
-        int nspecies = GlobalSettings::instance()->model()->speciesSet()->activeSpecies().size();
-        ru->mSVDState.localComposition = new QVector<float>(nspecies, 0.f);
-        ru->mSVDState.midDistanceComposition = new QVector<float>(nspecies, 0.f);
-    }
-
-    QVector<float> &local = *ru->mSVDState.localComposition;
-    QVector<float> &midrange = *ru->mSVDState.midDistanceComposition;
-
-    // clear the vectors
-    local.fill(0.f);
-    midrange.fill(0.f);
-
     // get the center point
     const Grid<ResourceUnit*> &grid = GlobalSettings::instance()->model()->RUgrid();
     QPoint cp= grid.indexAt(ru->boundingBox().center());
 
     // do the work:
-    executeNeighborhood(local, cp, close_points, grid);
-    executeNeighborhood(midrange, cp, mid_points, grid);
+    int idx = ru->index();
+    executeNeighborhood(mLocalSums.data() + idx*mNSpecies, mLocalCount[idx], cp, close_points, grid);
+    executeNeighborhood(mMidSums.data() + idx*mNSpecies, mMidCount[idx], cp, mid_points, grid);
+    writeNeighborhood(ru);
+}
+
+static void nc_evaluateNeighborhood(ResourceUnit *unit)
+{
+    GlobalSettings::instance()->model()->svdStates()->evaluateNeighborhood(unit);
+}
+
+void SVDStates::recalculateNeighborhoods()
+{
+    const QList<ResourceUnit*> &rus = GlobalSettings::instance()->model()->ruList();
+    mNSpecies = GlobalSettings::instance()->model()->speciesSet()->activeSpecies().size();
+    mLocalSums.fill(0, rus.size()*mNSpecies);
+    mMidSums.fill(0, rus.size()*mNSpecies);
+    mLocalCount.fill(0, rus.size());
+    mMidCount.fill(0, rus.size());
+    mNeighborStateIds.resize(rus.size());
+    for (int i=0;i<rus.size();++i)
+        mNeighborStateIds[i] = rus[i]->svdStateId();
+
+    GlobalSettings::instance()->model()->executePerResourceUnit(nc_evaluateNeighborhood);
+}
+
+int SVDStates::updateNeighborhoods()
+{
+    const QList<ResourceUnit*> &rus = GlobalSettings::instance()->model()->ruList();
+    if (mNeighborStateIds.size() != rus.size()) {
+        // first call: full evaluation
+        recalculateNeighborhoods();
+        return rus.size();
+    }
+
+    // propagate the changes of RUs that changed their state (serial, as the sums of neighbors are modified)
+    const Grid<ResourceUnit*> &grid = GlobalSettings::instance()->model()->RUgrid();
+    QVector<char> dirty(rus.size(), 0);
+    int n_changed = 0;
+    for (int i=0;i<rus.size();++i) {
+        int old_state = mNeighborStateIds[i];
+        int new_state = rus[i]->svdStateId();
+        if (old_state == new_state)
+            continue;
+        ++n_changed;
+        QPoint cp = grid.indexAt(rus[i]->boundingBox().center());
+        propagateNeighborhood(mLocalSums, old_state, new_state, cp, close_points, grid, dirty);
+        propagateNeighborhood(mMidSums, old_state, new_state, cp, mid_points, grid, dirty);
+        mNeighborStateIds[i] = new_state;
+    }
+    for (int i=0;i<rus.size();++i)
+        if (dirty[i])
+            writeNeighborhood(rus[i]);
+
+    if (mValidateNeighborhoods)
+        validateNeighborhoods();
+
+    return n_changed;
+}
+
+bool SVDStates::validateNeighborhoods()
+{
+    QVector<int> local = mLocalSums;
+    QVector<int> mid = mMidSums;
+    QVector<int> local_count = mLocalCount;
+    QVector<int> mid_count = mMidCount;
+
+    recalculateNeighborhoods();
+    bool equal = local==mLocalSums && mid==mMidSums && local_count==mLocalCount && mid_count==mMidCount;
+    if (!equal)
+        qWarning() << "SVDStates::validateNeighborhoods: the incremental update of neighborhoods differs from the full evaluation!";
+    return equal;
+}
+
+void SVDStates::propagateNeighborhood(QVector<int> &sums, int old_state, int new_state, QPoint center_point, const QVector<QPoint> &list, const Grid<ResourceUnit *> &grid, QVector<char> &dirty)
+{
+    // the focal RU is part of the neighborhood of RU 'nb' if focal = nb + offset, i.e. nb = focal - offset
+    for (QVector<QPoint>::const_iterator i=list.constBegin(); i!=list.constEnd(); ++i) {
+        QPoint p = center_point - *i;
+        if (grid.isIndexValid(p)) {
+            ResourceUnit *nb = grid[p];
+            if (nb) {
+                int *v = sums.data() + nb->index()*mNSpecies;
+                if (isStateValid(old_state))
+                    mStates[old_state].neighborhoodShares(v, -1);
+                if (isStateValid(new_state))
+                    mStates[new_state].neighborhoodShares(v, 1);
+                dirty[nb->index()] = 1;
+            }
+        }
+    }
+}
+
+void SVDStates::writeNeighborhood(ResourceUnit *ru)
+{
+    if (!ru->mSVDState.localComposition) {
+        // create vectors on the heap only when really needed
+        ru->mSVDState.localComposition = new QVector<float>(mNSpecies, 0.f);
+        ru->mSVDState.midDistanceComposition = new QVector<float>(mNSpecies, 0.f);
+    }
+    QVector<float> &local = *ru->mSVDState.localComposition;
+    QVector<float> &midrange = *ru->mSVDState.midDistanceComposition;
+    int idx = ru->index();
+    const int *ls = mLocalSums.constData() + idx*mNSpecies;
+    const int *ms = mMidSums.constData() + idx*mNSpecies;
+    float ln = std::max(mLocalCount[idx], 1);
+    float mn = std::max(mMidCount[idx], 1);
+    for (int s=0;s<mNSpecies;++s) {
+        local[s] = ls[s] * 0.01f / ln;
+        midrange[s] = ms[s] * 0.01f / mn;
+    }
 }
 
 QString SVDStates::stateLabel(int index)
@@ -212,26 +317,23 @@ QString SVDStates::stateLabel(int index)
 
 /// run the neighborhood evaluation; list: points to check, vec: a vector with a slot for each species, grid: the resource unit grid,
 /// center_point: the coordinates of the focal resource unit
-void SVDStates::executeNeighborhood(QVector<float> &vec, QPoint center_point, QVector<QPoint> &list, const Grid<ResourceUnit *> &grid)
+void SVDStates::executeNeighborhood(int *sums, int &count, QPoint center_point, const QVector<QPoint> &list, const Grid<ResourceUnit *> &grid)
 {
-    // evaluate the mid range neighborhood
-    float n=0.;
+    // evaluate the neighborhood: sum of the species shares and number of RUs
+    count = 0;
+    std::fill(sums, sums + mNSpecies, 0);
     for (QVector<QPoint>::const_iterator i=list.constBegin(); i!=list.constEnd(); ++i) {
         if (grid.isIndexValid(center_point + *i)) {
             ResourceUnit *nb = grid[center_point + *i];
             if (nb) {
                 int s = nb->svdStateId();
                 if (isStateValid(s)) {
-                    mStates[s].neighborhoodAnalysis(vec);
-                    ++n;
+                    mStates[s].neighborhoodShares(sums, 1);
+                    ++count;
                 }
             }
         }
     }
-    if (n>0) {
-        for (QVector<float>::iterator i=vec.begin(); i!=vec.end();++i)
-            *i/=n;
-    }
 }
 
 QString SVDStates::createCompositionString(const SVDState &s)
@@ -313,3 +415,30 @@ float SVDState::neighborhoodAnalysis(QVector<float> &v)
     return total_weight;
 
 }
+
+void SVDState::neighborhoodShares(int *v, int factor) const
+{
+    // same rules as neighborhoodAnalysis(), shares in 1/100
+    if (dominant_species_index>-1) {
+        if (admixed_species_index[0]==-1) {
+            v[dominant_species_index] += 100*factor;
+        } else {
+            v[dominant_species_index] += 67*factor;
+            v[admixed_species_index[0]] += 33*factor;
+        }
+        return;
+    }
+    int n_s = 0;
+    for (int i=0;i<5;++i)
+        if (admixed_species_index[i]>-1) ++n_s;
+    int f=0;
+    switch (n_s) {
+    case 0: return;
+    case 1: f=50; break;
+    case 2: f=50; break;
+    case 3: f=33; break;
+    case 4: f=25; break;
+    }
+    for (int i=0;i<n_s;++i)
+        v[admixed_species_index[i]] += f*factor;
+}
@@ -23,6 +23,9 @@ struct SVDState
     QString stateLabel() const;
     /// calculate neighborhood population, return total weight added to the vector of species
     float neighborhoodAnalysis(QVector<float> &v);
+    /// add the shares of species (in 1/100, same rules as neighborhoodAnalysis()) multiplied with 'factor' to 'v'
+    /// (one slot per species). Use factor=-1 to remove the contribution of the state.
+    void neighborhoodShares(int *v, int factor) const;
     /// link to the SVD container class
     static SVDStates *svd;
 };
@@ -56,7 +59,11 @@ public:
 
     /// calculate and returns the Id ofthe state that
     /// the resource unit is currently in
-    int evaluateState(ResourceUnit *ru);
+    int evaluateState(ResourceUnit *ru) { return registerState(classifyState(ru)); }
+    /// calculate the state of the resource unit (without registering the state; thread safe)
+    SVDState classifyState(ResourceUnit *ru) const;
+    /// return the Id of the state 's' (a new Id is created for states not seen before; not thread safe)
+    int registerState(const SVDState &s);
     /// access the state with the id 'index'
     const SVDState &state(int index) const { return mStates[index]; }
     /// return true if 'state' is a valid state Id
@@ -65,8 +72,17 @@ public:
     int count() const { return mStates.size(); }
 
     /// evaluate the species composition in the neighborhood of the cell
-    /// this is executed in parallel.
+    /// this is executed in parallel (see recalculateNeighborhoods()).
     void evaluateNeighborhood(ResourceUnit *ru);
+    /// update the species composition in the neighborhood of all resource units: only resource units that changed their
+    /// state since the last update propagate the change (+/-) to their neighbors. The first call does a full evaluation.
+    /// Returns the number of resource units with a changed state.
+    int updateNeighborhoods();
+    /// evaluate the neighborhood of all resource units from scratch (in parallel)
+    void recalculateNeighborhoods();
+    /// compare the incrementally updated neighborhoods (call after updateNeighborhoods()) with a full evaluation. Returns false if they differ
+    /// (the neighborhoods are replaced by the result of the full evaluation in any case).
+    bool validateNeighborhoods();
 
     /// get a string with the main species on the resource unit
     /// dominant species is uppercase, all other lowercase
@@ -79,10 +95,20 @@ private:
     EStructureClassification mStructureClassification;
     EFunctioningClassification mFunctioningClassification;
 
-    inline void executeNeighborhood(QVector<float> &vec, QPoint center_point, QVector<QPoint> &list, const Grid<ResourceUnit*> &grid);
+    inline void executeNeighborhood(int *sums, int &count, QPoint center_point, const QVector<QPoint> &list, const Grid<ResourceUnit*> &grid);
+    void propagateNeighborhood(QVector<int> &sums, int old_state, int new_state, QPoint center_point, const QVector<QPoint> &list, const Grid<ResourceUnit*> &grid, QVector<char> &dirty);
+    void writeNeighborhood(ResourceUnit *ru); ///< write the (normalized) composition of the neighborhood to the RU
     QString createCompositionString(const SVDState &s);
     QVector<SVDState> mStates;
     QVector<QString> mCompositionString;
     QHash<SVDState, int> mStateLookup;
+    // neighborhood composition (updated incrementally)
+    int mNSpecies; ///< number of (active) species
+    QVector<int> mLocalSums; ///< shares (1/100) of species in the local neighborhood (index: ru_index*mNSpecies + species index)
+    QVector<int> mMidSums; ///< shares (1/100) of species in the mid-range neighborhood (index: ru_index*mNSpecies + species index)
+    QVector<int> mLocalCount; ///< number of resource units in the local neighborhood of each RU
+    QVector<int> mMidCount; ///< number of resource units in the mid-range neighborhood of each RU
+    QVector<int> mNeighborStateIds; ///< state of each RU that is included in the neighborhood sums
+    bool mValidateNeighborhoods; ///< if true, the incremental update is compared with a full evaluation every year
 };
 #endif // SVDSTATE_H
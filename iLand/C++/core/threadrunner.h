@@ -34,6 +34,8 @@ public:
     void setup(const QList<Species*> &speciesList) { mSpeciesMap = speciesList; }
     // access
     bool multithreading() const { return mMultithreaded; }
+    /// true while a multithreaded run is in progress (i.e. code that is called from a running thread should not start a nested run)
+    static bool isParallelRunActive() { return mState == MultiThreaded; }
     void setMultithreading(const bool do_multithreading) { mMultithreaded = do_multithreading; }
     void print(); ///< print useful debug messages
     // actions
@@ -22,6 +22,42 @@
 #include "helper.h"
 #include "csvfile.h"
 #include "model.h"
+#include "modelsettings.h"
+
+// typed setters for settings that are cached by the model (ModelSettings)
+static void set_growthEnabled(double v) { Model::changeSettings().growthEnabled = v!=0.; }
+static void set_mortalityEnabled(double v) { Model::changeSettings().mortalityEnabled = v!=0.; }
+static void set_lightExtinctionCoefficient(double v) { Model::changeSettings().lightExtinctionCoefficient = v; }
+static void set_lightExtinctionCoefficientOpacity(double v) { Model::changeSettings().lightExtinctionCoefficientOpacity = v; }
+static void set_temperatureTau(double v) { Model::changeSettings().temperatureTau = v; }
+static void set_epsilon(double v) { Model::changeSettings().epsilon = v; }
+static void set_airDensity(double v) { Model::changeSettings().airDensity = v; }
+static void set_laiThresholdForClosedStands(double v) { Model::changeSettings().laiThresholdForClosedStands = v; }
+static void set_boundaryLayerConductance(double v) { Model::changeSettings().boundaryLayerConductance = v; }
+static void set_useDynamicAvailableNitrogen(double v) { Model::changeSettings().useDynamicAvailableNitrogen = v!=0.; }
+
+QHash<QString, TimeEvents::Setter> &TimeEvents::setters()
+{
+    static QHash<QString, Setter> setter_list;
+    if (setter_list.isEmpty()) {
+        setter_list["model.settings.growthEnabled"] = set_growthEnabled;
+        setter_list["model.settings.mortalityEnabled"] = set_mortalityEnabled;
+        setter_list["model.settings.lightExtinctionCoefficient"] = set_lightExtinctionCoefficient;
+        setter_list["model.settings.lightExtinctionCoefficientOpacity"] = set_lightExtinctionCoefficientOpacity;
+        setter_list["model.settings.temperatureTau"] = set_temperatureTau;
+        setter_list["model.settings.epsilon"] = set_epsilon;
+        setter_list["model.settings.airDensity"] = set_airDensity;
+        setter_list["model.settings.laiThresholdForClosedStands"] = set_laiThresholdForClosedStands;
+        setter_list["model.settings.boundaryLayerConductance"] = set_boundaryLayerConductance;
+        setter_list["model.settings.soil.useDynamicAvailableNitrogen"] = set_useDynamicAvailableNitrogen;
+    }
+    return setter_list;
+}
+
+void TimeEvents::registerSetter(const QString &key, Setter setter)
+{
+    setters()[key] = setter;
+}
 
 TimeEvents::TimeEvents()
 {
@@ -47,50 +83,88 @@ bool TimeEvents::loadFromString(const QStringList &source)
 
     int year;
     QVariantList line;
-    QPair<QString, QVariant> entry;
+    // resolve the keys (columns) once
+    QVector<int> col_binding(captions.count(), -1);
+    for (int col=0;col<captions.count();col++)
+        if (col!=yearcol)
+            col_binding[col] = binding(captions[col]);
+
+    int n_items = 0;
     for (int row=0;row<infile.rowCount();row++) {
         year = infile.value(row, yearcol).toInt();
         line = infile.values(row);
         if (line.count()!=infile.colCount())
             throw IException("TimeEvents: invalid file (number of data columns different than head columns)");
+        QVector<Event> &events = mSchedule[year];
         for (int col=0;col<line.count();col++) {
              if (col!=yearcol) {
-                 entry.first = captions[col];
-                 entry.second = line[col];
-                 mData.insert(year, entry);
+                 const Binding &b = mBindings[col_binding[col]];
+                 Event e;
+                 e.binding = col_binding[col];
+                 e.value = line[col];
+                 e.text = line[col].toString();
+                 e.number = 0.;
+                 if (b.setter) {
+                     bool ok = true;
+                     if (e.text=="true") e.number = 1.;
+                     else if (e.text=="false") e.number = 0.;
+                     else e.number = e.text.toDouble(&ok);
+                     if (!ok)
+                         throw IException(QString("TimeEvents: invalid value '%1' for key '%2' (year %3): a numeric value is required.").arg(e.text, b.key).arg(year));
+                 }
+                 // the latest entry is executed first (as with the previous implementation)
+                 events.prepend(e);
+                 ++n_items;
              }
         }
     } // for each row
-    qDebug() << QString("loaded TimeEvents (file: %1). %2 items stored.").arg(lastLoadedFile).arg(mData.count());
+    qDebug() << QString("loaded TimeEvents (file: %1). %2 items stored.").arg(lastLoadedFile).arg(n_items);
     return true;
 }
 
+int TimeEvents::binding(const QString &key)
+{
+    for (int i=0;i<mBindings.size();++i)
+        if (mBindings[i].key == key)
+            return i;
+
+    Binding b;
+    b.key = key;
+    if (key=="script" || key=="javascript") {
+        b.is_script = true;
+    } else {
+        b.node = GlobalSettings::instance()->settings().node(key);
+        b.setter = setters().value(key, nullptr);
+        if (!b.setter && (b.node.isNull() || !b.node.hasChildNodes()))
+            throw IException("TimeEvents: key '" + key + "' not found in the XML file. \n (Note: corresponding value must not be empty in the project file!). ");
+    }
+    mBindings.push_back(b);
+    return mBindings.size()-1;
+}
+
 void TimeEvents::run()
 {
     int current_year = GlobalSettings::instance()->currentYear();
-    QList<QPair<QString, QVariant> > entries = mData.values(current_year);
-    if (entries.count()==0)
+    QMap<int, QVector<Event> >::iterator it = mSchedule.find(current_year);
+    if (it == mSchedule.end() || it->isEmpty())
         return;
 
-    QString key;
     int values_set = 0;
-    for (int i=0;i<entries.count();i++) {
-        key = entries[i].first; // key
-        // special values: if (key=="xxx" ->
-        if (key=="script" || key=="javascript") {
+    for (const Event &e : *it) {
+        Binding &b = mBindings[e.binding];
+        if (b.is_script) {
             // execute as javascript expression within the management script context...
-            if (!entries[i].second.toString().isEmpty()) {
-                qDebug() << "executing Javascript time event:" << entries[i].second.toString();
-                GlobalSettings::instance()->executeJavascript(entries[i].second.toString());
+            if (!e.text.isEmpty()) {
+                qDebug() << "executing Javascript time event:" << e.text;
+                GlobalSettings::instance()->executeJavascript(e.text);
             }
-
         } else {
-            // no special value: a xml node...
-            if (! const_cast<XmlHelper&>(GlobalSettings::instance()->settings()).setNodeValue(key, entries[i].second.toString())) {
-                qDebug() << "TimeEvents: Error: Key " << key << "not found! (tried to set to" << entries[i].second.toString() << ")";
-                throw IException("TimeEvents: key '" + key + "' not found in the XML file. \n (Note: corresponding value must not be empty in the project file!). ");
-            } else
-                qDebug() << "TimeEvents: set" << key << "to" << entries[i].second.toString();
+            // update the settings node (components that read the settings tree) and call the typed setter (if present)
+            if (!b.node.isNull() && b.node.hasChildNodes())
+                b.node.firstChild().toText().setData(e.text);
+            if (b.setter)
+                (*b.setter)(e.number);
+            qDebug() << "TimeEvents: set" << b.key << "to" << e.text;
         }
         values_set++;
     }
@@ -102,11 +176,11 @@ void TimeEvents::run()
 // return a empty QVariant if for 'year' no value is set
 QVariant TimeEvents::value(int year, const QString &key) const
 {
-    QMultiMap<int, QPair<QString, QVariant> >::ConstIterator it = mData.find(year);
-    while (it!=mData.constEnd()) {
-        if (it->first == key)
-            return it->second;
-        ++it;
-    }
+    QMap<int, QVector<Event> >::const_iterator it = mSchedule.constFind(year);
+    if (it == mSchedule.constEnd())
+        return QVariant();
+    for (const Event &e : *it)
+        if (mBindings[e.binding].key == key)
+            return e.value;
     return QVariant();
 }
@@ -20,22 +20,50 @@
 #ifndef TIMEEVENTS_H
 #define TIMEEVENTS_H
 #include <QtCore>
-/** */
+#include <QtXml/QDomElement>
+/** TimeEvents change settings of the model at specific years (e.g. climate shifts, CO2, module parameters).
+  @ingroup core
+  The events are loaded from a table (a 'year' column and a column per setting). At load time each key is
+  compiled to a binding: either a script ('script' or 'javascript'), or the node of the settings (XML) that
+  is updated, and optionally a typed setter (see registerSetter()) for settings that are cached in model components
+  (e.g. the ModelSettings). Keys that do not exist fail at setup. Every year the list of (binding, value) pairs
+  of the year is applied without parsing paths or values.
+  */
 class TimeEvents
 {
 public:
+    /// a setter function that applies a (numeric) value to a component (bool values are passed as 0/1)
+    typedef void (*Setter)(double value);
     TimeEvents();
     // setup
-    void clear() { mData.clear(); }
+    void clear() { mSchedule.clear(); mBindings.clear(); }
     bool loadFromString(const QStringList &source);
     bool loadFromFile(const QString &fileName);
+    /// register a typed setter for the settings key 'key' (e.g. 'model.settings.epsilon')
+    static void registerSetter(const QString &key, Setter setter);
     // excecute
     void run(); ///< execute all settings
     /// read value for key 'key' and year 'year' from the list of items. Return QVariant() if not found.
     QVariant value(int year, const QString &key) const;
 
 private:
-    QMultiMap<int, QPair<QString, QVariant> > mData;
+    struct Binding {
+        Binding(): setter(nullptr), is_script(false) {}
+        QString key;
+        QDomElement node; ///< resolved node of the settings (null for scripts)
+        Setter setter; ///< typed setter (or nullptr)
+        bool is_script;
+    };
+    struct Event {
+        int binding; ///< index in mBindings
+        QVariant value; ///< the original value
+        QString text; ///< the value as string (for the settings node or the script)
+        double number; ///< the value for the typed setter
+    };
+    int binding(const QString &key); ///< get (or create) the binding for 'key'; throws for unknown keys
+    QVector<Binding> mBindings;
+    QMap<int, QVector<Event> > mSchedule; ///< events per year (in the order of execution)
+    static QHash<QString, Setter> &setters();
 };
 
 #endif // TIMEEVENTS_H
@@ -26,6 +26,7 @@
 #include "resourceunit.h"
 #include "model.h"
 #include "snag.h"
+#include "microclimate.h"
 
 #include "forestmanagementengine.h"
 #include "modules.h"
@@ -33,6 +34,9 @@
 
 #include "treeout.h"
 #include "landscapeout.h"
+#include "treeremovalevents.h"
+
+#include <cstring>
 
 // static varaibles
 FloatGrid *Tree::mGrid = nullptr;
@@ -226,7 +230,37 @@ inline int torusIndex(int index, int count, int buffer, int ru_index)
 }
 
 
+/// wrapped local index (relative to the buffer) on a grid with 'count' cells per ha (same result as torusIndex() - buffer - ru_index)
+inline int torusWrap(int local_index, int count)
+{
+    local_index %= count;
+    return local_index<0 ? local_index + count : local_index;
+}
+
+/// a contiguous run of pixels on the stamp that is also contiguous on the (wrapped) grid
+struct TorusSpan {
+    int stamp_start; ///< first index on the stamp
+    int grid_start; ///< first index on the grid (wrapped)
+    int length;
+};
+/// split the range [start, start+size) on the grid into spans that are contiguous after wrapping
+/// (at most 2 spans for stamps that are smaller than the resource unit)
+static void torusSpans(int start, int size, int buffer, int ru_index, QVarLengthArray<TorusSpan, 4> &spans)
+{
+    spans.clear();
+    int i = 0;
+    while (i<size) {
+        int w = torusWrap(start + i - buffer, cPxPerRU);
+        int len = std::min(size - i, cPxPerRU - w); // up to the edge of the resource unit
+        TorusSpan span = { i, buffer + ru_index + w, len };
+        spans.append(span);
+        i += len;
+    }
+}
+
 /** Apply LIPs. This "Torus" functions wraps the influence at the edges of a 1ha simulation area.
+  The stamp is split into (at most four) rectangles that are contiguous on the grid; the pixels are
+  processed in the same order as without torus (see validateTorusKernels()).
   */
 void Tree::applyLIP_torus()
 {
@@ -241,6 +275,53 @@ void Tree::applyLIP_torus()
     int offset = mStamp->offset();
     pos-=QPoint(offset, offset);
 
+    int gr_stamp = mStamp->size();
+    if (!mGrid->isIndexValid(pos) || !mGrid->isIndexValid(pos+QPoint(gr_stamp, gr_stamp))) {
+        return;
+    }
+    QVarLengthArray<TorusSpan, 4> xspans, yspans;
+    torusSpans(pos.x(), gr_stamp, bufferOffset, ru_offset.x(), xspans);
+    torusSpans(pos.y(), gr_stamp, bufferOffset, ru_offset.y(), yspans);
+
+    float local_dom; // height of Z* on the current position
+    float value, z, z_zstar;
+    for (const TorusSpan &ys : yspans) {
+        for (int y=ys.stamp_start, grid_y=ys.grid_start; y<ys.stamp_start+ys.length; ++y, ++grid_y) {
+            for (const TorusSpan &xs : xspans) {
+                // same inner loop as in applyLIP()
+                float *grid_value_ptr = mGrid->ptr(xs.grid_start, grid_y);
+                int grid_x = xs.grid_start;
+                for (int x=xs.stamp_start; x<xs.stamp_start+xs.length; ++x, ++grid_x, ++grid_value_ptr) {
+                    local_dom = (*mHeightGrid)(grid_x/cPxPerHeight, grid_y/cPxPerHeight).height;
+                    z = std::max(mHeight - (*mStamp).distanceToCenter(x,y), 0.f); // distance to center = height (45 degree line)
+                    z_zstar = (z>=local_dom)?1.f:z/local_dom;
+                    value = (*mStamp)(x,y); // stampvalue
+                    value = 1.f - value*mOpacity * z_zstar; // calculated value
+                    value = std::max(value, 0.02f); // limit value
+
+                    *grid_value_ptr *= value;
+                }
+            }
+        }
+    }
+
+    m_statPrint++; // count # of stamp applications...
+}
+
+/// reference implementation of applyLIP_torus() (wrap-around per pixel)
+void Tree::applyLIP_torusReference()
+{
+    if (!mStamp)
+        return;
+    Q_ASSERT(mGrid!=0 && mStamp!=0 && mRU!=0);
+    int bufferOffset = mGrid->indexAt(QPointF(0.,0.)).x(); // offset of buffer
+    QPoint pos = QPoint((mPositionIndex.x()-bufferOffset)%cPxPerRU  + bufferOffset,
+                        (mPositionIndex.y()-bufferOffset)%cPxPerRU + bufferOffset); // offset within the ha
+    QPoint ru_offset = QPoint(mPositionIndex.x() - pos.x(), mPositionIndex.y() - pos.y()); // offset of the corner of the resource index
+
+    int offset = mStamp->offset();
+    pos-=QPoint(offset, offset);
+
     float local_dom; // height of Z* on the current position
     int x,y;
     float value;
@@ -363,6 +444,50 @@ void Tree::heightGrid()
 }
 
 void Tree::heightGrid_torus()
+{
+    QPoint p = QPoint(mPositionIndex.x()/cPxPerHeight, mPositionIndex.y()/cPxPerHeight); // pos of tree on height grid
+    int bufferOffset = mHeightGrid->indexAt(QPointF(0.,0.)).x(); // offset of buffer (i.e.: size of buffer in height-pixels)
+    p.setX((p.x()-bufferOffset)%10 + bufferOffset); // 10: 10 x 10m pixeln in 100m
+    p.setY((p.y()-bufferOffset)%10 + bufferOffset);
+    // torus coordinates: ru_offset = coords of lower left corner of 1ha patch
+    QPoint ru_offset =QPoint(mPositionIndex.x()/cPxPerHeight - p.x(), mPositionIndex.y()/cPxPerHeight - p.y());
+    const int base_x = bufferOffset + ru_offset.x();
+    const int base_y = bufferOffset + ru_offset.y();
+    const int lx = p.x() - bufferOffset;
+    const int ly = p.y() - bufferOffset;
+    const int cx = base_x + torusWrap(lx, 10);
+    const int cy = base_y + torusWrap(ly, 10);
+
+    // count trees that are on height-grid cells (used for stockable area)
+    HeightGridValue &v = mHeightGrid->valueAtIndex(cx, cy);
+    v.increaseCount();
+    v.height = qMax(v.height, mHeight);
+    if (mHeight > v.stemHeight())
+        v.setStemHeight(mHeight);
+
+    int r = mStamp->reader()->offset(); // distance between edge and the center pixel. e.g.: if r = 2 -> stamp=5x5
+    int index_eastwest = mPositionIndex.x() % cPxPerHeight; // 4: very west, 0 east edge
+    int index_northsouth = mPositionIndex.y() % cPxPerHeight; // 4: northern edge, 0: southern edge
+    if (index_eastwest - r < 0) { // east
+        HeightGridValue &v = mHeightGrid->valueAtIndex(base_x + torusWrap(lx-1, 10), cy);
+        v.height = qMax(v.height, mHeight);
+    }
+    if (index_eastwest + r >= cPxPerHeight) {  // west
+        HeightGridValue &v = mHeightGrid->valueAtIndex(base_x + torusWrap(lx+1, 10), cy);
+        v.height = qMax(v.height, mHeight);
+    }
+    if (index_northsouth - r < 0) {  // south
+        HeightGridValue &v = mHeightGrid->valueAtIndex(cx, base_y + torusWrap(ly-1, 10));
+        v.height = qMax(v.height, mHeight);
+    }
+    if (index_northsouth + r >= cPxPerHeight) {  // north
+        HeightGridValue &v = mHeightGrid->valueAtIndex(cx, base_y + torusWrap(ly+1, 10));
+        v.height = qMax(v.height, mHeight);
+    }
+}
+
+/// reference implementation of heightGrid_torus() (wrap-around per pixel)
+void Tree::heightGrid_torusReference()
 {
     // height of Z*
 
@@ -525,14 +650,10 @@ void Tree::readLIF()
     //qDebug() << "Tree #"<< id() << "value" << sum << "Impact" << mImpact;
 }
 
-/// Torus version of read stamp (glued edges)
-void Tree::readLIF_torus()
+/// reference implementation of readLIFSum_torus() (wrap-around per pixel)
+double Tree::readLIFSum_torusReference() const
 {
-    if (!mStamp)
-        return;
     const Stamp *reader = mStamp->reader();
-    if (!reader)
-        return;
     int bufferOffset = mGrid->indexAt(QPointF(0.,0.)).x(); // offset of buffer
 
     QPoint pos_reader = QPoint((mPositionIndex.x()-bufferOffset)%cPxPerRU + bufferOffset,
@@ -550,7 +671,7 @@ void Tree::readLIF_torus()
     int x,y;
     double sum=0.;
     double value, own_value;
-    float *grid_value;
+    const float *grid_value;
     float z, z_zstar;
     int reader_size = reader->size();
     int rx = pos_reader.x();
@@ -579,6 +700,63 @@ void Tree::readLIF_torus()
             //} // isIndexValid
         }
     }
+    return sum;
+}
+
+/// sum of LIF values of the torus version: the reader stamp is split into (at most four) rectangles
+/// that are contiguous on the grid; the inner loop is the same as in readLIF() (without the 'outside' effect).
+double Tree::readLIFSum_torus() const
+{
+    const Stamp *reader = mStamp->reader();
+    int bufferOffset = mGrid->indexAt(QPointF(0.,0.)).x(); // offset of buffer
+
+    QPoint pos_reader = QPoint((mPositionIndex.x()-bufferOffset)%cPxPerRU + bufferOffset,
+                               (mPositionIndex.y()-bufferOffset)%cPxPerRU + bufferOffset); // offset within the ha
+    QPoint ru_offset = QPoint(mPositionIndex.x() - pos_reader.x(), mPositionIndex.y() - pos_reader.y()); // offset of the corner of the resource index
+
+    int offset_reader = reader->offset();
+    int offset_writer = mStamp->offset();
+    int d_offset = offset_writer - offset_reader; // offset on the *stamp* to the crown-cells
+
+    pos_reader-=QPoint(offset_reader, offset_reader);
+    int reader_size = reader->size();
+    QVarLengthArray<TorusSpan, 4> xspans, yspans;
+    torusSpans(pos_reader.x(), reader_size, bufferOffset, ru_offset.x(), xspans);
+    torusSpans(pos_reader.y(), reader_size, bufferOffset, ru_offset.y(), yspans);
+
+    float local_dom;
+    double sum=0.;
+    double value, own_value;
+    float z, z_zstar;
+    for (const TorusSpan &ys : yspans) {
+        for (int y=ys.stamp_start, yt=ys.grid_start; y<ys.stamp_start+ys.length; ++y, ++yt) {
+            for (const TorusSpan &xs : xspans) {
+                const float *grid_value = mGrid->ptr(xs.grid_start, yt);
+                int xt = xs.grid_start;
+                for (int x=xs.stamp_start; x<xs.stamp_start+xs.length; ++x, ++xt) {
+                    local_dom = mHeightGrid->constValueAtIndex(xt/cPxPerHeight, yt/cPxPerHeight).height;
+                    z = std::max(mHeight - reader->distanceToCenter(x,y), 0.f); // distance to center = height (45 degree line)
+                    z_zstar = (z>=local_dom)?1.f:z/local_dom;
+
+                    own_value = 1. - mStamp->offsetValue(x,y,d_offset)*mOpacity * z_zstar;
+                    own_value = qMax(own_value, 0.02);
+                    value =  *grid_value++ / own_value; // remove impact of focal tree
+                    if (value * (*reader)(x,y)>1.)
+                        qDebug() << "LIFTorus: value>1: " << value * (*reader)(x,y) << " Tree: " << species()->id() << ", dbh: " << dbh();
+                    sum += value * (*reader)(x,y);
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+/// Torus version of read stamp (glued edges)
+void Tree::readLIF_torus()
+{
+    if (!mStamp || !mStamp->reader())
+        return;
+    double sum = readLIFSum_torus();
     mLRI = static_cast<float>( sum );
 
     // LRI correction...
@@ -599,6 +777,69 @@ void Tree::readLIF_torus()
     mRU->addWLA(mLeafArea, mLRI);
 }
 
+// copy the content of grid 'from' to grid 'to' (same size)
+template <class T>
+static void copyGridValues(const Grid<T> &from, Grid<T> &to)
+{
+    std::copy(from.begin(), from.end(), to.begin());
+}
+
+int Tree::validateTorusKernels()
+{
+    Model *model = GlobalSettings::instance()->model();
+    if (!model || !mGrid || !mHeightGrid)
+        return 0;
+    FloatGrid lif_saved(*mGrid);
+    HeightGrid height_saved(*mHeightGrid);
+    int stat_print = m_statPrint;
+    int differences = 0;
+    Tree *tree;
+
+    // (1) height grid
+    AllTreeIterator at(model);
+    while ((tree = at.nextLiving()))
+        if (tree->mStamp)
+            tree->heightGrid_torusReference();
+    HeightGrid height_reference(*mHeightGrid);
+    copyGridValues(height_saved, *mHeightGrid);
+    at.reset();
+    while ((tree = at.nextLiving()))
+        if (tree->mStamp)
+            tree->heightGrid_torus();
+    for (const HeightGridValue *p=mHeightGrid->begin(), *r=height_reference.begin(); p!=mHeightGrid->end(); ++p, ++r)
+        if (memcmp(p, r, sizeof(HeightGridValue)) != 0)
+            ++differences;
+    int diff_height = differences;
+
+    // (2) LIF pattern
+    at.reset();
+    while ((tree = at.nextLiving()))
+        tree->applyLIP_torusReference();
+    FloatGrid lif_reference(*mGrid);
+    copyGridValues(lif_saved, *mGrid);
+    at.reset();
+    while ((tree = at.nextLiving()))
+        tree->applyLIP_torus();
+    for (const float *p=mGrid->begin(), *r=lif_reference.begin(); p!=mGrid->end(); ++p, ++r)
+        if (*p != *r)
+            ++differences;
+    int diff_lif = differences - diff_height;
+
+    // (3) read LIF (on the pattern of step 2)
+    at.reset();
+    while ((tree = at.nextLiving()))
+        if (tree->mStamp && tree->mStamp->reader())
+            if (tree->readLIFSum_torus() != tree->readLIFSum_torusReference())
+                ++differences;
+    int diff_read = differences - diff_height - diff_lif;
+
+    // restore the state of the grids
+    copyGridValues(lif_saved, *mGrid);
+    copyGridValues(height_saved, *mHeightGrid);
+    m_statPrint = stat_print;
+    qDebug() << "validateTorusKernels: differences height grid:" << diff_height << "LIF grid:" << diff_lif << "read LIF:" << diff_read;
+    return differences;
+}
 
 void Tree::resetStatistics()
 {
@@ -675,7 +916,11 @@ void Tree::grow()
         }
     //); // DBGMODE()
     if (Globals->model()->settings().growthEnabled) {
+            const double old_ba = basalArea();
+            const double old_leaf_area = mLeafArea;
             partitioning(d); // split npp to compartments and grow (diameter, height), but also calculate stress index of the tree.
+            if (mRU->microClimate())
+                mRU->microClimate()->updateTree(this, old_ba, old_leaf_area);
     }
 
     // mortality
@@ -997,6 +1242,8 @@ inline double Tree::relative_height_growth()
   @sa ResourceUnit::cleanTreeList(), remove() */
 void Tree::die(TreeGrowthData *d)
 {
+    if (!isDead() && mRU->microClimate())
+        mRU->microClimate()->removeTree(this);
     setFlag(Tree::TreeDead, true); // set flag that tree is dead
     mRU->treeDied();
     ResourceUnitSpecies &rus = mRU->resourceUnitSpecies(species());
@@ -1009,6 +1256,8 @@ void Tree::die(TreeGrowthData *d)
 /// remove a tree (most likely due to harvest) from the system.
 void Tree::remove(double removeFoliage, double removeBranch, double removeStem )
 {
+    if (!isDead() && mRU->microClimate())
+        mRU->microClimate()->removeTree(this);
     setFlag(Tree::TreeDead, true); // set flag that tree is dead
     setIsHarvested();
     mRU->treeDied();
@@ -1034,6 +1283,8 @@ void Tree::removeDisturbance(const double stem_to_soil_fraction,
                              const double branch_to_snag_fraction,
                              const double foliage_to_soil_fraction)
 {
+    if (!isDead() && mRU->microClimate())
+        mRU->microClimate()->removeTree(this);
     setFlag(Tree::TreeDead, true); // set flag that tree is dead
     mRU->treeDied();
     ResourceUnitSpecies &rus = mRU->resourceUnitSpecies(species());
@@ -1060,7 +1311,10 @@ void Tree::removeBiomassOfTree(const double removeFoliageFraction, const double
     mBranchMass *= static_cast<float>(1. - removeBranchFraction);
     if (removeFoliageFraction>0.) {
         // update related leaf area
+        const double old_leaf_area = mLeafArea;
         mLeafArea = static_cast<float>( mFoliageMass * species()->specificLeafArea() ); // update leaf area
+        if (!isDead() && mRU->microClimate())
+            mRU->microClimate()->updateTree(this, basalArea(), old_leaf_area);
         mOpacity = static_cast<float>( 1. - exp(-Model::settings().lightExtinctionCoefficientOpacity * mLeafArea / mStamp->crownArea()) );
         //if (removeFoliageFraction==1.)
         //    m_statAboveZ = mId; // temp
@@ -1151,11 +1405,8 @@ void Tree::notifyTreeRemoved(TreeRemovalType reason)
         reason = TreeSalavaged;
     if (isCutdown())
         reason = TreeCutDown;
-    // create output for tree removals
-    if (mRemovalOutput && mRemovalOutput->isEnabled())
-        mRemovalOutput->execRemovedTree(this, static_cast<int>(reason));
-    if (mLSRemovalOutput && mLSRemovalOutput->isEnabled())
-        mLSRemovalOutput->execRemovedTree(this, static_cast<int>(reason));
+    // create output for tree removals: the removal is recorded (thread local) and passed to the outputs later
+    TreeRemovalEvents::record(this, static_cast<int>(reason));
 }
 
 //////////////////////////////////////////////////
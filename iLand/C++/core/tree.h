@@ -39,6 +39,7 @@ class TreeRemovedOut;
 class LandscapeRemovedOut;
 class Saplings;
 class ScriptTree;
+class DebugList;
 
 class Tree
 {
@@ -147,6 +148,9 @@ public:
     void applyLIP_torus(); ///< apply LightInfluencePattern on a closed 1ha area
     void readLIF_torus(); ///< calculate LRI from a closed 1ha area
     void heightGrid_torus(); ///< calculate the height grid
+    /// compare the torus kernels with the (per pixel wrapping) reference implementation for all trees of the model.
+    /// The LIF and height grids are restored afterwards. Returns the number of differences (0: identical).
+    static int validateTorusKernels();
 
     void calcLightResponse(); ///< calculate light response
     // growth, etc.
@@ -163,7 +167,7 @@ public:
 #endif
 
     QString dump();
-    void dumpList(QList<QVariant> &rTargetList);
+    void dumpList(DebugList &rTargetList);
     const Stamp *stamp() const { return mStamp; } ///< TODO: only for debugging purposes
 
 private:
@@ -177,6 +181,12 @@ private:
     void altMortality(TreeGrowthData &d); ///< alternative version of the mortality sub module
 #endif
     void notifyTreeRemoved(TreeRemovalType reason); ///< record the removed volume in the height grid
+    // torus mode: sum of the LIF values (light resource index before corrections)
+    double readLIFSum_torus() const;
+    // reference implementations of the torus kernels (wrap-around per pixel), see validateTorusKernels()
+    void applyLIP_torusReference();
+    double readLIFSum_torusReference() const;
+    void heightGrid_torusReference();
 
     // state variables
     int mId; ///< unique ID of tree
@@ -249,6 +259,7 @@ private:
     friend class TreeOut;
     friend class TreeRemovedOut;
     friend class LandscapeRemovedOut;
+    friend class TreeRemovalEvents;
     friend class Snapshot;
     friend class SnapshotItem;
     friend class ScriptTree;
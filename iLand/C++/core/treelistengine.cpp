@@ -0,0 +1,154 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "treelistengine.h"
+
+#include "expression.h"
+#include "expressionwrapper.h"
+#include "model.h"
+#include "threadrunner.h"
+
+#include <algorithm>
+
+// a part of the tree list that is evaluated by a single thread
+struct TreeListChunk {
+    const Expression *expr;
+    const TreeListEngine::Item *begin;
+    double *values;
+    int n;
+};
+
+static void nc_evaluateChunk(TreeListChunk &chunk)
+{
+    TreeWrapper tw; // each chunk uses its own wrapper
+    double var_space[EXPRNLOCALVARS];
+    for (int i=0;i<EXPRNLOCALVARS;++i)
+        var_space[i] = 0.;
+    try {
+        for (int i=0;i<chunk.n;++i) {
+            tw.setTree(chunk.begin[i].first);
+            chunk.values[i] = chunk.expr->execute(var_space, &tw);
+        }
+    } catch (const IException &e) {
+        GlobalSettings::instance()->model()->threadExec().throwError(e.message());
+    }
+}
+
+void TreeListEngine::evaluate(const QString &expression, const List &trees, QVector<double> &values)
+{
+    values.resize(trees.size());
+    if (trees.isEmpty())
+        return;
+    TreeWrapper tw;
+    Expression expr(expression, &tw);
+    expr.enableIncSum();
+    expr.parse(&tw); // parse once (before the threads start)
+
+    Model *model = GlobalSettings::instance()->model();
+    TreeListChunk all = { &expr, trees.constData(), values.data(), trees.size() };
+    if (!model || trees.size() < cMinParallelSize || expr.isOrderDependent()) {
+        // serial evaluation (preserves the order of evaluation)
+        for (int i=0;i<all.n;++i) {
+            tw.setTree(all.begin[i].first);
+            all.values[i] = expr.calculate(tw);
+        }
+        return;
+    }
+
+    int n_chunks = std::max(QThread::idealThreadCount() * 4, 1);
+    int chunk_size = (trees.size() + n_chunks - 1) / n_chunks;
+    QVector<TreeListChunk> chunks;
+    for (int i=0; i<trees.size(); i+=chunk_size) {
+        TreeListChunk c = { &expr, trees.constData() + i, values.data() + i, std::min(chunk_size, trees.size() - i) };
+        chunks.push_back(c);
+    }
+    model->threadExec().run(nc_evaluateChunk, chunks);
+    model->threadExec().checkErrors(); // throws an IException
+}
+
+void TreeListEngine::evaluateValues(const QString &expression, List &trees)
+{
+    QVector<double> values;
+    evaluate(expression, trees, values);
+    for (int i=0;i<trees.size();++i)
+        trees[i].second = values[i];
+}
+
+static bool treeItemLess(const TreeListEngine::Item &a, const TreeListEngine::Item &b)
+{
+    return a.second < b.second;
+}
+
+void TreeListEngine::sort(List &trees, const QString &expression)
+{
+    evaluateValues(expression, trees);
+    std::sort(trees.begin(), trees.end(), treeItemLess);
+}
+
+void TreeListEngine::partialSort(List &trees, const QString &expression, int n)
+{
+    evaluateValues(expression, trees);
+    n = qBound(0, n, trees.size());
+    std::partial_sort(trees.begin(), trees.begin() + n, trees.end(), treeItemLess);
+}
+
+void TreeListEngine::sortMultiKey(List &trees, const QStringList &expressions)
+{
+    if (expressions.isEmpty() || trees.isEmpty())
+        return;
+    const int n = trees.size();
+    const int n_keys = expressions.size();
+    // evaluate each key once per tree; keys[k*n + i] is the value of key k for the tree i
+    QVector<double> keys(n * n_keys);
+    QVector<double> values;
+    for (int k=0;k<n_keys;++k) {
+        evaluate(expressions[k], trees, values);
+        std::copy(values.constBegin(), values.constEnd(), keys.begin() + k*n);
+    }
+    // sort an index vector, comparing the keys in order
+    QVector<int> order(n);
+    for (int i=0;i<n;++i)
+        order[i] = i;
+    const double *key_data = keys.constData();
+    std::sort(order.begin(), order.end(), [key_data, n, n_keys](int a, int b) {
+        for (int k=0;k<n_keys;++k) {
+            double va = key_data[k*n + a], vb = key_data[k*n + b];
+            if (va < vb) return true;
+            if (vb < va) return false;
+        }
+        return a < b;
+    });
+    List sorted(n);
+    for (int i=0;i<n;++i)
+        sorted[i] = Item(trees[order[i]].first, key_data[order[i]]);
+    trees.swap(sorted);
+}
+
+double TreeListEngine::percentile(const List &trees, const QString &expression, int pct)
+{
+    if (trees.isEmpty())
+        return -1.;
+    QVector<double> values;
+    evaluate(expression, trees, values);
+    // same index as Management::percentile() on a sorted list
+    int idx = qBound(0, int( (pct/100.) * values.size()), values.size()-1);
+    std::nth_element(values.begin(), values.begin() + idx, values.end());
+    return values[idx];
+}
@@ -0,0 +1,63 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef TREELISTENGINE_H
+#define TREELISTENGINE_H
+#include <QtCore/QVector>
+#include <QtCore/QPair>
+#include <QtCore/QStringList>
+
+class Tree;
+
+/** TreeListEngine provides the heavy lifting for tree lists of the Management (and similar tree lists).
+  @ingroup core
+  Tree lists are stored contiguously (a vector of a tree pointer and a value per tree). Expressions
+  are evaluated in parallel for chunks of the list (each chunk uses its own TreeWrapper). Expressions
+  that depend on the order of evaluation (incremental sums, random numbers) are always evaluated serially.
+  Random draws that depend on the result of an expression are left to the caller and are done in list order,
+  i.e. results are identical for single- and multithreaded execution.
+  Sorting and percentiles use partial sorting (std::partial_sort, std::nth_element) if only a part of the
+  sorted list is required.
+  */
+class TreeListEngine
+{
+public:
+    typedef QPair<Tree*, double> Item;
+    typedef QVector<Item> List;
+
+    /// evaluate 'expression' for all trees in 'trees' and store the results in 'values' (same order)
+    static void evaluate(const QString &expression, const List &trees, QVector<double> &values);
+    /// evaluate 'expression' for all trees and store the result as the value of each item of 'trees'
+    static void evaluateValues(const QString &expression, List &trees);
+
+    /// sort the list ascending by 'expression' (the value of each item is the result of the expression)
+    static void sort(List &trees, const QString &expression);
+    /// sort only the first 'n' elements ascending by 'expression' (the order of the rest is unspecified)
+    static void partialSort(List &trees, const QString &expression, int n);
+    /// sort by multiple keys: the list is ordered by the first expression, ties are broken by the second, ...
+    /// Each key is evaluated once per tree; the value of each item is the result of the first expression.
+    static void sortMultiKey(List &trees, const QStringList &expressions);
+    /// return the value of 'expression' at the 'pct' percentile (0..100) without changing the list
+    static double percentile(const List &trees, const QString &expression, int pct);
+
+    /// lists with fewer trees are processed without threading
+    static const int cMinParallelSize = 5000;
+};
+
+#endif // TREELISTENGINE_H
@@ -0,0 +1,127 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "treeremovalevents.h"
+
+#include "tree.h"
+#include "resourceunit.h"
+#include "species.h"
+#include "treeout.h"
+#include "landscapeout.h"
+
+#include <algorithm>
+
+QList<TreeRemovalEvents::Buffer*> TreeRemovalEvents::mBuffers;
+static QMutex removal_buffer_mutex; // used for registering buffers only
+static thread_local TreeRemovalEvents::Buffer *tls_removal_buffer = nullptr;
+
+TreeRemovalEvents::Buffer *TreeRemovalEvents::threadBuffer()
+{
+    if (!tls_removal_buffer) {
+        QMutexLocker lock(&removal_buffer_mutex);
+        Buffer *b = new Buffer;
+        b->records.reserve(1024);
+        mBuffers.append(b);
+        tls_removal_buffer = b;
+    }
+    return tls_removal_buffer;
+}
+
+void TreeRemovalEvents::record(const Tree *t, int reason)
+{
+    TreeRemovedOut *tree_out = Tree::mRemovalOutput && Tree::mRemovalOutput->isEnabled() ? Tree::mRemovalOutput : nullptr;
+    LandscapeRemovedOut *ls_out = Tree::mLSRemovalOutput && Tree::mLSRemovalOutput->isEnabled() ? Tree::mLSRemovalOutput : nullptr;
+    if (!tree_out && !ls_out)
+        return;
+    bool to_tree_output = tree_out && tree_out->acceptTree(t);
+    if (!to_tree_output && !(ls_out && ls_out->acceptReason(reason)))
+        return;
+
+    TreeRemovalRecord r;
+    r.year = GlobalSettings::instance()->currentYear();
+    r.ru_index = t->ru()->index();
+    r.ru_id = t->ru()->id();
+    r.species = t->species();
+    r.tree_id = t->id();
+    r.reason = reason;
+    r.age = t->age();
+    r.flags = t->flags();
+    r.to_tree_output = to_tree_output;
+    r.x = t->position().x();
+    r.y = t->position().y();
+    r.dbh = t->dbh();
+    r.height = t->height();
+    r.basal_area = t->basalArea();
+    r.volume = t->volume();
+    r.leaf_area = t->leafArea();
+    r.foliage_mass = t->mFoliageMass;
+    r.stem_mass = t->mStemMass;
+    r.branch_mass = t->mBranchMass;
+    r.fineroot_mass = t->mFineRootMass;
+    r.coarseroot_mass = t->mCoarseRootMass;
+    r.npp_reserve = t->mNPPReserve;
+    r.lri = t->lightResourceIndex();
+    r.light_response = t->mLightResponse;
+    r.stress_index = t->mStressIndex;
+
+    threadBuffer()->records.push_back(r);
+}
+
+static bool removalRecordLess(const TreeRemovalRecord &a, const TreeRemovalRecord &b)
+{
+    if (a.year != b.year) return a.year < b.year;
+    if (a.ru_index != b.ru_index) return a.ru_index < b.ru_index;
+    return a.tree_id < b.tree_id;
+}
+
+void TreeRemovalEvents::dispatch()
+{
+    QVector<TreeRemovalRecord> all;
+    {
+        QMutexLocker lock(&removal_buffer_mutex);
+        int n = 0;
+        for (Buffer *b : mBuffers)
+            n += b->records.size();
+        if (n==0)
+            return;
+        all.reserve(n);
+        for (Buffer *b : mBuffers) {
+            all += b->records;
+            b->records.clear();
+        }
+    }
+    std::sort(all.begin(), all.end(), removalRecordLess);
+
+    TreeRemovedOut *tree_out = Tree::mRemovalOutput && Tree::mRemovalOutput->isEnabled() ? Tree::mRemovalOutput : nullptr;
+    LandscapeRemovedOut *ls_out = Tree::mLSRemovalOutput && Tree::mLSRemovalOutput->isEnabled() ? Tree::mLSRemovalOutput : nullptr;
+    for (const TreeRemovalRecord &r : all) {
+        if (tree_out && r.to_tree_output)
+            tree_out->writeRecord(r);
+        if (ls_out)
+            ls_out->addRecord(r);
+    }
+}
+
+void TreeRemovalEvents::clear()
+{
+    QMutexLocker lock(&removal_buffer_mutex);
+    for (Buffer *b : mBuffers)
+        b->records.clear();
+}
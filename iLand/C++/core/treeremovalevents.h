@@ -0,0 +1,71 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef TREEREMOVALEVENTS_H
+#define TREEREMOVALEVENTS_H
+#include <QtCore/QVector>
+#include <QtCore/QList>
+
+class Tree;
+class Species;
+
+/// compact record of a removed tree (a copy of the state of the tree at the time of removal)
+struct TreeRemovalRecord {
+    int year;
+    int ru_index;
+    int ru_id;
+    const Species *species;
+    int tree_id;
+    int reason; ///< Tree::TreeRemovalType
+    int age;
+    int flags;
+    bool to_tree_output; ///< passed the filter of the 'treeremoved' output
+    double x, y; ///< position (m)
+    float dbh, height;
+    double basal_area, volume;
+    double leaf_area;
+    float foliage_mass, stem_mass, branch_mass, fineroot_mass, coarseroot_mass, npp_reserve;
+    float lri, light_response, stress_index;
+};
+
+/** TreeRemovalEvents collects the removals of trees for the removal outputs ('treeremoved', 'landscape_removed').
+  @ingroup core
+  Trees are removed from many threads (mortality, disturbances, harvests). A removal is recorded as a TreeRemovalRecord
+  in a append-only buffer of the current thread (no locks). dispatch() is called at phase barriers (no worker
+  threads active) and passes the records sorted by year, resource unit and tree id (i.e. in a deterministic order,
+  independent from the number of threads) to the outputs.
+  */
+class TreeRemovalEvents
+{
+public:
+    /// record the removal of 't' (called from Tree::notifyTreeRemoved()); thread safe
+    static void record(const Tree *t, int reason);
+    /// pass all recorded removals to the outputs (call only when no worker threads are active)
+    static void dispatch();
+    /// discard all recorded removals
+    static void clear();
+private:
+    struct Buffer {
+        QVector<TreeRemovalRecord> records;
+    };
+    static Buffer *threadBuffer();
+    static QList<Buffer*> mBuffers;
+};
+
+#endif // TREEREMOVALEVENTS_H
@@ -26,6 +26,7 @@
 #include "debugtimer.h"
 #include "modules.h"
 #include "permafrost.h"
+#include "environment.h"
 
 /** @class WaterCycle
   @ingroup core
@@ -66,16 +67,16 @@ WaterCycle::~WaterCycle()
         delete mPermafrost;
 }
 
-void WaterCycle::setup(const ResourceUnit *ru)
+void WaterCycle::setup(const ResourceUnit *ru, const SiteParameters &site)
 {
     mRU = ru;
     // get values...
     mFieldCapacity = 0.; // on top
     const XmlHelper &xml=GlobalSettings::instance()->settings();
-    mSoilDepth = xml.valueDouble("model.site.soilDepth", 0.) * 10; // convert from cm to mm
-    double pct_sand = xml.valueDouble("model.site.pctSand");
-    double pct_silt = xml.valueDouble("model.site.pctSilt");
-    double pct_clay = xml.valueDouble("model.site.pctClay");
+    mSoilDepth = site.soilDepth * 10; // convert from cm to mm
+    double pct_sand = site.pctSand;
+    double pct_silt = site.pctSilt;
+    double pct_clay = site.pctClay;
     if (fabs(100. - (pct_sand + pct_silt + pct_clay)) > 0.01)
         throw IException(QString("Setup Watercycle: soil composition percentages do not sum up to 100. Sand: %1, Silt: %2 Clay: %3").arg(pct_sand).arg(pct_silt).arg(pct_clay));
 
@@ -137,7 +138,7 @@ void WaterCycle::setup(const ResourceUnit *ru)
     // permafrost
     if (xml.valueBool("model.settings.permafrost.enabled", false)) {
         mPermafrost = new Water::Permafrost();
-        mPermafrost->setup(this);
+        mPermafrost->setup(this, site);
     }
 }
 
@@ -23,6 +23,7 @@
 
 class ResourceUnit;
 struct ClimateDay;
+struct SiteParameters;
 class WaterCycle; // forward
 class WaterOut; // forward
 /// Water contains helper classes for the water cycle calculations
@@ -107,7 +108,7 @@ class WaterCycle
 public:
     WaterCycle();
     ~WaterCycle();
-    void setup(const ResourceUnit *ru);
+    void setup(const ResourceUnit *ru, const SiteParameters &site);
     void setContent(double content, double snow_mm) { mContent = content; mSnowPack.setSnow(snow_mm); }
     // actions
     void run(); ///< run the current year
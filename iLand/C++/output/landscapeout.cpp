@@ -21,6 +21,7 @@
 #include "model.h"
 #include "resourceunit.h"
 #include "species.h"
+#include "treeremovalevents.h"
 
 LandscapeOut::LandscapeOut()
 {
@@ -125,29 +126,32 @@ LandscapeRemovedOut::LandscapeRemovedOut()
 
 }
 
-static QMutex protect_output;
-
-void LandscapeRemovedOut::execRemovedTree(const Tree *t, int reason)
+bool LandscapeRemovedOut::acceptReason(int reason) const
 {
     Tree::TreeRemovalType rem_type = static_cast<Tree::TreeRemovalType>(reason);
     if (rem_type==Tree::TreeDeath && !mIncludeDeadTrees)
-        return;
+        return false;
     if ((rem_type==Tree::TreeHarvest || rem_type==Tree::TreeSalavaged || rem_type==Tree::TreeCutDown) && !mIncludeHarvestTrees)
-        return;
+        return false;
+    return true;
+}
 
-    QMutexLocker protector(&protect_output); // output creation can come from many threads
+void LandscapeRemovedOut::addRecord(const TreeRemovalRecord &r)
+{
+    // called from the main thread only (TreeRemovalEvents::dispatch())
+    if (!acceptReason(r.reason))
+        return;
 
-    int key = dbhClass(t->dbh())*100000 +  reason*10000 + t->species()->index();
+    const float stem_mass = r.stem_mass + r.npp_reserve; // see Tree::biomassStem()
+    int key = dbhClass(r.dbh)*100000 +  r.reason*10000 + r.species->index();
     LROdata &d = mLandscapeRemoval[key];
-    d.basal_area += t->basalArea();
-    d.volume += t->volume();
-    d.carbon += (t->biomassBranch()+t->biomassCoarseRoot()+t->biomassFineRoot()+t->biomassFoliage()+t->biomassStem())*biomassCFraction;
-    d.cstem += t->biomassStem() * biomassCFraction;
-    d.cbranch += t->biomassBranch() * biomassCFraction;
-    d.cfoliage += t->biomassFoliage() * biomassCFraction;
+    d.basal_area += r.basal_area;
+    d.volume += r.volume;
+    d.carbon += (r.branch_mass+r.coarseroot_mass+r.fineroot_mass+r.foliage_mass+stem_mass)*biomassCFraction;
+    d.cstem += stem_mass * biomassCFraction;
+    d.cbranch += r.branch_mass * biomassCFraction;
+    d.cfoliage += r.foliage_mass * biomassCFraction;
     d.n++;
-
-
 }
 
 
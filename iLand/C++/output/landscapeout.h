@@ -25,6 +25,8 @@
 #include "standstatistics.h"
 #include <QMap>
 
+struct TreeRemovalRecord;
+
 /** LandscapeOut is aggregated output for the total landscape per species. All values are per hectare values. */
 class LandscapeOut : public Output
 {
@@ -43,7 +45,10 @@ class LandscapeRemovedOut : public Output
 {
 public:
     LandscapeRemovedOut();
-    void execRemovedTree(const Tree *t, int reason);
+    /// returns true if trees removed with 'reason' are included in the output
+    bool acceptReason(int reason) const;
+    /// add a removed tree to the aggregates (see TreeRemovalEvents)
+    void addRecord(const TreeRemovalRecord &r);
     virtual void exec();
     virtual void setup();
 private:
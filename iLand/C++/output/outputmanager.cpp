@@ -25,6 +25,7 @@
 #include "global.h"
 #include "outputmanager.h"
 #include "debugtimer.h"
+#include "tracer.h"
 #include <QtCore>
 
 // tree outputs
@@ -44,6 +45,7 @@
 #include "devstageout.h"
 #include "ecovizout.h"
 #include "customaggout.h"
+#include "rasterout.h"
 
 
 // on creation of the output manager
@@ -75,6 +77,7 @@ OutputManager::OutputManager()
     mOutputs.append(new SVDUniqueStateOut);
     mOutputs.append(new DevStageOut);
     mOutputs.append(new EcoVizOut);
+    mOutputs.append(new RasterOut);
 }
 
 void OutputManager::addOutput(Output *output)
@@ -171,6 +174,7 @@ bool OutputManager::execute(const QString& tableName)
 {
     DebugTimer t("OutputManager::execute()");
     t.setSilent();
+    TraceScope trace(tableName);
     Output *p = find(tableName);
     if (p) {
         if (!p->isEnabled())
@@ -0,0 +1,290 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "rasterout.h"
+#include "model.h"
+#include "resourceunit.h"
+#include "resourceunitspecies.h"
+#include "species.h"
+#include "speciesset.h"
+#include "layeredgrid.h"
+#include "debugtimer.h"
+
+#include <QtConcurrent/QtConcurrent>
+
+QList<QPair<QString, const LayeredGridBase*> > RasterOut::mLayers;
+
+RasterOut::RasterOut()
+{
+    setName("Binary raster output", "raster");
+    setDescription("Spatial variables written as binary rasters (tiled and compressed GeoTIFF, one file per variable with one page per year). " \
+                   "The output table lists the written pages. " \
+                   "!!!Parameters\n" \
+                   "'variables': comma separated list of variables, optionally with a data type (uint8, int16, int32, float32), e.g. 'lif, height:int16, share.piab'. " \
+                   "Available variables: 'lif' (2m), 'height' and 'count' (10m; dominant height, number of trees), 'basalarea', 'lai', 'saplingcover' (basal area (m2/ha), leaf area index " \
+                   "and cover of saplings >1.3m per resource unit), 'share.<species>' (share of the species on the basal area of the resource unit), " \
+                   "and the layers of modules ('<name>.<layer>', e.g. 'permafrost.maxDepthFrozen'). Cells outside of the project area are 'no data' (-9999, 255 for uint8). " \
+                   "'fileName': file name, '$' is replaced by the variable name (default: output/raster_$.tif). " \
+                   "'condition': the output is written only if the condition (variable: year) is true. " \
+                   "'compress' (default: true), 'tileSize' (default: 256), 'async' (default: true: write on a background thread), " \
+                   "'maxPending' (default: 4: max. number of pages waiting to be written).");
+    columns() << OutputColumn::year()
+              << OutputColumn("variable", "name of the variable", OutString)
+              << OutputColumn("filename", "file name of the raster", OutString)
+              << OutputColumn("page", "index of the page (image) in the file (0-based)", OutInteger)
+              << OutputColumn("width", "number of columns", OutInteger)
+              << OutputColumn("height", "number of rows", OutInteger)
+              << OutputColumn("cellsize", "cell size (m)", OutDouble);
+    mTileSize = 256;
+    mCompress = true;
+    mAsync = true;
+    mMaxPending = 4;
+    mWriterPool.setMaxThreadCount(1);
+}
+
+RasterOut::~RasterOut()
+{
+    waitForWriter();
+}
+
+void RasterOut::addLayers(const LayeredGridBase *layers, const QString &name)
+{
+    // a new object with the same name replaces the previous one (e.g. after a model reset)
+    const QString layer_name = QString(name).remove(' ');
+    removeLayers(layers);
+    for (int i=mLayers.size()-1; i>=0; --i)
+        if (mLayers[i].first == layer_name)
+            mLayers.removeAt(i);
+    mLayers.append(qMakePair(layer_name, layers));
+}
+
+void RasterOut::removeLayers(const LayeredGridBase *layers)
+{
+    for (int i=mLayers.size()-1; i>=0; --i)
+        if (mLayers[i].second == layers)
+            mLayers.removeAt(i);
+}
+
+void RasterOut::setup()
+{
+    close();
+    mVariables.clear();
+    mCondition.setExpression(settings().value(".condition", ""));
+    mFilePattern = settings().value(".fileName", "output/raster_$.tif");
+    mTileSize = settings().valueInt(".tileSize", 256);
+    mCompress = settings().valueBool(".compress", true);
+    mAsync = settings().valueBool(".async", true);
+    mMaxPending = qMax(settings().valueInt(".maxPending", 4), 1);
+    const QStringList defs = settings().value(".variables", "").split(',', Qt::SkipEmptyParts);
+    foreach(const QString &def, defs)
+        mVariables.append(parseVariable(def.trimmed()));
+}
+
+RasterOut::Variable RasterOut::parseVariable(const QString &definition) const
+{
+    Variable var;
+    const QStringList parts = definition.split(':');
+    var.name = parts[0].trimmed();
+    var.species = nullptr;
+    var.pages = 0;
+    var.type = RasterWriter::Float32;
+    if (var.name=="lif") var.source = LIF;
+    else if (var.name=="height") var.source = Height;
+    else if (var.name=="count") { var.source = TreeCount; var.type = RasterWriter::Int16; }
+    else if (var.name=="basalarea") var.source = BasalArea;
+    else if (var.name=="lai") var.source = LAI;
+    else if (var.name=="saplingcover") var.source = SaplingCover;
+    else if (var.name.startsWith("share.")) {
+        var.source = SpeciesShare;
+        var.species = GlobalSettings::instance()->model()->speciesSet()->species(var.name.mid(6));
+        if (!var.species)
+            throw IException(QString("Raster output: invalid species in variable '%1'.").arg(var.name));
+    } else if (var.name.contains('.')) {
+        // layers are resolved when the output is written (modules may register later)
+        var.source = Layer;
+        var.layerName = var.name;
+    } else {
+        throw IException(QString("Raster output: invalid variable '%1'.").arg(var.name));
+    }
+    if (parts.size()>1)
+        var.type = RasterWriter::typeFromString(parts[1].trimmed());
+    return var;
+}
+
+// copy the values of a grid (northernmost row first); 'value' returns the value of a cell (or no-data)
+// (std::vector: the data of large grids can exceed 2GB)
+template <typename F>
+static QSharedPointer<std::vector<char> > copyGrid(const int size_x, const int size_y, const RasterWriter::DataType type, F value)
+{
+    const int vsize = RasterWriter::typeSize(type);
+    QSharedPointer<std::vector<char> > data(new std::vector<char>(static_cast<size_t>(size_x)*size_y*vsize));
+    char *p = data->data();
+    for (int y=size_y-1; y>=0; --y)
+        for (int x=0; x<size_x; ++x, p+=vsize)
+            RasterWriter::setValue(p, type, value(x, y));
+    return data;
+}
+
+QSharedPointer<std::vector<char> > RasterOut::snapshot(const Variable &var, int &rWidth, int &rHeight, QRectF &rRect) const
+{
+    Model *model = GlobalSettings::instance()->model();
+    const double no_data = var.type==RasterWriter::UInt8 ? 255. : -9999.;
+    const HeightGrid *hg = model->heightGrid();
+    const Grid<ResourceUnit*> &rg = model->RUgrid();
+    switch (var.source) {
+    case LIF: {
+        const FloatGrid *lif = model->grid();
+        rWidth = lif->sizeX(); rHeight = lif->sizeY(); rRect = lif->metricRect();
+        return copyGrid(rWidth, rHeight, var.type, [&](int x, int y) {
+            return hg->constValueAtIndex(x/cPxPerHeight, y/cPxPerHeight).isValid() ? static_cast<double>(lif->constValueAtIndex(x, y)) : no_data; });
+    }
+    case Height:
+    case TreeCount: {
+        const bool height = var.source==Height;
+        rWidth = hg->sizeX(); rHeight = hg->sizeY(); rRect = hg->metricRect();
+        return copyGrid(rWidth, rHeight, var.type, [&](int x, int y) {
+            const HeightGridValue &v = hg->constValueAtIndex(x, y);
+            if (!v.isValid()) return no_data;
+            return height ? static_cast<double>(v.height) : static_cast<double>(v.count()); });
+    }
+    case BasalArea:
+    case LAI:
+    case SaplingCover:
+    case SpeciesShare: {
+        rWidth = rg.sizeX(); rHeight = rg.sizeY(); rRect = rg.metricRect();
+        const Source src = var.source;
+        const int species_index = var.species ? var.species->index() : -1;
+        return copyGrid(rWidth, rHeight, var.type, [&](int x, int y) {
+            const ResourceUnit *ru = rg.constValueAtIndex(x, y);
+            if (!ru) return no_data;
+            switch (src) {
+            case BasalArea: return ru->statistics().basalArea();
+            case LAI: return ru->leafAreaIndex();
+            case SaplingCover: return ru->saplingCoveredArea(false) / cRUArea;
+            default: {
+                const double total = ru->statistics().basalArea();
+                return total>0. ? ru->resourceUnitSpecies(species_index)->statistics().basalArea() / total : 0.;
+            }
+            }
+        });
+    }
+    case Layer: {
+        for (int i=0;i<mLayers.size();++i) {
+            const QString prefix = mLayers[i].first + ".";
+            if (!var.layerName.startsWith(prefix))
+                continue;
+            LayeredGridBase *layers = const_cast<LayeredGridBase*>(mLayers[i].second);
+            const int index = layers->indexOf(var.layerName.mid(prefix.length()));
+            if (index<0)
+                break;
+            rWidth = layers->sizeX(); rHeight = layers->sizeY(); rRect = layers->metricRect();
+            return copyGrid(rWidth, rHeight, var.type, [&](int x, int y) { return layers->value(x, y, index); });
+        }
+        QStringList available;
+        for (int i=0;i<mLayers.size();++i)
+            available << mLayers[i].first + ": " + const_cast<LayeredGridBase*>(mLayers[i].second)->layerNames().join(", ");
+        throw IException(QString("Raster output: the layer '%1' is not available. Available layers: %2").arg(var.layerName, available.join("; ")));
+    }
+    }
+    return QSharedPointer<std::vector<char> >();
+}
+
+void RasterOut::exec()
+{
+    checkErrors();
+    if (!mCondition.isEmpty())
+        if (!mCondition.calculateBool(GlobalSettings::instance()->currentYear()))
+            return;
+    DebugTimer t("RasterOut::exec()");
+
+    for (int i=0;i<mVariables.size();++i) {
+        Variable &var = mVariables[i];
+        int width=0, height=0;
+        QRectF rect;
+        QSharedPointer<std::vector<char> > data = snapshot(var, width, height, rect);
+        const double cellsize = rect.width() / width;
+        if (!var.writer) {
+            // create the file with the first page: upper left corner in world coordinates
+            Vector3D world;
+            modelToWorld(Vector3D(rect.left(), rect.bottom(), 0.), world);
+            QString file_name = mFilePattern;
+            file_name.replace("$", var.name);
+            file_name = GlobalSettings::instance()->path(file_name);
+            var.writer = QSharedPointer<RasterWriter>(new RasterWriter());
+            var.pages = 0;
+            var.writer->open(file_name, var.type, width, height, world.x(), world.y(), cellsize,
+                             var.type==RasterWriter::UInt8 ? 255. : -9999., mTileSize, mCompress);
+        }
+        *this << currentYear() << var.name << var.writer->fileName() << var.pages++
+              << width << height << cellsize;
+        writeRow();
+
+        const QString description = QString("iLand %1, year=%2").arg(var.name).arg(currentYear());
+        if (!mAsync) {
+            var.writer->writePage(data->data(), description);
+            continue;
+        }
+        // limit the memory used by the copies: wait if too many pages are queued
+        if (mPending.loadAcquire() >= mMaxPending)
+            waitForWriter();
+        checkErrors();
+        mPending.ref();
+        QSharedPointer<RasterWriter> writer = var.writer;
+        QtConcurrent::run(&mWriterPool, [this, writer, data, description]() {
+            try {
+                writer->writePage(data->data(), description);
+            } catch (const IException &e) {
+                QMutexLocker lock(&mErrorLock);
+                if (mError.isEmpty())
+                    mError = e.message();
+            }
+            mPending.deref();
+        });
+    }
+}
+
+void RasterOut::waitForWriter()
+{
+    mWriterPool.waitForDone();
+}
+
+void RasterOut::checkErrors()
+{
+    QMutexLocker lock(&mErrorLock);
+    if (!mError.isEmpty()) {
+        QString error = mError;
+        mError.clear();
+        throw IException(QString("Raster output: %1").arg(error));
+    }
+}
+
+void RasterOut::close()
+{
+    waitForWriter();
+    for (int i=0;i<mVariables.size();++i)
+        mVariables[i].writer.clear(); // closes the file
+    {
+        QMutexLocker lock(&mErrorLock);
+        if (!mError.isEmpty()) {
+            qWarning() << "Raster output: error while writing:" << mError;
+            mError.clear();
+        }
+    }
+    Output::close();
+}
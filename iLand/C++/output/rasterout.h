@@ -0,0 +1,81 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef RASTEROUT_H
+#define RASTEROUT_H
+
+#include "output.h"
+#include "expression.h"
+#include "rasterwriter.h"
+
+#include <QtCore/QThreadPool>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QMutex>
+#include <vector>
+
+class LayeredGridBase;
+class Species;
+
+/** RasterOut writes spatial variables (LIF, height, resource unit level variables, layers of modules) as binary rasters.
+  Each variable is written to a separate (Big)GeoTIFF file (see RasterWriter), with one page per year.
+  The values are copied on the main thread; compression and writing run on a background thread.
+  */
+class RasterOut : public Output
+{
+public:
+    RasterOut();
+    ~RasterOut();
+    virtual void exec();
+    virtual void setup();
+    virtual void close(); ///< wait for pending writes and close all files
+
+    /// register the layers of a LayeredGrid (e.g. from a module) as source for raster output (variable: "<name>.<layer>")
+    static void addLayers(const LayeredGridBase *layers, const QString &name);
+    static void removeLayers(const LayeredGridBase *layers);
+private:
+    enum Source { LIF, Height, TreeCount, BasalArea, LAI, SpeciesShare, SaplingCover, Layer };
+    struct Variable {
+        QString name;
+        Source source;
+        RasterWriter::DataType type;
+        const Species *species; ///< for SpeciesShare
+        QString layerName; ///< for Layer: "<name>.<layer>"
+        QSharedPointer<RasterWriter> writer;
+        int pages; ///< number of pages (years) queued for the file
+    };
+    Variable parseVariable(const QString &definition) const;
+    /// copy the current values of 'var' (converted to the data type) and the geometry of the grid
+    QSharedPointer<std::vector<char> > snapshot(const Variable &var, int &rWidth, int &rHeight, QRectF &rRect) const;
+    void waitForWriter(); ///< wait for all pending writes
+    void checkErrors(); ///< throw an exception if a background write failed
+    QList<Variable> mVariables;
+    Expression mCondition;
+    QString mFilePattern;
+    int mTileSize;
+    bool mCompress;
+    bool mAsync;
+    int mMaxPending; ///< max. number of queued pages (memory limit for the copies)
+    QThreadPool mWriterPool; ///< single thread that writes the files (pages are written in order)
+    QAtomicInt mPending; ///< number of queued pages
+    QMutex mErrorLock;
+    QString mError; ///< error message of the writer thread
+    static QList<QPair<QString, const LayeredGridBase*> > mLayers; ///< registered layered grids
+};
+
+#endif // RASTEROUT_H
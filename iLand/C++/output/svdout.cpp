@@ -87,20 +87,6 @@ SVDStateOut::SVDStateOut()
 }
 
 
-// neighborhood analysis per resource unit
-static int svd_evals=0;
-void nc_calculateSVDNeighbors(ResourceUnit *unit)
-{
-    // evaluate immediately after state change (which sets the time to 1),
-    // and at least every 10 yrs.
-    if (GlobalSettings::instance()->currentYear()==0 ||  unit->svdStateTime() % 10 == 1)  {
-        GlobalSettings::instance()->model()->svdStates()->evaluateNeighborhood(unit);
-        svd_evals++;
-    }
-}
-
-
-
 void SVDStateOut::exec()
 {
     if (!GlobalSettings::instance()->model()->svdStates()) {
@@ -109,11 +95,10 @@ void SVDStateOut::exec()
     }
 
     SVDStates *svd = GlobalSettings::instance()->model()->svdStates();
-    // run the analysis of species composition in the neighborhood in parallel
+    // update the species composition in the neighborhood (only RUs with changed states are processed)
     { DebugTimer dt("SVDStateNeighbors");
-    int old_val=svd_evals;
-    GlobalSettings::instance()->model()->executePerResourceUnit(nc_calculateSVDNeighbors);
-    qDebug() << "SVDStateOut: evaluate neighbors. total count:" << svd_evals-old_val;
+    int n_changed = svd->updateNeighborhoods();
+    qDebug() << "SVDStateOut: update neighbors. RUs with changed states:" << n_changed;
     }
 
     bool start_year = GlobalSettings::instance()->currentYear() == 0;
@@ -24,6 +24,7 @@
 #include "resourceunit.h"
 #include "species.h"
 #include "expressionwrapper.h"
+#include "treeremovalevents.h"
 
 TreeOut::TreeOut()
 {
@@ -129,27 +130,28 @@ TreeRemovedOut::TreeRemovedOut()
 
 }
 
-static QMutex protect_output;
-void TreeRemovedOut::execRemovedTree(const Tree *t, int reason)
+bool TreeRemovedOut::acceptTree(const Tree *t) const
 {
-    if (!mFilter.isEmpty()) { // skip trees if filter is present
-        TreeWrapper tw;
-        mFilter.setModelObject(&tw);
-        tw.setTree(t);
-        if (!mFilter.executeBool())
-            return;
-    }
-    QMutexLocker protector(&protect_output); // output creation can come from many threads
-
-    *this << currentYear() << t->ru()->index() << t->ru()->id() << t->species()->id();
-    *this << t->id()  << reason;
-    *this << t->position().x() << t->position().y() << t->dbh() << t->height() << t->basalArea() << t->volume() << t->age();
-    *this << t->leafArea() << t->mFoliageMass << t->mStemMass << t->mBranchMass <<  t->mFineRootMass << t->mCoarseRootMass;
-    *this << t->lightResourceIndex() << t->mLightResponse << t->mStressIndex << t->mNPPReserve;
-    *this << t->flags();
-    singleThreadedWriteRow(); // make sure that only one thread writes to the database
-
+    if (mFilter.isEmpty())
+        return true;
+    // skip trees if filter is present (local variables and wrapper: can be called from many threads)
+    TreeWrapper tw(t);
+    double var_space[EXPRNLOCALVARS];
+    for (int i=0;i<EXPRNLOCALVARS;++i)
+        var_space[i] = 0.;
+    return mFilter.executeBool(var_space, &tw);
+}
 
+void TreeRemovedOut::writeRecord(const TreeRemovalRecord &r)
+{
+    // called from the main thread only (TreeRemovalEvents::dispatch())
+    *this << r.year << r.ru_index << r.ru_id << r.species->id();
+    *this << r.tree_id  << r.reason;
+    *this << r.x << r.y << r.dbh << r.height << r.basal_area << r.volume << r.age;
+    *this << r.leaf_area << r.foliage_mass << r.stem_mass << r.branch_mass <<  r.fineroot_mass << r.coarseroot_mass;
+    *this << r.lri << r.light_response << r.stress_index << r.npp_reserve;
+    *this << r.flags;
+    writeRow();
 }
 
 void TreeRemovedOut::exec()
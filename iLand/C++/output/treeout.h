@@ -24,6 +24,7 @@
 
 class Expression;
 class Tree;
+struct TreeRemovalRecord;
 class TreeOut: public Output
 {
 public:
@@ -38,7 +39,10 @@ class TreeRemovedOut: public Output
 {
 public:
     TreeRemovedOut();
-    void execRemovedTree(const Tree *t, int reason);
+    /// returns true if the removed tree 't' passes the filter (thread safe)
+    bool acceptTree(const Tree *t) const;
+    /// write a row for the removed tree (see TreeRemovalEvents)
+    void writeRecord(const TreeRemovalRecord &r);
     virtual void exec();
     virtual void setup();
 private:
@@ -0,0 +1,352 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "benchmark.h"
+
+#include <QtSql>
+#include <QJsonObject>
+#include <random>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "globalsettings.h"
+#include "xmlhelper.h"
+#include "model.h"
+#include "resourceunit.h"
+#include "speciesset.h"
+#include "species.h"
+#include "standloader.h"
+#include "standstatistics.h"
+#include "outputmanager.h"
+#include "tracer.h"
+#include "gridallocator.h"
+#include "treeremovalevents.h"
+
+// set (or create) a value in the project file 'xml'
+static void setSetting(XmlHelper &xml, const QString &key, const QString &value)
+{
+    if (!xml.hasNode(key))
+        xml.createNode(key);
+    xml.setNodeValue(key, value);
+}
+
+static QString boolStr(bool value) { return value ? "true" : "false"; }
+
+Benchmark::Settings Benchmark::parseArguments(const QStringList &args)
+{
+    Settings s;
+    foreach(const QString &arg, args) {
+        int pos = arg.indexOf('=');
+        if (pos<0)
+            continue;
+        QString key = arg.left(pos);
+        QString value = arg.mid(pos+1);
+        if (key=="template") s.templateProject = value;
+        else if (key=="workDir") s.workDir = value;
+        else if (key=="resourceUnits") s.resourceUnits = value.toInt();
+        else if (key=="treesPerHa") s.treesPerHa = value.toInt();
+        else if (key=="speciesCount") s.speciesCount = value.toInt();
+        else if (key=="climateYears") s.climateYears = value.toInt();
+        else if (key=="years") s.years = value.toInt();
+        else if (key=="regeneration") s.regeneration = value=="true" || value=="1";
+        else if (key=="carbonCycle") s.carbonCycle = value=="true" || value=="1";
+        else if (key=="microclimate") s.microclimate = value=="true" || value=="1";
+        else if (key=="trace") s.trace = value=="true" || value=="1";
+        else if (key=="seed") s.seed = value.toUInt();
+    }
+    return s;
+}
+
+qint64 Benchmark::peakRSS()
+{
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QByteArray line;
+        while (!(line = status.readLine()).isEmpty()) {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').first().toLongLong(); // in kB
+        }
+    }
+#endif
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)==0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        return usage.ru_maxrss; // kB
+#endif
+    }
+#endif
+    return -1;
+}
+
+/// synthetic daily weather: seasonal sine curves for temperature, radiation and vpd; random precipitation.
+void Benchmark::createClimateDatabase(const QString &fileName)
+{
+    if (QFile::exists(fileName))
+        QFile::remove(fileName);
+    {
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "benchmark_climate");
+    db.setDatabaseName(fileName);
+    if (!db.open())
+        throw IException(QString("Benchmark: cannot create climate database %1: %2").arg(fileName, db.lastError().text()));
+    QSqlQuery q(db);
+    if (!q.exec("create table climate (year integer, month integer, day integer, min_temp real, max_temp real, prec real, rad real, vpd real)"))
+        throw IException(QString("Benchmark: error creating climate table: %1").arg(q.lastError().text()));
+
+    std::mt19937 rng(mSettings.seed);
+    std::uniform_real_distribution<double> uni(0., 1.);
+    std::normal_distribution<double> noise(0., 2.);
+    std::exponential_distribution<double> rain(1./6.); // mean 6mm on days with rain
+    db.transaction();
+    q.prepare("insert into climate (year, month, day, min_temp, max_temp, prec, rad, vpd) values (?,?,?,?,?,?,?,?)");
+    for (int y=0; y<mSettings.climateYears; ++y) {
+        QDate date(2000+y, 1, 1);
+        int days = date.daysInYear();
+        for (int d=0; d<days; ++d, date=date.addDays(1)) {
+            double season = sin(2.*M_PI*(d - 110) / days); // -1 (winter) .. 1 (summer)
+            double t_min = 2. + 10.*season + noise(rng);
+            double t_max = t_min + 8. + 3.*season + std::fabs(noise(rng));
+            double prec = uni(rng) < 0.4 ? rain(rng) : 0.;
+            double rad = std::max(1., 14. + 11.*season + noise(rng)); // MJ/m2/day
+            double vpd = std::max(0.05, 0.6 + 0.5*season + 0.05*noise(rng)); // kPa
+            q.addBindValue(date.year());
+            q.addBindValue(date.month());
+            q.addBindValue(date.day());
+            q.addBindValue(t_min);
+            q.addBindValue(t_max);
+            q.addBindValue(prec);
+            q.addBindValue(rad);
+            q.addBindValue(vpd);
+            if (!q.exec())
+                throw IException(QString("Benchmark: error writing climate data: %1").arg(q.lastError().text()));
+        }
+    }
+    db.commit();
+    db.close();
+    }
+    QSqlDatabase::removeDatabase("benchmark_climate");
+}
+
+/// create a copy of the template project with the landscape, climate, initialization and module settings
+/// of the benchmark, and load the copy as the current project.
+void Benchmark::setupProject()
+{
+    if (mSettings.templateProject.isEmpty())
+        throw IException("Benchmark: no template project file (template=...) specified.");
+    GlobalSettings *g = GlobalSettings::instance();
+    // load the template to resolve the folders of the project
+    g->loadProjectFile(mSettings.templateProject);
+    if (mSettings.workDir.isEmpty())
+        mSettings.workDir = g->path("", "temp");
+    QDir work_dir(mSettings.workDir);
+    if (!work_dir.exists())
+        work_dir.mkpath(".");
+
+    XmlHelper project(mSettings.templateProject);
+    // the copy is stored in the work folder: relative paths are still resolved relative to the template
+    setSetting(project, "system.path.home", QDir(g->path("", "home")).absolutePath());
+
+    // landscape: a (close to) square block of resource units
+    int nx = std::max(static_cast<int>(ceil(sqrt(static_cast<double>(mSettings.resourceUnits)))), 1);
+    int ny = std::max((mSettings.resourceUnits + nx - 1) / nx, 1);
+    setSetting(project, "model.world.width", QString::number(nx*cRUSize));
+    setSetting(project, "model.world.height", QString::number(ny*cRUSize));
+    setSetting(project, "model.world.resourceUnitsAsGrid", "true");
+    setSetting(project, "model.world.standGrid.enabled", "false");
+    setSetting(project, "model.world.areaMask.enabled", "false");
+    setSetting(project, "model.world.environmentEnabled", "false");
+    setSetting(project, "model.world.DEM", "");
+
+    // climate
+    QString climate_file = work_dir.absoluteFilePath("benchmark_climate.sqlite");
+    createClimateDatabase(climate_file);
+    setSetting(project, "system.database.climate", climate_file);
+    setSetting(project, "model.climate.tableName", "climate");
+    setSetting(project, "model.climate.filter", "");
+    setSetting(project, "model.climate.batchYears", QString::number(mSettings.climateYears));
+    setSetting(project, "model.climate.randomSamplingEnabled", "false");
+    setSetting(project, "model.climate.microclimate.enabled", boolStr(mSettings.microclimate));
+
+    // no trees from files (trees are created in createTrees())
+    setSetting(project, "model.initialization.mode", "unit");
+    setSetting(project, "model.initialization.file", "");
+    setSetting(project, "model.initialization.heightGrid.enabled", "false");
+
+    // modules
+    setSetting(project, "model.settings.regenerationEnabled", boolStr(mSettings.regeneration));
+    setSetting(project, "model.settings.carbonCycleEnabled", boolStr(mSettings.carbonCycle));
+    setSetting(project, "model.management.enabled", "false");
+    setSetting(project, "model.management.abeEnabled", "false");
+    setSetting(project, "modules.bite.enabled", "false");
+    setSetting(project, "system.javascript.fileName", "");
+
+    // system
+    setSetting(project, "system.settings.randomSeed", QString::number(mSettings.seed));
+    setSetting(project, "system.settings.debugOutputAutoSave", "false");
+    setSetting(project, "system.database.out", work_dir.absoluteFilePath("benchmark_output.sqlite"));
+    setSetting(project, "system.settings.trace.enabled", boolStr(mSettings.trace));
+    setSetting(project, "system.settings.trace.perResourceUnit", boolStr(mSettings.trace));
+    setSetting(project, "system.settings.trace.file", work_dir.absoluteFilePath("benchmark_trace.json"));
+
+    const QString project_file = work_dir.absoluteFilePath("benchmark_project.xml");
+    project.saveToFile(project_file);
+    if (!QFile::exists(project_file))
+        throw IException(QString("Benchmark: cannot write the project file %1.").arg(project_file));
+    g->loadProjectFile(project_file);
+}
+
+/// populate all resource units with random trees of the first n species.
+int Benchmark::createTrees(Model *model)
+{
+    QList<Species*> species = model->speciesSet()->activeSpecies();
+    int n_species = std::min(mSettings.speciesCount, static_cast<int>(species.size()));
+    if (n_species<1)
+        throw IException("Benchmark: no active species in the species database of the template project.");
+
+    std::mt19937 rng(mSettings.seed + 1);
+    std::uniform_real_distribution<double> uni(0., 1.);
+    QStringList content;
+    content.reserve(model->ruList().size() * mSettings.treesPerHa + 1);
+    content << "x;y;dbh;height;species";
+    int n=0;
+    foreach(const ResourceUnit *ru, model->ruList()) {
+        const QRectF &box = ru->boundingBox();
+        for (int i=0; i<mSettings.treesPerHa; ++i) {
+            double x = box.left() + uni(rng)*box.width();
+            double y = box.top() + uni(rng)*box.height();
+            double dbh = 8. + 37.*uni(rng); // cm
+            double height = dbh * (0.7 + 0.3*uni(rng)); // hd-ratio 70-100 (m)
+            content << QString("%1;%2;%3;%4;%5").arg(x).arg(y).arg(dbh).arg(height).arg(species[(n++) % n_species]->id());
+        }
+    }
+    StandLoader loader(model);
+    int loaded = loader.loadSingleTreeList(content, nullptr, -1, "benchmark");
+
+    // light pattern and stand statistics for the new trees
+    model->onlyApplyLightPattern();
+    model->createStandStatistics();
+    return loaded;
+}
+
+QJsonObject Benchmark::run()
+{
+    QElapsedTimer setup_timer;
+    setup_timer.start();
+    setupProject();
+
+    GlobalSettings *g = GlobalSettings::instance();
+    QScopedPointer<Model> model(new Model());
+    model->loadProject();
+    if (!model->isSetup())
+        throw IException("Benchmark: error during the setup of the model (check the log).");
+    g->setCurrentYear(1);
+    model->beforeRun();
+    int n_trees = createTrees(model.data());
+    double t_setup = setup_timer.elapsed();
+
+    // run the simulation
+    double t_apply=0., t_read=0., t_grow=0., t_seed=0., t_est=0., t_sap=0., t_carbon=0., t_output=0., t_mgmt=0.;
+    double tree_years=0.;
+    QElapsedTimer run_timer;
+    run_timer.start();
+    for (int year=0; year<mSettings.years; ++year) {
+        model->runYear();
+        const SystemStatistics *s = g->systemStatistics();
+        tree_years += s->treeCount;
+        t_apply += s->tApplyPattern; t_read += s->tReadPattern; t_grow += s->tTreeGrowth;
+        t_seed += s->tSeedDistribution; t_est += s->tEstablishment; t_sap += s->tSapling;
+        t_carbon += s->tCarbonCycle; t_output += s->tWriteOutput; t_mgmt += s->tManagement;
+    }
+    double t_run = run_timer.elapsed();
+    QHash<QString, double> traced;
+    if (mSettings.trace) {
+        Tracer::flush();
+        traced = Tracer::totals();
+    }
+    Tracer::finalize();
+
+    int n_ru = model->ruList().size();
+    // allocated and resident memory per grid (see GridAllocator)
+    QJsonObject grid_memory;
+    foreach(const GridAllocator::Usage &u, GridAllocator::usage()) {
+        QJsonObject m;
+        m["blocks"] = u.blocks;
+        m["allocatedkB"] = u.bytes / 1024;
+        m["residentkB"] = u.residentBytes<0 ? -1 : u.residentBytes / 1024;
+        grid_memory[u.name] = m;
+    }
+    TreeRemovalEvents::dispatch();
+    g->outputManager()->save();
+    model->afterStop();
+    model.reset();
+
+    QJsonObject setup;
+    setup["template"] = mSettings.templateProject;
+    setup["resourceUnits"] = n_ru;
+    setup["treesPerHa"] = mSettings.treesPerHa;
+    setup["initialTrees"] = n_trees;
+    setup["speciesCount"] = mSettings.speciesCount;
+    setup["climateYears"] = mSettings.climateYears;
+    setup["years"] = mSettings.years;
+    setup["regeneration"] = mSettings.regeneration;
+    setup["carbonCycle"] = mSettings.carbonCycle;
+    setup["microclimate"] = mSettings.microclimate;
+    setup["trace"] = mSettings.trace;
+    setup["seed"] = static_cast<qint64>(mSettings.seed);
+    setup["threads"] = QThread::idealThreadCount();
+
+    // wall clock times (ms, sum over all years)
+    QJsonObject phases;
+    phases["applyPattern"] = t_apply;
+    phases["readPattern"] = t_read;
+    phases["grow"] = t_grow;
+    phases["regeneration"] = t_seed + t_est + t_sap;
+    phases["seedDispersal"] = t_seed;
+    phases["establishment"] = t_est;
+    phases["saplingGrowth"] = t_sap;
+    phases["carbonCycle"] = t_carbon;
+    phases["management"] = t_mgmt;
+    phases["outputs"] = t_output;
+
+    QJsonObject result;
+    result["setup"] = setup;
+    result["setupTimeMs"] = t_setup;
+    result["runTimeMs"] = t_run;
+    result["phasesMs"] = phases;
+    if (mSettings.trace) {
+        // traced phases (ms) and cpu times on resource unit level (ms, summed over all threads)
+        QJsonObject traced_phases;
+        traced_phases["yearEnd"] = traced.value("yearEnd");
+        traced_phases["modules"] = traced.value("modules");
+        traced_phases["water"] = traced.value("waterRU");
+        traced_phases["production"] = traced.value("productionRU");
+        traced_phases["grow"] = traced.value("growRU");
+        result["tracedCpuMs"] = traced_phases;
+    }
+    result["treeYears"] = tree_years;
+    result["treesPerSecond"] = t_run>0. ? tree_years / (t_run / 1000.) : 0.;
+    result["peakRSSkB"] = peakRSS();
+    result["gridMemory"] = grid_memory;
+    return result;
+}
@@ -0,0 +1,81 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include <QtCore>
+
+class Model;
+
+/** Benchmark runs the core year loop on a synthetic landscape and reports timings as JSON.
+  @ingroup tools
+  The landscape is created programmatically: the benchmark starts from a "template" project file
+  (which provides the species parameters, LIP files, site and output settings), replaces the
+  extent of the world (number of resource units), generates a synthetic climate database and
+  populates the resource units with random trees of the first 'speciesCount' active species
+  (via the StandLoader). All random numbers of the synthetic setup depend only on 'seed'.
+
+  The template is not modified: the benchmark settings are applied to a copy of the project file
+  (saved to 'workDir') which is then loaded as the project.
+
+  The result contains per-phase timings (ms, sum over all years; from the SystemStatistics),
+  the throughput (trees processed per second) and the peak resident memory. With 'trace=true' the
+  Tracer records also resource unit level scopes (cpu times of water cycle, production, growth);
+  note that tracing itself adds overhead to the timings.
+  The front-ends run the benchmark with ModelController::runBenchmark() (no model must be loaded):
+  @code
+  QString json = controller.runBenchmark("template=project.xml resourceUnits=400 years=20");
+  @endcode
+  */
+class Benchmark
+{
+public:
+    struct Settings {
+        Settings(): resourceUnits(100), treesPerHa(500), speciesCount(3), climateYears(30), years(10),
+            regeneration(true), carbonCycle(true), microclimate(false), trace(false), seed(1) {}
+        QString templateProject; ///< project file providing species, LIP and site settings
+        QString workDir; ///< folder for generated files (default: temp folder of the template)
+        int resourceUnits; ///< number of resource units (arranged as a (close to) square landscape)
+        int treesPerHa; ///< initial tree density
+        int speciesCount; ///< number of species (the first n active species)
+        int climateYears; ///< length of the synthetic climate series (years)
+        int years; ///< number of simulated years
+        bool regeneration; ///< enable regeneration (seed dispersal, establishment, sapling growth)
+        bool carbonCycle; ///< enable soil and snag dynamics
+        bool microclimate; ///< enable the microclimate module
+        bool trace; ///< enable the Tracer (with resource unit level scopes) and report traced cpu times
+        unsigned int seed; ///< seed for the synthetic landscape (and the model)
+    };
+    Benchmark() {}
+    Benchmark(const Settings &settings): mSettings(settings) {}
+    /// parse settings from a list of key=value pairs (keys as in Settings)
+    static Settings parseArguments(const QStringList &args);
+    /// run the benchmark and return the result as JSON. Throws IException on errors.
+    QJsonObject run();
+
+    /// peak resident set size of the process (kB), or -1 if not available
+    static qint64 peakRSS();
+private:
+    void createClimateDatabase(const QString &fileName);
+    void setupProject(); ///< create and load the project file for the benchmark
+    int createTrees(Model *model);
+    Settings mSettings;
+};
+
+#endif // BENCHMARK_H
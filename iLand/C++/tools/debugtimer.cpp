@@ -44,6 +44,16 @@ void DebugTimer::sampleClock(int ms)
     qDebug() << ms << "ms -> ticks/msec" << m_tick_p_s << "ticks elapsed" << tickselapsed;
 
 }*/
+
+// timings of a single thread (timers are also used in worker threads); the sums of all threads
+// are added to mTimingList by mergeTimings()
+struct DebugTimerPartial {
+    QHash<QString, double> timings;
+};
+static QMutex timer_mutex; // only used when a thread creates its partial sums, and for merging
+static QList<DebugTimerPartial*> timer_partials;
+static thread_local DebugTimerPartial *tls_timer_partial = nullptr;
+
 DebugTimer::~DebugTimer()
 {
     --m_count;
@@ -59,13 +69,17 @@ DebugTimer::~DebugTimer()
     }
 
     double t = elapsed();
-    mTimingList[m_caption]+=t;
+    if (!tls_timer_partial) {
+        QMutexLocker locker(&timer_mutex);
+        tls_timer_partial = new DebugTimerPartial();
+        timer_partials.append(tls_timer_partial);
+    }
+    tls_timer_partial->timings[m_caption]+=t;
     // show message if timer is not set to silent, and if time > 100ms (if timer is set to hideShort (which is the default))
     if (!m_silent && (!m_hideShort || t>100.))
         showElapsed();
 }
 
-QMutex timer_mutex;
 DebugTimer::DebugTimer(const QString &caption, bool silent)
 {
     ++m_count;
@@ -77,17 +91,27 @@ DebugTimer::DebugTimer(const QString &caption, bool silent)
     m_caption = caption;
     m_silent=silent;
     m_hideShort=true;
-    if (!mTimingList.contains(caption)) {
-        QMutexLocker locker(&timer_mutex);
-        if (!mTimingList.contains(caption))
-            mTimingList[caption]=0.;
-    }
     start();
 
 }
 
+void DebugTimer::mergeTimings()
+{
+    QMutexLocker locker(&timer_mutex);
+    foreach(DebugTimerPartial *p, timer_partials) {
+        for (QHash<QString, double>::const_iterator i = p->timings.constBegin(); i != p->timings.constEnd(); ++i)
+            mTimingList[i.key()] += i.value();
+        p->timings.clear();
+    }
+}
+
 void DebugTimer::clearAllTimers()
 {
+    {
+        QMutexLocker locker(&timer_mutex);
+        foreach(DebugTimerPartial *p, timer_partials)
+            p->timings.clear();
+    }
     QHash<QString, double>::iterator i = mTimingList.begin();
      while (i != mTimingList.end()) {
          i.value() = 0.;
@@ -96,6 +120,7 @@ void DebugTimer::clearAllTimers()
 }
 void DebugTimer::printAllTimers()
 {
+    mergeTimings();
     QHash<QString, double>::iterator i = mTimingList.begin();
     qWarning() << "Total timers\n================";
     double total=0.;
@@ -28,7 +28,9 @@ The class writes the elapsed time to qDebug() when either destructed, or when ex
   write a message with the time elapsed up the calling time, and the clock is reset afterwards. The name of the timer is
   set during construction. This message is printed when showElapsed() is called or durig destruction.
   Additionally, elapsed times of timers sharing the same caption are aggregated. Use clearAllTimers() to reset and printAllTimers()
-  print the sums to the debug console. "Silent" DebugOutputs (setSilent() don't print timings for each iteration, but are still
+  print the sums to the debug console. Each thread sums up the timings of its own timers (without locks), and printAllTimers()
+  merges the sums of all threads (call only if no worker threads are active).
+  "Silent" DebugOutputs (setSilent() don't print timings for each iteration, but are still
     counted in the sums. If setAsWarning() is issued, the debug messages are print as warning, thus also visible
   when debug messages are disabled.
   @code void foo() {
@@ -64,6 +66,7 @@ public:
     static void setResponsiveMode(bool mode) { m_responsive_mode = mode; }
     static bool responsiveMode()  { return m_responsive_mode; }
 private:
+    static void mergeTimings(); ///< add the timings of all threads to mTimingList
     static QHash<QString, double> mTimingList;
     static bool m_responsive_mode;
     static qint64 ms_since_epoch; // milliseconds since epoch for the first call
@@ -24,6 +24,7 @@
 #include "model.h"
 
 #include "gisgrid.h"
+#include "summedareatable.h"
 
 // from here: http://www.scratchapixel.com/lessons/3d-advanced-lessons/interpolation/bilinear-interpolation/
 template<typename T>
@@ -47,6 +48,12 @@ T bilinear(
 #endif
 }
 
+DEM::~DEM()
+{
+    if (mStats)
+        delete mStats;
+}
+
 /// loads a DEM from a ESRI style text file.
 /// internally, the DEM has always a resolution of 10m
 bool DEM::loadFromFile(const QString &fileName)
@@ -67,6 +74,12 @@ bool DEM::loadFromFile(const QString &fileName)
     aspect_grid.clear();
     slope_grid.clear();
     view_grid.clear();
+    tpi_grid.clear();
+    mTPIRadius = -1.f;
+    if (mStats) {
+        delete mStats;
+        mStats = nullptr;
+    }
 
     setup(h_grid->metricRect(),h_grid->cellsize());
 
@@ -160,28 +173,107 @@ float DEM::orientation(const QPointF &point, float &rslope_angle, float &rslope_
     }
 }
 
+/// the TPI uses all cells within a circle with 'radius' (m) around the cell at 'point'.
+/// The sum of elevations is derived from the summed area table of the DEM, i.e. the cost
+/// is O(radius) instead of O(radius^2). Note that the window includes offsets from -r to r-1 (cells).
 float DEM::topographicPositionIndex(const QPointF &point, float radius) const
 {
     int rpix = radius / cHeightSize;
     QPoint o = indexAt(point);
     double point_elevation = (*this)(o.x(), o.y());
     int n = 0;
-    double avg_elevation=0.;
-    for (int iy = std::max(0, o.y() - rpix); iy < std::min(sizeY(), o.y() + rpix); ++iy)
-        for (int ix = std::max(0, o.x() - rpix); ix < std::min(sizeX(), o.x() + rpix); ++ix) {
-            int dist = (ix - o.x())*(ix - o.x()) + (iy - o.y())*(iy - o.y());
-            if (dist <= rpix*rpix) {
-                avg_elevation += (*this)(ix, iy);
-                ++n;
-            }
-        }
+    double sum_elevation = neighborhoodStatistics()->table().diskSum(o, rpix, n, rpix-1);
     if (n>0)
-        return point_elevation - (avg_elevation / static_cast<double>(n));
+        return point_elevation - (sum_elevation / static_cast<double>(n));
     return 0.f;
 }
 
+const FloatGrid *DEM::topographicPositionIndexGrid(float radius) const
+{
+    QMutexLocker lock(&mLock);
+    if (tpi_grid.isEmpty() || mTPIRadius != radius) {
+        if (!mStats)
+            mStats = new NeighborhoodStatistics(*this);
+        int rpix = radius / cHeightSize;
+        mStats->calculate(tpi_grid, NeighborhoodStatistics::TopographicPosition, rpix);
+        mTPIRadius = radius;
+    }
+    return &tpi_grid;
+}
+
+const NeighborhoodStatistics *DEM::neighborhoodStatistics() const
+{
+    QMutexLocker lock(&mLock);
+    if (!mStats)
+        mStats = new NeighborhoodStatistics(*this);
+    return mStats;
+}
+
+// helper for the parallel calculation of slope, aspect and view grids
+struct DEMSlopeTile {
+    int y_from, y_to;
+    const DEM *dem;
+    FloatGrid *slope;
+    FloatGrid *aspect;
+    FloatGrid *view;
+};
+
+// see DEM::orientation(): the same calculation, but index based and row by row
+static void nc_slopeTile(DEMSlopeTile &tile)
+{
+    const DEM *dem = tile.dem;
+    const int nx = dem->sizeX();
+    const int ny = dem->sizeY();
+    const float cs = dem->cellsize();
+
+    // use fixed values for azimuth (315) and angle (45 deg) and calculate
+    // norm vectors
+    const float sun_x = cos(315. * M_PI/180.) * cos(45.*M_PI/180.);
+    const float sun_y = sin(315. * M_PI/180.) * cos(45.*M_PI/180.);
+    const float sun_z = sin(45.*M_PI/180.);
+
+    for (int y=tile.y_from; y<tile.y_to; ++y) {
+        const float *p = dem->begin() + y*nx;
+        float *slope = tile.slope->ptr(0, y);
+        float *aspect = tile.aspect->ptr(0, y);
+        float *view = tile.view->ptr(0, y);
+        for (int x=0; x<nx; ++x, ++p, ++slope, ++aspect, ++view) {
+            float height = 0.f;
+            *slope = 0.f; *aspect = 0.f;
+            if (x>0 && y>0 && y<ny-1) {
+                height = *p;
+                float z2 = *(p-nx);
+                float z4 = *(p-1);
+                float z6 = *(p+1);
+                float z8 = *(p+nx);
+                if (!(z2<=0. || z4<=0. || z6<=0. || z8<=0)) {
+                    float g = (-z4 + z6) / (2*cs);
+                    float h = (z2 - z8) / (2*cs);
+                    *slope = sqrt(g*g + h*h);
+                    float a = atan2(-h, -g);
+                    a = a * 180. / M_PI + 360. + 90.;
+                    *aspect = fmod(a, 360.f);
+                }
+            }
+            // calculate the view value:
+            if (height>0) {
+                float hs = atan(*slope);
+                float a_x = cos(*aspect * M_PI/180.) * cos(hs);
+                float a_y = sin(*aspect * M_PI/180.) * cos(hs);
+                float a_z = sin(hs);
+                // use the scalar product to calculate the angle, and then
+                // transform from [-1,1] to [0,1]
+                *view = (a_x*sun_x + a_y*sun_y + a_z*sun_z + 1.)/2.;
+            } else {
+                *view = 0.;
+            }
+        }
+    }
+}
+
 void DEM::createSlopeGrid() const
 {
+    QMutexLocker lock(&mLock);
     if (slope_grid.isEmpty()) {
         // setup custom grids with the same size as this DEM
         slope_grid.setup(*this);
@@ -190,33 +282,13 @@ void DEM::createSlopeGrid() const
     } else {
         return;
     }
-    float *slope = slope_grid.begin();
-    float *view = view_grid.begin();
-    float *aspect = aspect_grid.begin();
 
-    // use fixed values for azimuth (315) and angle (45 deg) and calculate
-    // norm vectors
-    float sun_x = cos(315. * M_PI/180.) * cos(45.*M_PI/180.);
-    float sun_y = sin(315. * M_PI/180.) * cos(45.*M_PI/180.);
-    float sun_z = sin(45.*M_PI/180.);
-
-    float a_x, a_y, a_z;
-    for (float *p = begin(); p!=end(); ++p, ++slope, ++view, ++aspect) {
-        QPointF pt = cellCenterPoint(indexOf(p));
-        float height = orientation(pt, *slope, *aspect);
-        // calculate the view value:
-        if (height>0) {
-            float h = atan(*slope);
-            a_x = cos(*aspect * M_PI/180.) * cos(h);
-            a_y = sin(*aspect * M_PI/180.) * cos(h);
-            a_z = sin(h);
-
-            // use the scalar product to calculate the angle, and then
-            // transform from [-1,1] to [0,1]
-            *view = (a_x*sun_x + a_y*sun_y + a_z*sun_z + 1.)/2.;
-        } else {
-            *view = 0.;
-        }
+    // process the grid in row tiles (multithreaded)
+    QVector<DEMSlopeTile> tiles;
+    QVector<QPair<int,int> > rows = NeighborhoodStatistics::rowTiles(sizeY());
+    for (int i=0;i<rows.size();++i) {
+        DEMSlopeTile t = { rows[i].first, rows[i].second, this, &slope_grid, &aspect_grid, &view_grid };
+        tiles.push_back(t);
     }
-
+    GlobalSettings::instance()->model()->threadExec().run(nc_slopeTile, tiles);
 }
@@ -20,6 +20,8 @@
 #ifndef DEM_H
 #define DEM_H
 #include "grid.h"
+
+class NeighborhoodStatistics; // forward
 /** DEM is a digital elevation model class.
   @ingroup tools
    It uses a float grid internally.
@@ -39,7 +41,8 @@
 class DEM: public FloatGrid
 {
 public:
-    DEM(const QString &fileName) { loadFromFile(fileName); }
+    DEM(const QString &fileName): mTPIRadius(-1.f), mStats(nullptr) { loadFromFile(fileName); }
+    ~DEM();
     bool loadFromFile(const QString &fileName);
     // create and fill grids for aspect/slope
     void createSlopeGrid() const;
@@ -64,12 +67,21 @@ public:
     /// TPI measures the difference between elevation at the central point
     ///  and the average elevation (z) around it within a predetermined radius (radius in m)
     float topographicPositionIndex(const QPointF &point, float radius) const;
+    /// grid with the topographic position index for all cells (see topographicPositionIndex()).
+    /// The grid is calculated (in parallel) on first access and cached for the given radius.
+    const FloatGrid *topographicPositionIndexGrid(float radius) const;
+    /// access to neighborhood statistics (summed area table) of the elevation
+    const NeighborhoodStatistics *neighborhoodStatistics() const;
 
 
 private:
     mutable FloatGrid aspect_grid;
     mutable FloatGrid slope_grid;
     mutable FloatGrid view_grid;
+    mutable FloatGrid tpi_grid;
+    mutable float mTPIRadius;
+    mutable NeighborhoodStatistics *mStats;
+    mutable QMutex mLock; ///< lock for the lazy creation of derived grids
 };
 
 #endif // DEM_H
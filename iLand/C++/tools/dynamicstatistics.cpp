@@ -0,0 +1,225 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "dynamicstatistics.h"
+
+#include "model.h"
+#include "resourceunit.h"
+#include "tree.h"
+#include "expression.h"
+#include "expressionwrapper.h"
+#include "threadrunner.h"
+
+#include <algorithm>
+#include <limits>
+
+static const QStringList aggregateNames = QStringList() << "mean" << "sum" << "min" << "max" << "p25" << "p50" << "p75" << "p5"<< "p10" << "p90" << "p95";
+
+void DynamicStatistics::parse()
+{
+    mColumns.clear();
+    mFields.clear();
+    mSlots = 0;
+    mOrderDependent = false;
+    TreeWrapper tw;
+    foreach (const QString &name, mFieldNames) {
+        // "<variable>.<aggregate>" or "[<expression>].<aggregate>"
+        const int dot = name.lastIndexOf('.');
+        const QString var = name.left(dot);
+        const QString agg = name.mid(dot+1);
+        if (dot<=0 || agg.isEmpty())
+            throw IException(QString("Invalid variable name for dynamic output:") + name);
+
+        Field field;
+        field.value = 0.;
+        field.percent = 0;
+        switch (aggregateNames.indexOf(agg)) {
+        case 0: field.aggregate = Mean; break;
+        case 1: field.aggregate = Sum; break;
+        case 2: field.aggregate = Min; break;
+        case 3: field.aggregate = Max; break;
+        case 4: field.aggregate = Percentile; field.percent = 25; break;
+        case 5: field.aggregate = Percentile; field.percent = 50; break;
+        case 6: field.aggregate = Percentile; field.percent = 75; break;
+        case 7: field.aggregate = Percentile; field.percent = 5; break;
+        case 8: field.aggregate = Percentile; field.percent = 10; break;
+        case 9: field.aggregate = Percentile; field.percent = 90; break;
+        case 10: field.aggregate = Percentile; field.percent = 95; break;
+        default: throw IException(QString("Invalid aggregate expression for dynamic output: %1\nallowed:%2")
+                                  .arg(agg).arg(aggregateNames.join(" ")));
+        }
+
+        // each variable is extracted only once (also if used by multiple fields)
+        field.column = -1;
+        for (int i=0;i<mColumns.size();++i)
+            if (mColumns[i].name == var)
+                field.column = i;
+        if (field.column<0) {
+            Column col;
+            col.name = var;
+            col.var_index = -1;
+            col.slot = -1;
+            if (var.startsWith('[') && var.endsWith(']')) {
+                col.expression = QSharedPointer<Expression>(new Expression(var.mid(1, var.length()-2)));
+                col.expression->parse(&tw);
+                col.expression->setModelObject(nullptr); // the tree is provided with each call
+                if (col.expression->isOrderDependent())
+                    mOrderDependent = true;
+            } else {
+                col.var_index = tw.variableIndex(var);
+                if (col.var_index<0)
+                    throw IException(QString("Invalid variable name for dynamic output:") + var);
+            }
+            field.column = mColumns.size();
+            mColumns.push_back(col);
+        }
+        if (field.aggregate==Percentile && mColumns[field.column].slot<0)
+            mColumns[field.column].slot = mSlots++;
+        mFields.push_back(field);
+    }
+    mParsed = true;
+}
+
+// extract the values of all columns for the trees of a resource unit (runs in parallel)
+void DynamicStatistics::extract(RUJob &job)
+{
+    const QVector<DynamicStatistics::Column> &columns = job.owner->mColumns;
+    const QVector<Tree> &trees = job.ru->constTrees();
+    const int ncol = columns.size();
+    job.n = trees.size();
+    job.sum.assign(ncol, 0.);
+    job.min.assign(ncol, std::numeric_limits<double>::max());
+    job.max.assign(ncol, -std::numeric_limits<double>::max());
+    job.values.resize(static_cast<size_t>(job.owner->mSlots) * job.n);
+    TreeWrapper tw;
+    for (int i=0;i<job.n;++i) {
+        tw.setTree(&trees[i]);
+        for (int c=0;c<ncol;++c) {
+            const Column &col = columns[c];
+            const double value = col.var_index>=0 ? tw.value(col.var_index) : col.expression->execute(nullptr, &tw);
+            job.sum[c] += value;
+            job.min[c] = std::min(job.min[c], value);
+            job.max[c] = std::max(job.max[c], value);
+            if (col.slot>=0)
+                job.values[static_cast<size_t>(col.slot)*job.n + i] = value;
+        }
+    }
+}
+
+int DynamicStatistics::percentileIndex(const int percent, const int n)
+{
+    const int perc = limit(percent, 1, 99);
+    if (perc!=50) {
+        const int d = 100 / ( perc>50 ? 100-perc : perc );
+        const int k = n / d;
+        return perc>50 ? n - k - 1 : k;
+    }
+    // median: the lower of the two middle values for an even number of values
+    return (n & 1) ? n/2 : n/2 - 1;
+}
+
+void DynamicStatistics::calculate(const Model *model)
+{
+    if (!mParsed)
+        parse();
+
+    QVector<RUJob> jobs;
+    jobs.reserve(model->ruList().size());
+    foreach (ResourceUnit *ru, model->ruList()) {
+        if (ru->constTrees().isEmpty())
+            continue;
+        RUJob job;
+        job.owner = this;
+        job.ru = ru;
+        job.n = 0;
+        jobs.push_back(job);
+    }
+    if (mOrderDependent) {
+        // incsum() restarts with each calculation
+        for (int c=0;c<mColumns.size();++c)
+            if (mColumns[c].expression)
+                mColumns[c].expression->enableIncSum();
+    }
+    // the expressions are shared by all jobs: expressions that depend on the order of evaluation
+    // (incsum() and random numbers) are executed serially (in the order of the resource units)
+    model->threadExec().run(extract, jobs, mOrderDependent);
+
+    // merge the results of the resource units (in the order of the resource units)
+    mCount = 0;
+    for (int j=0;j<jobs.size();++j)
+        mCount += jobs[j].n;
+    for (int c=0;c<mColumns.size();++c) {
+        Column &col = mColumns[c];
+        col.sum = 0.;
+        col.min = std::numeric_limits<double>::max();
+        col.max = -std::numeric_limits<double>::max();
+        col.values.clear();
+        if (col.slot>=0)
+            col.values.reserve(mCount);
+        for (int j=0;j<jobs.size();++j) {
+            const RUJob &job = jobs[j];
+            col.sum += job.sum[c];
+            col.min = std::min(col.min, job.min[c]);
+            col.max = std::max(col.max, job.max[c]);
+            if (col.slot>=0) {
+                const double *p = job.values.data() + static_cast<size_t>(col.slot)*job.n;
+                col.values.insert(col.values.end(), p, p + job.n);
+            }
+        }
+    }
+
+    for (int f=0;f<mFields.size();++f) {
+        Field &field = mFields[f];
+        const Column &col = mColumns[field.column];
+        if (mCount==0) {
+            field.value = 0.;
+            continue;
+        }
+        switch (field.aggregate) {
+        case Mean: field.value = col.sum / mCount; break;
+        case Sum: field.value = col.sum; break;
+        case Min: field.value = col.min; break;
+        case Max: field.value = col.max; break;
+        case Percentile: break; // see below
+        }
+    }
+
+    // percentiles: selection of the requested ranks (in ascending order, each selection only partitions the remaining range)
+    for (int c=0;c<mColumns.size();++c) {
+        Column &col = mColumns[c];
+        if (col.slot<0 || mCount==0)
+            continue;
+        QVector<int> ranks;
+        for (int f=0;f<mFields.size();++f)
+            if (mFields[f].column==c && mFields[f].aggregate==Percentile)
+                ranks.push_back(percentileIndex(mFields[f].percent, mCount));
+        std::sort(ranks.begin(), ranks.end());
+        std::vector<double>::iterator begin = col.values.begin();
+        for (int r=0;r<ranks.size();++r) {
+            if (r>0 && ranks[r]==ranks[r-1])
+                continue;
+            std::nth_element(begin, col.values.begin() + ranks[r], col.values.end());
+            begin = col.values.begin() + ranks[r] + 1;
+        }
+        for (int f=0;f<mFields.size();++f)
+            if (mFields[f].column==c && mFields[f].aggregate==Percentile)
+                mFields[f].value = col.values[percentileIndex(mFields[f].percent, mCount)];
+    }
+}
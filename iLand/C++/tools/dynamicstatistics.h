@@ -0,0 +1,88 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef DYNAMICSTATISTICS_H
+#define DYNAMICSTATISTICS_H
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+#include <QtCore/QSharedPointer>
+#include <vector>
+
+class Model;
+class ResourceUnit;
+class Expression;
+
+/** DynamicStatistics calculates landscape level aggregates of tree variables (the "dynamic output").
+  @ingroup tools
+  A field is "<variable>.<aggregate>", where variable is a tree variable (e.g. 'dbh') or an expression in
+  brackets (e.g. '[dbh*dbh]'), and aggregate one of: mean, sum, min, max, p5, p10, p25, p50, p75, p90, p95.
+  The field list is parsed once; calculate() extracts all variables in a single (multithreaded) pass over the
+  resource units and computes the percentiles by selection (std::nth_element) instead of sorting.
+  Expressions that depend on the order of evaluation (incsum(), rnd(), rndg()) are evaluated serially, in the
+  order of the resource units and trees.
+  The percentiles are identical to StatData::percentile().
+  */
+class DynamicStatistics
+{
+public:
+    DynamicStatistics(): mParsed(false), mOrderDependent(false), mSlots(0), mCount(0) {}
+    /// set the list of fields; the fields are parsed with the first call to calculate()
+    void setFields(const QStringList &fields) { mFieldNames = fields; mParsed = false; }
+    const QStringList &fields() const { return mFieldNames; }
+    /// calculate the aggregates for all trees of the landscape
+    void calculate(const Model *model);
+    int count() const { return mCount; } ///< number of trees of the last calculate()
+    double value(const int field_index) const { return mFields[field_index].value; } ///< value of the field with index 'field_index'
+private:
+    enum Aggregate { Mean, Sum, Min, Max, Percentile };
+    struct Column {
+        QString name;
+        int var_index; ///< index of a TreeWrapper variable (or -1)
+        QSharedPointer<Expression> expression; ///< expression (if var_index=-1)
+        int slot; ///< index of the column in the value buffer of the jobs (-1: no percentiles required)
+        double sum, min, max;
+        std::vector<double> values; ///< values of all trees (only for percentiles)
+    };
+    struct Field {
+        int column;
+        Aggregate aggregate;
+        int percent;
+        double value;
+    };
+    struct RUJob {
+        const DynamicStatistics *owner;
+        ResourceUnit *ru;
+        int n; ///< number of trees
+        std::vector<double> sum, min, max; ///< per column
+        std::vector<double> values; ///< values of the columns with percentiles: values[slot*n + i]
+    };
+    static void extract(RUJob &job);
+    void parse();
+    /// index of the value that is the 'percent' percentile of 'n' values (see StatData::percentile())
+    static int percentileIndex(const int percent, const int n);
+    QStringList mFieldNames;
+    bool mParsed;
+    bool mOrderDependent; ///< true if an expression depends on the order of evaluation (serial extraction)
+    QVector<Column> mColumns;
+    QVector<Field> mFields;
+    int mSlots; ///< number of columns that store values
+    int mCount;
+};
+
+#endif // DYNAMICSTATISTICS_H
@@ -526,6 +526,21 @@ int Expression::getFuncIndex(const QString& functionName)
     return idx;
 }
 
+bool Expression::isOrderDependent() const
+{
+    if (!m_parsed) {
+        const_cast<Expression*>(this)->parse();
+        if (!m_parsed)
+            return false;
+    }
+    for (const ExtExecListItem *exec=m_execList; exec->Type!=etStop; ++exec) {
+        // function index in mathFuncList: 9: incsum, 13: rnd, 14: rndg
+        if (exec->Type==etFunction && (exec->Index==9 || exec->Index==13 || exec->Index==14))
+            return true;
+    }
+    return false;
+}
+
 double Expression::execute(double *varlist, ExpressionWrapper *object) const
 {
     if (!m_parsed) {
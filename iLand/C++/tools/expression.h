@@ -73,6 +73,9 @@ public:
 
         bool isConstExpression() const { return m_constExpression; } ///< returns true if current expression is a constant.
         bool isEmpty() const { return m_empty; } ///< returns true if expression is empty
+        /// returns true if the result depends on the order of execution, i.e. if the expression uses incsum() or random numbers (rnd(), rndg()).
+        /// Such expressions must not be executed in parallel.
+        bool isOrderDependent() const;
         const QString &lastError() const { return m_errorMsg; }
         /** strict property: if true, variables must be named before execution.
           When strict=true, all variables in the expression must be added by setVar or addVar.
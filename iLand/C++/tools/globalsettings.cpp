@@ -58,6 +58,10 @@
   code if the generation of debug output for a specific type is enabled. Internally, this is a single
   bitwise operation which is very fast.
   Call debugLists() to retrieve a list of lists of data that fit specific criteria.
+  debugList() is called from worker threads: each thread appends to its own buffer (no locking required).
+  mergeDebugLists() collects the buffers at the end of a year (in a deterministic order that does not
+  depend on the scheduling of threads); the ModelController streams the data of each year to files
+  (if "debugOutputAutoSave" is enabled) and removes the data from memory.
   @code
     // use something like that somewhere in a tree-growth-related routine:
     DBGMODE(
@@ -75,9 +79,11 @@
 #include <QtSql>
 #include <QJSEngine>
 #include <algorithm>
+#include <limits>
 #include "global.h"
 #include "helper.h"
 #include "xmlhelper.h"
+#include "tracer.h"
 #include "stdint.h"
 
 #include "settingmetadata.h"
@@ -163,6 +169,7 @@ QString GlobalSettings::executeJavascript(const QString &command)
 
 QString GlobalSettings::executeJSFunction(const QString function_name)
 {
+    TraceScope trace(function_name);
     QString result = ScriptGlobal::executeJSFunction(function_name);
     if (!ScriptGlobal::lastErrorMessage().isEmpty())
         Helper::msg("Javascript-Error: \n" + ScriptGlobal::lastErrorMessage());
@@ -218,51 +225,169 @@ GlobalSettings::DebugOutputs GlobalSettings::debugOutputId(const QString debug_n
 
 
 
+void DebugList::append(const QVariant &value)
+{
+    switch (static_cast<QMetaType::Type>(value.userType())) {
+    case QMetaType::Int: *this << value.toInt(); break;
+    case QMetaType::Double: *this << value.toDouble(); break;
+    case QMetaType::Float: *this << value.toFloat(); break;
+    case QMetaType::Bool: *this << value.toBool(); break;
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::ULong:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+        // integers that fit into an int are stored as int, larger values as double
+        if (value.toLongLong() >= std::numeric_limits<int>::min() && value.toLongLong() <= std::numeric_limits<int>::max())
+            *this << value.toInt();
+        else
+            *this << value.toDouble();
+        break;
+    default: *this << value.toString(); break;
+    }
+}
+
+double DebugList::number(const int index) const
+{
+    switch (type(index)) {
+    case Int: case Bool: return static_cast<double>(mValues[index].i);
+    case Double: return mValues[index].d;
+    case Float: return static_cast<double>(mValues[index].f);
+    default: return 0.;
+    }
+}
+
+QVariant DebugList::at(const int index) const
+{
+    switch (type(index)) {
+    case Int: return QVariant(static_cast<int>(mValues[index].i));
+    case Double: return QVariant(mValues[index].d);
+    case Float: return QVariant(mValues[index].f);
+    case Bool: return QVariant(mValues[index].i != 0);
+    default: return QVariant(mText[static_cast<int>(mValues[index].i)]);
+    }
+}
+
+QList<QVariant> DebugList::toVariantList() const
+{
+    QList<QVariant> result;
+    result.reserve(count());
+    for (int i=0;i<count();++i)
+        result.append(at(i));
+    return result;
+}
+
+// buffer of debug data of a single thread (debugList() appends without locking)
+struct DebugThreadBuffer {
+    std::deque<GlobalSettings::DebugRecord> records; // a deque does not invalidate references on push_back()
+};
+static QMutex debug_buffer_mutex; // only used when a thread creates its buffer
+static QList<DebugThreadBuffer*> debug_buffers;
+static thread_local DebugThreadBuffer *tls_debug_buffer = nullptr;
+
 void GlobalSettings::clearDebugLists()
 {
-    mDebugLists.clear();
+    mDebugRecords.clear();
+    mDebugIndex.clear();
+    QMutexLocker m(&debug_buffer_mutex);
+    foreach(DebugThreadBuffer *buf, debug_buffers)
+        buf->records.clear();
 }
 
-static QMutex debugListMutex;
 DebugList &GlobalSettings::debugList(const int ID, const DebugOutputs dbg)
 {
-    QMutexLocker m(&debugListMutex); // serialize creation of debug outputs
-    DebugList dbglist;
-    dbglist << ID << dbg << currentYear();
-    int id = ID;
-    // use negative values for debug-outputs on RU - level
-    // Note: at some point we will also have to handle RUS-level...
-    if (dbg == dEstablishment || dbg == dCarbonCycle || dbg == dSaplingGrowth)
-        id = -id;
-    QMultiHash<int, DebugList>::iterator newitem = mDebugLists.insert(id, dbglist);
-    return *newitem;
+    if (!tls_debug_buffer) {
+        QMutexLocker m(&debug_buffer_mutex); // only once per thread
+        tls_debug_buffer = new DebugThreadBuffer;
+        debug_buffers.append(tls_debug_buffer);
+    }
+    DebugRecord rec;
+    rec.id = ID;
+    rec.type = dbg;
+    rec.year = currentYear();
+    tls_debug_buffer->records.push_back(rec);
+    DebugList &dbglist = tls_debug_buffer->records.back().values;
+    dbglist << ID << dbg << rec.year;
+    return dbglist;
+}
+
+// order of debug records: type, year, id, and the values for rows with the same id
+// (e.g., the water cycle uses the day as id for all resource units).
+static bool debugRecordLess(const GlobalSettings::DebugRecord *a, const GlobalSettings::DebugRecord *b)
+{
+    if (a->type != b->type) return a->type < b->type;
+    if (a->year != b->year) return a->year < b->year;
+    if (a->id != b->id) return a->id < b->id;
+    int n = std::min(a->values.size(), b->values.size());
+    for (int i=3;i<n;++i) {
+        const bool text_a = a->values.type(i)==DebugList::Text;
+        const bool text_b = b->values.type(i)==DebugList::Text;
+        if (!text_a && !text_b) {
+            const double da = a->values.number(i);
+            const double db = b->values.number(i);
+            if (da != db) return da < db;
+        } else {
+            int c = QString::compare(a->values.text(i), b->values.text(i));
+            if (c != 0) return c < 0;
+        }
+    }
+    return a->values.size() < b->values.size();
 }
-bool debuglist_sorter (const DebugList *i,const DebugList *j)
+
+void GlobalSettings::mergeDebugLists()
 {
-    return ((*i)[0].toInt() < (*j)[0].toInt());
+    QMutexLocker m(&debug_buffer_mutex);
+    QVector<DebugRecord*> recs;
+    foreach(DebugThreadBuffer *buf, debug_buffers)
+        for (std::deque<DebugRecord>::iterator it=buf->records.begin(); it!=buf->records.end(); ++it)
+            if (it->values.count()>2) // contains data
+                recs.push_back(&(*it));
+    if (recs.isEmpty()) {
+        foreach(DebugThreadBuffer *buf, debug_buffers)
+            buf->records.clear();
+        return;
+    }
+
+    std::sort(recs.begin(), recs.end(), debugRecordLess);
+    foreach(DebugRecord *r, recs) {
+        int key = r->id;
+        // use negative values for debug-outputs on RU - level
+        // Note: at some point we will also have to handle RUS-level...
+        if (r->type == dEstablishment || r->type == dCarbonCycle || r->type == dSaplingGrowth)
+            key = -key;
+        mDebugIndex.insert(key, static_cast<int>(mDebugRecords.size()));
+        mDebugRecords.push_back(DebugRecord());
+        DebugRecord &target = mDebugRecords.back();
+        target.id = r->id; target.type = r->type; target.year = r->year;
+        target.values.swap(r->values);
+    }
+
+    foreach(DebugThreadBuffer *buf, debug_buffers)
+        buf->records.clear();
 }
+
 const QList<const DebugList*> GlobalSettings::debugLists(const int ID, const DebugOutputs dbg)
 {
+    mergeDebugLists(); // include data that was not merged yet
+
+    // the merged records are already ordered (type, year, id)
     QList<const DebugList*> result_list;
     if (ID==-1) {
-        foreach(const DebugList &list, mDebugLists)
-            if (list.count()>2)  // contains data
-                if (int(dbg)==-1 || (list[1]).toInt() & int(dbg) ) // type fits or is -1 for all
-                    result_list << &list;
+        for (std::deque<DebugRecord>::const_iterator it=mDebugRecords.cbegin(); it!=mDebugRecords.cend(); ++it)
+            if (int(dbg)==-1 || (it->type & int(dbg)) ) // type fits or is -1 for all
+                result_list << &it->values;
     } else {
         // search a specific id
-        QMultiHash<int, DebugList>::const_iterator res = mDebugLists.find(ID);
-        while (res != mDebugLists.end() && res.key() == ID)  {
-            const DebugList &list = res.value();
-            if (list.count()>2)  // contains data
-                if (int(dbg)==-1 || (list[1]).toInt() & int(dbg) ) // type fits or is -1 for all
-                    result_list << &list;
-            ++res;
+        QList<int> idx = mDebugIndex.values(ID);
+        std::sort(idx.begin(), idx.end());
+        foreach(int i, idx) {
+            const DebugRecord &rec = mDebugRecords[i];
+            if (int(dbg)==-1 || (rec.type & int(dbg)) ) // type fits or is -1 for all
+                result_list << &rec.values;
         }
     }
-    // sort result list
-    //std::sort(result_list.begin(), result_list.end(), debuglist_sorter); // changed because of compiler warnings
-    std::sort(result_list.begin(), result_list.end(), debuglist_sorter);
     return result_list;
 }
 
@@ -332,13 +457,17 @@ QStringList GlobalSettings::debugDataTable(GlobalSettings::DebugOutputs type,
     QList<const DebugList*> ddl = g->debugLists(-1, type); // get all debug data
 
     QStringList result;
-    if (ddl.count()==0)
+    if (ddl.count()==0) {
+        // start a new file: remove data from a previous run
+        if (!fileName.isEmpty() && !do_append && QFile::exists(fileName))
+            QFile::remove(fileName);
         return result;
+    }
 
     QFile out_file(fileName);
     QTextStream ts;
     if (!fileName.isEmpty()) {
-        if (do_append) {
+        if (do_append && out_file.exists() && out_file.size()>0) {
             if (out_file.open(QFile::Append)) {
                 ts.setDevice(&out_file);
             }
@@ -353,13 +482,13 @@ QStringList GlobalSettings::debugDataTable(GlobalSettings::DebugOutputs type,
 
     }
 
-    for (int i=ddl.count()-1; i>=0; --i) {
+    for (int i=0; i<ddl.count(); ++i) {
         QString line;
-        int c=0;
-        foreach(const QVariant &value, *ddl.at(i)) {
-            if (c++)
+        const DebugList &list = *ddl.at(i);
+        for (int c=0;c<list.count();++c) {
+            if (c)
                 line+=separator;
-            line += value.toString();
+            line += list.at(c).toString();
         }
         // save data to the file, or to the
         if (out_file.isOpen())
@@ -377,19 +506,18 @@ QList<QPair<QString, QVariant> > GlobalSettings::debugValues(const int ID)
 {
 
     QList<QPair<QString, QVariant> > result;
-    QMultiHash<int, DebugList>::iterator res = mDebugLists.find(ID);
-    while (res != mDebugLists.end() && res.key() == ID)  {
-        DebugList &list = res.value();
+    QList<const DebugList*> lists = debugLists(ID, DebugOutputs(-1));
+    foreach(const DebugList *plist, lists) {
+        const DebugList &list = *plist;
         if (list.count()>2) { // contains data
            QStringList cap = debugListCaptions( DebugOutputs(list[1].toInt()) );
            result.append(QPair<QString, QVariant>("Debug data", "Debug data") );
            int first_index = 3;
-           if (list[3]=="Id")  // skip default data fields (not needed for drill down)
+           if (list.count()>3 && list.text(3)=="Id")  // skip default data fields (not needed for drill down)
                first_index=14;
            for (int i=first_index;i<list.count();++i)
                result.append(QPair<QString, QVariant>(cap[i], list[i]));
         }
-        ++res;
     }
     return result;
 }
@@ -23,6 +23,9 @@
 #include <QtCore>
 #include <QtSql>
 #include <QtSql/QSqlDatabase>
+#include <deque>
+#include <vector>
+#include <type_traits>
 
 #include "global.h"
 #include "settingmetadata.h"
@@ -35,7 +38,46 @@
 #define QT_USE_FAST_CONCATENATION
 #define QT_USE_FAST_OPERATOR_PLUS
 
-typedef QList<QVariant> DebugList;
+/** DebugList is a single row of debug output (id, type, year, values).
+  The values are stored typed and compact (8 bytes + a type tag per value, text in a separate list) instead of
+  a list of QVariants (which requires a heap allocation per value). Values are added with operator<<; at() and
+  operator[] return a QVariant of the original type (i.e. the formatting of the output is unchanged). */
+class DebugList
+{
+public:
+    enum ValueType { Int=0, Double=1, Float=2, Bool=3, Text=4 };
+    DebugList &operator<<(const int value) { Value v; v.i = value; return add(v, Int); }
+    DebugList &operator<<(const double value) { Value v; v.d = value; return add(v, Double); }
+    DebugList &operator<<(const float value) { Value v; v.f = value; return add(v, Float); }
+    DebugList &operator<<(const bool value) { Value v; v.i = value ? 1 : 0; return add(v, Bool); }
+    DebugList &operator<<(const QString &value) { Value v; v.i = mText.size(); mText.append(value); return add(v, Text); }
+    DebugList &operator<<(const QList<QVariant> &values) { for (int i=0;i<values.size();++i) append(values[i]); return *this; }
+    /// other types (e.g. unsigned or 64 bit integers); enumerations are stored as int
+    template <typename T, typename std::enable_if<!std::is_enum<T>::value, int>::type = 0>
+    DebugList &operator<<(const T &value) { append(QVariant::fromValue(value)); return *this; }
+    template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    DebugList &operator<<(const T value) { return *this << static_cast<int>(value); }
+    void append(const QVariant &value);
+
+    int count() const { return static_cast<int>(mTypes.size()); }
+    int size() const { return count(); }
+    bool isEmpty() const { return mTypes.empty(); }
+    ValueType type(const int index) const { return static_cast<ValueType>(mTypes[index]); }
+    /// numerical value at 'index' (0 for text)
+    double number(const int index) const;
+    const QString text(const int index) const { return type(index)==Text ? mText[static_cast<int>(mValues[index].i)] : at(index).toString(); }
+    QVariant at(const int index) const;
+    QVariant operator[](const int index) const { return at(index); }
+    QList<QVariant> toVariantList() const;
+    void swap(DebugList &other) { mValues.swap(other.mValues); mTypes.swap(other.mTypes); mText.swap(other.mText); }
+private:
+    union Value { qint64 i; double d; float f; };
+    DebugList &add(const Value v, const ValueType type) { mValues.push_back(v); mTypes.push_back(static_cast<quint8>(type)); return *this; }
+    std::vector<Value> mValues;
+    std::vector<quint8> mTypes;
+    QStringList mText;
+};
+inline QDebug operator<<(QDebug dbg, const DebugList &list) { dbg << list.toVariantList(); return dbg; }
 
 class Model;
 class OutputManager;
@@ -84,7 +126,9 @@ public:
     int currentDebugOutput() const { return mDebugOutputs; }
     QString debugOutputName(const DebugOutputs d); ///< returns the name attached to 'd' or an empty string if not found
     DebugOutputs debugOutputId(const QString debug_name); ///< returns the DebugOutputs bit or 0 if not found
-    DebugList &debugList(const int ID, const DebugOutputs dbg); ///< returns a ref to a list ready to be filled with debug output of a type/id combination.
+    DebugList &debugList(const int ID, const DebugOutputs dbg); ///< returns a ref to a list ready to be filled with debug output of a type/id combination (lock free, thread local).
+    /// merge the debug data collected by all threads (call only if no worker threads are active, e.g. at the end of the year).
+    void mergeDebugLists();
     const QList<const DebugList*> debugLists(const int ID, const DebugOutputs dbg); ///< return a list of debug outputs
     QStringList debugListCaptions(const DebugOutputs dbg); ///< returns stringlist of captions for a specific output type
     QList<QPair<QString, QVariant> > debugValues(const int ID); ///< all debug values for object with given ID
@@ -132,7 +176,17 @@ private:
     SystemStatistics *mSystemStatistics;
 
     // special debug outputs
-    QMultiHash<int, DebugList> mDebugLists;
+public:
+    /// a single row of debug output; id, type and year are stored also as plain values for sorting/filtering
+    struct DebugRecord {
+        int id;
+        int type;
+        int year;
+        DebugList values;
+    };
+private:
+    std::deque<DebugRecord> mDebugRecords; ///< merged debug data (deterministic order)
+    QMultiHash<int, int> mDebugIndex; ///< key: id (negative for RU-level outputs), value: index in mDebugRecords
     int mDebugOutputs; // "bitmap" of enabled debugoutputs.
 
     QHash<QString, QString> mFilePath; ///< storage for file paths
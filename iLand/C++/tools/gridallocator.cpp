@@ -0,0 +1,278 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "gridallocator.h"
+#include "xmlhelper.h"
+
+#include <new>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+GridAllocator::Mode GridAllocator::mMode = GridAllocator::Heap;
+bool GridAllocator::mSparse = false;
+QString GridAllocator::mDirectory;
+qint64 GridAllocator::mMinBytes = 16*1024*1024;
+QHash<const void*, GridAllocator::Block> GridAllocator::mBlocks;
+static QMutex allocator_mutex;
+static const size_t cTrackBytes = 1024*1024; // blocks >= 1MB are tracked for the memory usage
+
+static size_t pageSize()
+{
+#ifdef Q_OS_UNIX
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+#else
+    return 4096;
+#endif
+}
+
+void GridAllocator::setup(const XmlHelper &xml)
+{
+    QString mode = xml.value("system.settings.gridMemory.mode", "heap").toLower();
+    Mode m = Heap;
+    if (mode=="mmap") m = Anonymous;
+    else if (mode=="file") m = File;
+    else if (mode!="heap")
+        throw IException(QString("GridAllocator: invalid value '%1' for 'system.settings.gridMemory.mode' (allowed: heap, mmap, file).").arg(mode));
+    QString dir = GlobalSettings::instance()->path(xml.value("system.settings.gridMemory.directory", "."), "temp");
+    qint64 min_bytes = static_cast<qint64>(xml.valueDouble("system.settings.gridMemory.minSize", 16.) * 1024. * 1024.);
+    setMode(m, dir, min_bytes);
+    mSparse = xml.valueBool("system.settings.gridMemory.sparse", false);
+    if (mMode!=Heap)
+        qDebug() << "Grid memory: mode" << mode << "for blocks >=" << min_bytes/(1024*1024) << "MB" << (mMode==File ? "in " + mDirectory : QString()) << "sparse LIF grid:" << sparse();
+}
+
+void GridAllocator::setMode(Mode mode, const QString &directory, qint64 min_bytes)
+{
+#ifdef Q_OS_UNIX
+    mMode = mode;
+#else
+    if (mode!=Heap)
+        qDebug() << "GridAllocator: memory maps are not supported on this platform (using the heap).";
+    mMode = Heap;
+#endif
+    mDirectory = directory.isEmpty() ? QDir::tempPath() : directory;
+    mMinBytes = min_bytes;
+}
+
+void *GridAllocator::allocate(size_t bytes)
+{
+    if (bytes==0)
+        bytes = 1;
+    Block block;
+    block.bytes = bytes;
+    block.mode = Heap;
+    block.fd = -1;
+    void *data = nullptr;
+#ifdef Q_OS_UNIX
+    if (mMode!=Heap && static_cast<qint64>(bytes) >= mMinBytes) {
+        if (mMode==File) {
+            QByteArray file_name = QDir(mDirectory).filePath("iland_grid_XXXXXX").toLocal8Bit();
+            int fd = mkstemp(file_name.data());
+            if (fd<0)
+                throw IException(QString("GridAllocator: cannot create a backing file in '%1'.").arg(mDirectory));
+            unlink(file_name.constData()); // the file is removed when the block is freed (or the process ends)
+            if (ftruncate(fd, static_cast<off_t>(bytes))!=0) {
+                close(fd);
+                throw IException(QString("GridAllocator: cannot resize the backing file to %1 MB.").arg(bytes/(1024*1024)));
+            }
+            data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            block.fd = fd;
+        } else {
+            data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        }
+        if (data==MAP_FAILED) {
+            if (block.fd>=0)
+                close(block.fd);
+            throw IException(QString("GridAllocator: memory map of %1 MB failed.").arg(bytes/(1024*1024)));
+        }
+        block.mode = mMode;
+    }
+#endif
+    if (!data)
+        data = ::operator new(bytes);
+    if (bytes >= cTrackBytes || block.mode!=Heap) {
+        QMutexLocker lock(&allocator_mutex);
+        mBlocks.insert(data, block);
+    }
+    return data;
+}
+
+void GridAllocator::deallocate(void *data)
+{
+    if (!data)
+        return;
+    Block block;
+    block.mode = Heap;
+    {
+        QMutexLocker lock(&allocator_mutex);
+        QHash<const void*, Block>::iterator it = mBlocks.find(data);
+        if (it != mBlocks.end()) {
+            block = it.value();
+            mBlocks.erase(it);
+        }
+    }
+#ifdef Q_OS_UNIX
+    if (block.mode!=Heap) {
+        munmap(data, block.bytes);
+        if (block.fd>=0)
+            close(block.fd);
+        return;
+    }
+#endif
+    ::operator delete(data);
+}
+
+bool GridAllocator::isMapped(const void *data)
+{
+    QMutexLocker lock(&allocator_mutex);
+    QHash<const void*, Block>::const_iterator it = mBlocks.constFind(data);
+    return it != mBlocks.constEnd() && it.value().mode!=Heap;
+}
+
+size_t GridAllocator::discard(void *data, size_t offset, size_t bytes)
+{
+    if (!data || bytes==0 || mMode==Heap)
+        return 0;
+#ifdef Q_OS_UNIX
+    Block block;
+    block.mode = Heap;
+    {
+        QMutexLocker lock(&allocator_mutex);
+        QHash<const void*, Block>::const_iterator it = mBlocks.constFind(data);
+        if (it != mBlocks.constEnd())
+            block = it.value();
+    }
+    if (block.mode==Heap)
+        return 0;
+    // the block starts at a page boundary: only whole pages within the range are released
+    const size_t page_size = pageSize();
+    const size_t first = ((offset + page_size - 1) / page_size) * page_size;
+    const size_t last = std::min(((offset + bytes) / page_size) * page_size, block.bytes);
+    if (last <= first)
+        return 0;
+    bool released = false;
+    if (block.mode==Anonymous) {
+#ifdef Q_OS_LINUX
+        // private anonymous pages are zero-filled on the next access. This holds for MADV_DONTNEED on Linux only;
+        // on other systems the pages may keep their content (and are cleared with memset() in zero()).
+        released = madvise(static_cast<char*>(data) + first, last - first, MADV_DONTNEED)==0;
+#endif
+    } else {
+#if defined(Q_OS_LINUX) && defined(FALLOC_FL_PUNCH_HOLE)
+        // free the blocks of the backing file (reads return zeros)
+        released = fallocate(block.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(first), static_cast<off_t>(last - first))==0;
+#endif
+    }
+    return released ? last - first : 0;
+#else
+    Q_UNUSED(offset); Q_UNUSED(bytes);
+    return 0;
+#endif
+}
+
+void GridAllocator::zero(void *data, size_t bytes)
+{
+    if (!data || bytes==0)
+        return;
+    if (mMode==Heap) {
+        // no memory maps: skip the lookup of the block (called for every Grid::wipe())
+        memset(data, 0, bytes);
+        return;
+    }
+    // release the whole pages (mapped blocks only), and clear the remainder
+    const size_t released = discard(data, 0, bytes);
+    memset(static_cast<char*>(data) + released, 0, bytes - released);
+}
+
+void GridAllocator::setName(const void *data, const QString &name)
+{
+    QMutexLocker lock(&allocator_mutex);
+    QHash<const void*, Block>::iterator it = mBlocks.find(data);
+    if (it != mBlocks.end())
+        it.value().name = name;
+}
+
+// bytes of the block that are in physical memory
+static qint64 residentBytes(const void *data, size_t bytes)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS)
+    const size_t page_size = pageSize();
+    const size_t n_pages = (bytes + page_size - 1) / page_size;
+    // mincore() requires a page aligned address (heap blocks are not necessarily aligned)
+    const uintptr_t start = reinterpret_cast<uintptr_t>(data) & ~(uintptr_t(page_size) - 1);
+    const size_t n = n_pages + (reinterpret_cast<uintptr_t>(data)!=start ? 1 : 0);
+    QVector<unsigned char> pages(static_cast<int>(n));
+#ifdef Q_OS_MACOS
+    if (mincore(reinterpret_cast<void*>(start), n*page_size, reinterpret_cast<char*>(pages.data()))!=0)
+#else
+    if (mincore(reinterpret_cast<void*>(start), n*page_size, pages.data())!=0)
+#endif
+        return -1;
+    qint64 resident = 0;
+    for (int i=0;i<pages.size();++i)
+        if (pages[i] & 1)
+            ++resident;
+    return std::min(resident * static_cast<qint64>(page_size), static_cast<qint64>(bytes));
+#else
+    Q_UNUSED(data); Q_UNUSED(bytes);
+    return -1;
+#endif
+}
+
+QList<GridAllocator::Usage> GridAllocator::usage()
+{
+    QMutexLocker lock(&allocator_mutex);
+    QMap<QString, Usage> by_name;
+    for (QHash<const void*, Block>::const_iterator it=mBlocks.constBegin(); it!=mBlocks.constEnd(); ++it) {
+        const QString name = it.value().name.isEmpty() ? QStringLiteral("other") : it.value().name;
+        Usage &u = by_name[name];
+        u.name = name;
+        u.bytes += static_cast<qint64>(it.value().bytes);
+        u.blocks++;
+        qint64 resident = residentBytes(it.key(), it.value().bytes);
+        if (resident<0 || u.residentBytes<0)
+            u.residentBytes = -1;
+        else
+            u.residentBytes += resident;
+    }
+    return by_name.values();
+}
+
+void GridAllocator::logUsage()
+{
+    QList<Usage> list = usage();
+    qint64 total=0, total_resident=0;
+    foreach(const Usage &u, list) {
+        qDebug() << QString("Grid memory: %1: %2 block(s), %3 MB allocated, %4 MB resident")
+                    .arg(u.name).arg(u.blocks)
+                    .arg(u.bytes / (1024.*1024.), 0, 'f', 1)
+                    .arg(u.residentBytes<0 ? QString("n/a") : QString::number(u.residentBytes / (1024.*1024.), 'f', 1));
+        total += u.bytes;
+        total_resident += u.residentBytes<0 ? 0 : u.residentBytes;
+    }
+    qDebug() << QString("Grid memory: total %1 MB allocated, %2 MB resident").arg(total / (1024.*1024.), 0, 'f', 1).arg(total_resident / (1024.*1024.), 0, 'f', 1);
+}
@@ -0,0 +1,98 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef GRIDALLOCATOR_H
+#define GRIDALLOCATOR_H
+#include <QtCore>
+
+class XmlHelper;
+
+/** GridAllocator provides the memory for the cells of Grid<T> (and the sapling cells of resource units).
+  @ingroup tools
+  In the default mode ('heap') memory is allocated with operator new. For very large landscapes, large blocks
+  (>= 'minSize') can be backed by memory maps instead:
+  'mmap': anonymous memory maps. Pages are only allocated by the operating system when they are written, i.e. grid
+          cells that are never touched (e.g. far outside of the project area) do not use physical memory.
+  'file': shared memory maps of (deleted) temporary files in 'directory'. In addition to the lazy allocation,
+          the operating system can write pages to the file and evict them from RAM (out-of-core).
+  Memory maps are zero-initialized. On Linux, zero() releases whole pages of mapped blocks instead of writing zeros, so
+  grids that are cleared each year (e.g. seed maps) only use memory for the pages that received values.
+  Blocks can be given a name (setName()); usage() reports the size and the resident memory per name.
+  Memory maps are available on Unix systems only (other systems always use the heap).
+
+  Settings (project file, system.settings.gridMemory):
+  mode: heap (default), mmap, file
+  directory: folder for the backing files of the 'file' mode (default: the 'temp' folder)
+  minSize: minimum size (MB) of a block to use a memory map (default: 16)
+  sparse: true: do not initialize the LIF grid far outside of the project area (see Model::setupSparseGrid()); default: false
+  */
+class GridAllocator
+{
+public:
+    enum Mode { Heap=0, Anonymous=1, File=2 };
+    /// memory usage of all blocks with the same name
+    struct Usage {
+        Usage(): bytes(0), residentBytes(0), blocks(0) {}
+        QString name;
+        qint64 bytes; ///< allocated size (bytes)
+        qint64 residentBytes; ///< bytes in physical memory (or -1 if not available)
+        int blocks; ///< number of blocks
+    };
+
+    /// setup from the project file. Settings affect only blocks that are allocated afterwards.
+    static void setup(const XmlHelper &xml);
+    static void setMode(Mode mode, const QString &directory=QString(), qint64 min_bytes=16*1024*1024);
+    static Mode mode() { return mMode; }
+    /// true if the sparse initialization of the LIF grid is enabled (requires memory maps)
+    static bool sparse() { return mSparse && mMode!=Heap; }
+
+    /// allocate a block of 'bytes' bytes (not initialized for the heap, zero-initialized for memory maps)
+    static void *allocate(size_t bytes);
+    /// free a block previously allocated with allocate()
+    static void deallocate(void *data);
+    /// true if 'data' is (a block) backed by a memory map
+    static bool isMapped(const void *data);
+    /// set 'bytes' bytes starting at 'data' to zero. Whole pages of mapped blocks are released to the operating system (Linux only).
+    static void zero(void *data, size_t bytes);
+    /// release the whole pages of the range [offset, offset+bytes) of the mapped block 'data' to the operating system.
+    /// The content of the released pages is zero afterwards. Returns the number of released bytes (0 for heap blocks
+    /// and in 'heap' mode).
+    static size_t discard(void *data, size_t offset, size_t bytes);
+    /// give the block starting at 'data' a name (for usage())
+    static void setName(const void *data, const QString &name);
+
+    /// memory usage per name (unnamed blocks are reported as 'other'); only blocks with at least 1MB are tracked.
+    static QList<Usage> usage();
+    /// write the memory usage to the log
+    static void logUsage();
+private:
+    struct Block {
+        size_t bytes;
+        Mode mode;
+        int fd; ///< file descriptor of the backing file ('file' mode)
+        QString name;
+    };
+    static Mode mMode;
+    static bool mSparse;
+    static QString mDirectory;
+    static qint64 mMinBytes;
+    static QHash<const void*, Block> mBlocks;
+};
+
+#endif // GRIDALLOCATOR_H
@@ -22,7 +22,9 @@
 #include "plugin_interface.h"
 
 #include "globalsettings.h"
+#include "model.h"
 #include "debugtimer.h"
+#include "tracer.h"
 #include "exception.h"
 #include <QtPlugin>
 
@@ -39,6 +41,8 @@ Q_IMPORT_PLUGIN(iland_barkbeetle)
 
 Modules::Modules()
 {
+    mPhaseHooks.resize(YearLoopInterface::PhaseCount);
+    mRUPhaseHooks.resize(YearLoopInterface::PhaseCount);
     init();
 }
 
@@ -73,6 +77,17 @@ void Modules::init()
         }
     }
 
+    // modules that only provide hooks for the year loop, and the hooks of the active disturbance modules
+    foreach (QObject *plugin, QPluginLoader::staticInstances()) {
+        YearLoopInterface *yl = qobject_cast<YearLoopInterface *>(plugin);
+        if (!yl)
+            continue;
+        DisturbanceInterface *di = qobject_cast<DisturbanceInterface *>(plugin);
+        if (di ? mInterfaces.contains(di) : GlobalSettings::instance()->settings().valueBool(QString("modules.%1.enabled").arg(yl->name())))
+            mYearLoop.append(yl);
+    }
+    updatePhaseHooks();
+
     // fix the order of modules: make sure that "barkbeetle" is after "wind"
     DisturbanceInterface *wind = module(QStringLiteral("wind"));
     DisturbanceInterface *bb = module(QStringLiteral("barkbeetle"));
@@ -134,6 +149,7 @@ void Modules::run()
 
     // *** run in fixed order ***
     foreach(DisturbanceInterface *di, mInterfaces) {
+        TraceScope trace(di->name());
         try {
             di->run();
         } catch (const IException &e) {
@@ -167,6 +183,77 @@ void Modules::run()
     //    }
 }
 
+void Modules::addExtension(YearLoopInterface *extension)
+{
+    if (!extension || mYearLoop.contains(extension))
+        return;
+    mYearLoop.append(extension);
+    updatePhaseHooks();
+    qDebug() << "Modules: added extension" << extension->name();
+}
+
+void Modules::removeExtension(YearLoopInterface *extension)
+{
+    mYearLoop.removeAll(extension);
+    updatePhaseHooks();
+}
+
+void Modules::updatePhaseHooks()
+{
+    for (int p=0; p<YearLoopInterface::PhaseCount; ++p) {
+        const YearLoopInterface::Phase phase = static_cast<YearLoopInterface::Phase>(p);
+        mPhaseHooks[p].clear();
+        mRUPhaseHooks[p].clear();
+        foreach(YearLoopInterface *yl, mYearLoop) {
+            if (yl->phases() & YearLoopInterface::phaseFlag(phase))
+                mPhaseHooks[p].append(yl);
+            if (yl->resourceUnitPhases() & YearLoopInterface::phaseFlag(phase))
+                mRUPhaseHooks[p].append(yl);
+        }
+    }
+}
+
+void Modules::runResourceUnitPhase(ResourceUnitPhaseJob &job)
+{
+    foreach(YearLoopInterface *yl, *job.hooks) {
+        try {
+            yl->onResourceUnit(job.phase, job.ru);
+        } catch (const IException &e) {
+            GlobalSettings::instance()->model()->threadExec().throwError(QString("ERROR in module: %1 (%2)\n%3").arg(yl->name(), YearLoopInterface::phaseName(job.phase), e.message()));
+        }
+    }
+}
+
+void Modules::runPhase(const YearLoopInterface::Phase phase)
+{
+    if (!hasHooks(phase))
+        return;
+    TraceScope trace(YearLoopInterface::phaseName(phase));
+    foreach(YearLoopInterface *yl, mPhaseHooks[phase]) {
+        try {
+            yl->onPhase(phase);
+        } catch (const IException &e) {
+            qWarning() << "ERROR: uncaught exception in module '" << yl->name() << "' (" << YearLoopInterface::phaseName(phase) << "):";
+            qWarning() << "ERROR:" << e.message();
+            throw IException(QString("ERROR in module: %1 (%2)\n%3").arg(yl->name(), YearLoopInterface::phaseName(phase), e.message()));
+        }
+    }
+    if (mRUPhaseHooks[phase].isEmpty())
+        return;
+
+    // per resource unit hooks: parallel execution
+    Model *model = GlobalSettings::instance()->model();
+    const QList<ResourceUnit*> &rus = model->ruList();
+    QVector<ResourceUnitPhaseJob> jobs(rus.size());
+    for (int i=0;i<rus.size();++i) {
+        jobs[i].ru = rus[i];
+        jobs[i].phase = phase;
+        jobs[i].hooks = &mRUPhaseHooks[phase];
+    }
+    model->threadExec().run(&Modules::runResourceUnitPhase, jobs);
+    model->threadExec().checkErrors(); // throws an IException
+}
+
 void Modules::yearBegin()
 {
     foreach(DisturbanceInterface *di, mInterfaces)
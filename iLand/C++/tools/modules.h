@@ -19,6 +19,9 @@
 
 #ifndef MODULES_H
 #define MODULES_H
+#include <QtCore/QList>
+#include <QtCore/QVector>
+#include "plugin_interface.h"
 
 class DisturbanceInterface; // forward
 class SetupResourceUnitInterface; // forward
@@ -54,8 +57,27 @@ public:
 
     // tree death
     void treeDeath(const Tree *tree, int removal_type);
+
+    // hooks of the year loop
+    /// add a module with year loop hooks that is not a (static) plugin. The module is not owned by Modules.
+    void addExtension(YearLoopInterface *extension);
+    void removeExtension(YearLoopInterface *extension);
+    /// true if at least one module has a hook for 'phase'
+    bool hasHooks(const YearLoopInterface::Phase phase) const { return !mPhaseHooks[phase].isEmpty() || !mRUPhaseHooks[phase].isEmpty(); }
+    /// execute the hooks of 'phase': onPhase() (main thread), then onResourceUnit() (parallel for all resource units)
+    void runPhase(const YearLoopInterface::Phase phase);
 private:
     void init();
+    void updatePhaseHooks(); ///< rebuild the lists of hooks per phase
+    struct ResourceUnitPhaseJob {
+        ResourceUnit *ru;
+        YearLoopInterface::Phase phase;
+        const QList<YearLoopInterface*> *hooks;
+    };
+    static void runResourceUnitPhase(ResourceUnitPhaseJob &job);
+    QList<YearLoopInterface*> mYearLoop; ///< modules with year loop hooks (plugins and extensions)
+    QVector<QList<YearLoopInterface*> > mPhaseHooks; ///< per phase: modules for onPhase()
+    QVector<QList<YearLoopInterface*> > mRUPhaseHooks; ///< per phase: modules for onResourceUnit()
     QList<DisturbanceInterface*> mInterfaces; ///< the list stores only the active modules
     QList<SetupResourceUnitInterface*> mSetupRUs;
     QList<WaterInterface*> mWater;
@@ -0,0 +1,185 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "patchlabeler.h"
+
+#include "globalsettings.h"
+#include "model.h"
+#include "threadrunner.h"
+
+// run 'funcptr' for all strips, either via the ThreadRunner of the model or serially
+static void runStrips(void (*funcptr)(PatchLabeler::Strip&), QVector<PatchLabeler::Strip> &strips)
+{
+    if (GlobalSettings::instance()->model()) {
+        GlobalSettings::instance()->model()->threadExec().run(funcptr, strips);
+    } else {
+        for (int i=0;i<strips.size();++i)
+            (*funcptr)(strips[i]);
+    }
+}
+
+int PatchLabeler::run(Grid<int> &rLabels, int min_size)
+{
+    mPatches.clear();
+    mSkipped = 0;
+    if (mMask.empty())
+        return 0;
+    mParent.resize(mMask.size());
+
+    // split the grid in strips of rows
+    QVector<Strip> strips;
+    int n_strips = std::max(QThread::idealThreadCount()*2, 1);
+    int rows = std::max(32, (mSizeY + n_strips - 1) / n_strips);
+    for (int y=0; y<mSizeY; y+=rows) {
+        Strip s;
+        s.y_from = y; s.y_to = std::min(y+rows, mSizeY);
+        s.labeler = this;
+        s.labels = &rLabels;
+        strips.push_back(s);
+    }
+
+    // (1) local labelling within each strip
+    runStrips(labelStrip, strips);
+
+    // (2) merge the seams between strips (the first row of a strip with the last row of the previous strip)
+    for (int s=1; s<strips.size(); ++s) {
+        int y = strips[s].y_from;
+        for (int x=0; x<mSizeX; ++x) {
+            int i = y*mSizeX + x;
+            if (!mMask[i])
+                continue;
+            int j = i - mSizeX; // south
+            if (mMask[j]) unite(i, j);
+            if (mConnectivity==Neighbors8) {
+                if (x>0 && mMask[j-1]) unite(i, j-1);
+                if (x<mSizeX-1 && mMask[j+1]) unite(i, j+1);
+            }
+        }
+    }
+
+    // (3) resolve the roots and collect statistics per root
+    runStrips(resolveStrip, strips);
+
+    // merge the statistics: roots are the lowest index of a patch, i.e.
+    // sorting by the root gives the order of the first pixel of each patch
+    QMap<int, Patch> roots;
+    for (int s=0; s<strips.size(); ++s) {
+        QHash<int, Patch>::const_iterator it;
+        for (it = strips[s].stats.constBegin(); it!=strips[s].stats.constEnd(); ++it) {
+            QMap<int, Patch>::iterator r = roots.find(it.key());
+            if (r == roots.end()) {
+                roots.insert(it.key(), it.value());
+            } else {
+                r->area += it->area;
+                r->sumX += it->sumX;
+                r->sumY += it->sumY;
+                r->boundingBox = r->boundingBox.united(it->boundingBox);
+            }
+        }
+    }
+
+    // assign patch ids; the parent-array is re-used to store the id of each root
+    int patch_id = 0;
+    for (QMap<int, Patch>::iterator r=roots.begin(); r!=roots.end(); ++r) {
+        if (r->area < min_size) {
+            mParent[r.key()] = 0;
+            ++mSkipped;
+            continue;
+        }
+        r->id = ++patch_id;
+        mParent[r.key()] = patch_id;
+        mPatches.push_back(r.value());
+    }
+
+    // (4) write final ids
+    runStrips(relabelStrip, strips);
+
+    return patch_id;
+}
+
+void PatchLabeler::labelStrip(PatchLabeler::Strip &strip)
+{
+    PatchLabeler *pl = strip.labeler;
+    const int nx = pl->mSizeX;
+    const bool eight = pl->mConnectivity==Neighbors8;
+    const unsigned char *mask = pl->mMask.data();
+    for (int y=strip.y_from; y<strip.y_to; ++y) {
+        for (int x=0; x<nx; ++x) {
+            int i = y*nx + x;
+            pl->mParent[i] = i;
+            if (!mask[i])
+                continue;
+            // only neighbors that are already visited (and within the strip)
+            if (x>0 && mask[i-1])
+                pl->unite(i, i-1);
+            if (y > strip.y_from) {
+                int j = i - nx;
+                if (mask[j]) pl->unite(i, j);
+                if (eight) {
+                    if (x>0 && mask[j-1]) pl->unite(i, j-1);
+                    if (x<nx-1 && mask[j+1]) pl->unite(i, j+1);
+                }
+            }
+        }
+    }
+}
+
+void PatchLabeler::resolveStrip(PatchLabeler::Strip &strip)
+{
+    const PatchLabeler *pl = strip.labeler;
+    const int nx = pl->mSizeX;
+    const unsigned char *mask = pl->mMask.data();
+    for (int y=strip.y_from; y<strip.y_to; ++y) {
+        int *lbl = strip.labels->ptr(0, y);
+        for (int x=0; x<nx; ++x, ++lbl) {
+            int i = y*nx + x;
+            if (!mask[i]) {
+                *lbl = -1;
+                continue;
+            }
+            int root = pl->findConst(i); // read only, other threads access the same forest
+            *lbl = root;
+            QHash<int, Patch>::iterator it = strip.stats.find(root);
+            if (it == strip.stats.end()) {
+                Patch p;
+                p.id = 0; p.area = 0; p.sumX = 0.; p.sumY = 0.;
+                p.boundingBox = QRect(QPoint(x,y), QPoint(x,y));
+                it = strip.stats.insert(root, p);
+            }
+            it->area++;
+            it->sumX += x;
+            it->sumY += y;
+            if (x < it->boundingBox.left()) it->boundingBox.setLeft(x);
+            if (x > it->boundingBox.right()) it->boundingBox.setRight(x);
+            if (y > it->boundingBox.bottom()) it->boundingBox.setBottom(y);
+        }
+    }
+}
+
+void PatchLabeler::relabelStrip(PatchLabeler::Strip &strip)
+{
+    const PatchLabeler *pl = strip.labeler;
+    const int nx = pl->mSizeX;
+    for (int y=strip.y_from; y<strip.y_to; ++y) {
+        int *lbl = strip.labels->ptr(0, y);
+        for (int x=0; x<nx; ++x, ++lbl)
+            *lbl = *lbl < 0 ? 0 : pl->mParent[*lbl];
+    }
+}
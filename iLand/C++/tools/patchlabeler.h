@@ -0,0 +1,97 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef PATCHLABELER_H
+#define PATCHLABELER_H
+#include "grid.h"
+
+#include <vector>
+
+/** PatchLabeler extracts connected components ("patches", "clumps") from a grid.
+  @ingroup tools
+  The labelling is a two-pass union-find algorithm: the grid is split into horizontal strips that are
+  labelled in parallel, the seams between strips are merged, and a final (parallel) pass writes the
+  labels and collects area, bounding box and centroid of each patch.
+  Pixels with a value > 'threshold' are foreground. The root of each patch is the pixel with the lowest
+  (linear) index, therefore patch ids are assigned in the order of the first pixel of a patch
+  (scanning from index 0). This is the same order as the classic flood fill (see SpatialAnalysis::extractPatches()).
+  Patches smaller than 'min_size' pixels are removed (label 0) and do not consume a patch id.
+  */
+class PatchLabeler
+{
+public:
+    enum Connectivity { Neighbors4=4, Neighbors8=8 };
+    struct Patch {
+        int id; ///< patch id (1..n)
+        int area; ///< number of pixels
+        QRect boundingBox; ///< bounding box (indices, topLeft/bottomRight are inclusive)
+        double sumX, sumY; ///< sum of pixel indices (for the centroid)
+        /// centroid of the patch (in index coordinates of the source grid)
+        QPointF centroid() const { return area>0 ? QPointF(sumX/area, sumY/area) : QPointF(); }
+    };
+
+    PatchLabeler(): mSizeX(0), mSizeY(0) {}
+    /// label patches in 'src' and write patch ids (0: no patch) into 'rLabels' (which is set up with the extent of 'src')
+    /// returns the number of patches
+    template<class T> int label(const Grid<T> &src, Grid<int> &rLabels, int min_size=0, Connectivity connectivity=Neighbors8, T threshold=T(0));
+    /// list of patches of the last call to label() (ordered by patch id)
+    const QVector<Patch> &patches() const { return mPatches; }
+    /// number of patches that were smaller than 'min_size' in the last call to label()
+    int patchesSkipped() const { return mSkipped; }
+
+    // helper structure for parallel processing of a strip of rows
+    struct Strip {
+        int y_from, y_to; ///< rows [y_from, y_to)
+        PatchLabeler *labeler;
+        Grid<int> *labels;
+        QHash<int, Patch> stats; ///< partial patch statistics (key: root index)
+    };
+private:
+    int run(Grid<int> &rLabels, int min_size); ///< label the current mask
+    static void labelStrip(Strip &strip); ///< pass 1: local union-find
+    static void resolveStrip(Strip &strip); ///< pass 2: find roots and collect statistics
+    static void relabelStrip(Strip &strip); ///< pass 3: write final patch ids
+    inline int find(int i) { while (mParent[i]!=i) { mParent[i] = mParent[mParent[i]]; i = mParent[i]; } return i; }
+    inline int findConst(int i) const { while (mParent[i]!=i) i = mParent[i]; return i; }
+    inline void unite(int a, int b) { a=find(a); b=find(b); if (a<b) mParent[b]=a; else if (b<a) mParent[a]=b; }
+    std::vector<unsigned char> mMask; ///< foreground mask
+    std::vector<int> mParent; ///< union-find forest (later: root -> patch id)
+    int mSizeX;
+    int mSizeY;
+    Connectivity mConnectivity;
+    QVector<Patch> mPatches;
+    int mSkipped;
+};
+
+template<class T>
+int PatchLabeler::label(const Grid<T> &src, Grid<int> &rLabels, int min_size, Connectivity connectivity, T threshold)
+{
+    mSizeX = src.sizeX();
+    mSizeY = src.sizeY();
+    mConnectivity = connectivity;
+    mMask.resize(src.count());
+    unsigned char *m = mMask.data();
+    for (const T *p=src.begin(); p!=src.end(); ++p, ++m)
+        *m = (*p > threshold) ? 1 : 0;
+
+    rLabels.setup(src.metricRect(), src.cellsize());
+    return run(rLabels, min_size);
+}
+
+#endif // PATCHLABELER_H
@@ -0,0 +1,231 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "rasterwriter.h"
+
+#include <QtCore/QVector>
+#include <QtCore/QtEndian>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// TIFF field types
+static const quint16 cAscii = 2;
+static const quint16 cShort = 3;
+static const quint16 cLong = 4;
+static const quint16 cDouble = 12;
+static const quint16 cLong8 = 16;
+
+namespace {
+// an entry of an image file directory (IFD)
+struct IFDEntry {
+    quint16 tag;
+    quint16 type;
+    quint64 count;
+    QByteArray payload; ///< little endian values
+};
+
+void put16(QByteArray &b, quint16 v) { v = qToLittleEndian(v); b.append(reinterpret_cast<const char*>(&v), 2); }
+void put64(QByteArray &b, quint64 v) { v = qToLittleEndian(v); b.append(reinterpret_cast<const char*>(&v), 8); }
+void put32(QByteArray &b, quint32 v) { v = qToLittleEndian(v); b.append(reinterpret_cast<const char*>(&v), 4); }
+void putDouble(QByteArray &b, double v) { quint64 u; memcpy(&u, &v, 8); put64(b, u); }
+
+IFDEntry shortEntry(quint16 tag, const QVector<quint16> &values) {
+    IFDEntry e; e.tag = tag; e.type = cShort; e.count = values.size();
+    foreach(quint16 v, values) put16(e.payload, v);
+    return e;
+}
+IFDEntry longEntry(quint16 tag, quint32 value) {
+    IFDEntry e; e.tag = tag; e.type = cLong; e.count = 1; put32(e.payload, value);
+    return e;
+}
+IFDEntry long8Entry(quint16 tag, const QVector<quint64> &values) {
+    IFDEntry e; e.tag = tag; e.type = cLong8; e.count = values.size();
+    foreach(quint64 v, values) put64(e.payload, v);
+    return e;
+}
+IFDEntry doubleEntry(quint16 tag, const QVector<double> &values) {
+    IFDEntry e; e.tag = tag; e.type = cDouble; e.count = values.size();
+    foreach(double v, values) putDouble(e.payload, v);
+    return e;
+}
+IFDEntry asciiEntry(quint16 tag, const QString &text) {
+    IFDEntry e; e.tag = tag; e.type = cAscii;
+    e.payload = text.toLatin1();
+    e.payload.append('\0');
+    e.count = e.payload.size();
+    return e;
+}
+} // namespace
+
+RasterWriter::DataType RasterWriter::typeFromString(const QString &name)
+{
+    const QString n = name.toLower();
+    if (n=="uint8") return UInt8;
+    if (n=="int16") return Int16;
+    if (n=="int32") return Int32;
+    if (n=="float32" || n=="float") return Float32;
+    throw IException(QString("RasterWriter: invalid data type '%1' (allowed: uint8, int16, int32, float32).").arg(name));
+}
+
+void RasterWriter::setValue(char *dest, const DataType type, const double value)
+{
+    switch (type) {
+    case UInt8: { quint8 v = static_cast<quint8>(std::min(std::max(std::round(value), 0.), 255.)); *dest = static_cast<char>(v); break; }
+    case Int16: { qint16 v = static_cast<qint16>(std::min(std::max(std::round(value), -32768.), 32767.)); memcpy(dest, &v, 2); break; }
+    case Int32: { qint32 v = static_cast<qint32>(std::min(std::max(std::round(value), -2147483648.), 2147483647.)); memcpy(dest, &v, 4); break; }
+    case Float32: { float v = static_cast<float>(value); memcpy(dest, &v, 4); break; }
+    }
+}
+
+void RasterWriter::open(const QString &fileName, const DataType type, const int width, const int height,
+                        const double left, const double top, const double cellsize, const double no_data,
+                        const int tile_size, const bool compress)
+{
+    close();
+    if (width<=0 || height<=0)
+        throw IException(QString("RasterWriter: invalid size %1 x %2 for '%3'.").arg(width).arg(height).arg(fileName));
+    if (tile_size<16 || tile_size%16!=0)
+        throw IException(QString("RasterWriter: the tile size must be a multiple of 16 (is %1).").arg(tile_size));
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        throw IException(QString("RasterWriter: cannot create the file '%1'.").arg(fileName));
+    mType = type;
+    mWidth = width; mHeight = height;
+    mLeft = left; mTop = top; mCellsize = cellsize;
+    mNoData = no_data;
+    mTileSize = tile_size;
+    mCompress = compress;
+    mPages = 0;
+
+    // BigTIFF header: byte order, version (43), size of offsets (8), 0, offset of the first IFD (set by writePage())
+    QByteArray header("II");
+    put16(header, 43);
+    put16(header, 8);
+    put16(header, 0);
+    put64(header, 0);
+    mFile.write(header);
+    mNextIFDPos = 8;
+}
+
+void RasterWriter::close()
+{
+    if (mFile.isOpen())
+        mFile.close();
+}
+
+qint64 RasterWriter::writePage(const char *data, const QString &description)
+{
+    if (!mFile.isOpen())
+        throw IException("RasterWriter: writePage() on a closed file.");
+    const int value_size = typeSize(mType);
+    const int tiles_x = (mWidth + mTileSize - 1) / mTileSize;
+    const int tiles_y = (mHeight + mTileSize - 1) / mTileSize;
+    const qint64 start_size = mFile.size();
+
+    // a tile filled with the no-data value (tiles at the right and bottom border are padded)
+    QByteArray nodata_tile(mTileSize * mTileSize * value_size, '\0');
+    for (int i=0;i<mTileSize*mTileSize;++i)
+        setValue(nodata_tile.data() + i*value_size, mType, mNoData);
+
+    QVector<quint64> offsets, byte_counts;
+    offsets.reserve(tiles_x*tiles_y);
+    byte_counts.reserve(tiles_x*tiles_y);
+    mFile.seek(mFile.size());
+    QByteArray tile;
+    for (int ty=0; ty<tiles_y; ++ty) {
+        for (int tx=0; tx<tiles_x; ++tx) {
+            tile = nodata_tile;
+            const int x0 = tx*mTileSize, y0 = ty*mTileSize;
+            const int nx = std::min(mTileSize, mWidth - x0);
+            const int ny = std::min(mTileSize, mHeight - y0);
+            for (int y=0;y<ny;++y)
+                memcpy(tile.data() + static_cast<size_t>(y)*mTileSize*value_size,
+                       data + (static_cast<size_t>(y0+y)*mWidth + x0)*value_size,
+                       static_cast<size_t>(nx)*value_size);
+            if (mCompress)
+                tile = qCompress(tile, 6).mid(4); // qCompress() adds the uncompressed size (4 bytes) in front of the zlib stream
+            offsets.push_back(static_cast<quint64>(mFile.pos()));
+            byte_counts.push_back(static_cast<quint64>(tile.size()));
+            if (mFile.write(tile)!=tile.size())
+                throw IException(QString("RasterWriter: error writing to '%1' (disk full?).").arg(mFile.fileName()));
+        }
+    }
+
+    // the image file directory (tags in ascending order)
+    QVector<IFDEntry> entries;
+    const quint16 bits = static_cast<quint16>(value_size*8);
+    const quint16 sample_format = mType==Float32 ? 3 : (mType==UInt8 ? 1 : 2);
+    entries << longEntry(256, static_cast<quint32>(mWidth)) // ImageWidth
+            << longEntry(257, static_cast<quint32>(mHeight)) // ImageLength
+            << shortEntry(258, QVector<quint16>() << bits) // BitsPerSample
+            << shortEntry(259, QVector<quint16>() << (mCompress ? 8 : 1)) // Compression: deflate or none
+            << shortEntry(262, QVector<quint16>() << 1); // PhotometricInterpretation: BlackIsZero
+    if (!description.isEmpty())
+        entries << asciiEntry(270, description); // ImageDescription
+    entries << shortEntry(277, QVector<quint16>() << 1) // SamplesPerPixel
+            << shortEntry(284, QVector<quint16>() << 1) // PlanarConfiguration
+            << longEntry(322, static_cast<quint32>(mTileSize)) // TileWidth
+            << longEntry(323, static_cast<quint32>(mTileSize)) // TileLength
+            << long8Entry(324, offsets) // TileOffsets
+            << long8Entry(325, byte_counts) // TileByteCounts
+            << shortEntry(339, QVector<quint16>() << sample_format) // SampleFormat
+            << doubleEntry(33550, QVector<double>() << mCellsize << mCellsize << 0.) // ModelPixelScale
+            << doubleEntry(33922, QVector<double>() << 0. << 0. << 0. << mLeft << mTop << 0.) // ModelTiepoint (upper left corner)
+            << shortEntry(34735, QVector<quint16>() << 1 << 1 << 0 << 1 << 1025 << 0 << 1 << 1) // GeoKeyDirectory: PixelIsArea
+            << asciiEntry(42113, QString::number(mNoData)); // GDAL_NODATA
+
+    qint64 ifd_pos = mFile.size();
+    if (ifd_pos % 2) { mFile.seek(ifd_pos); mFile.write("\0", 1); ++ifd_pos; } // word alignment
+    const qint64 ifd_size = 8 + entries.size()*20 + 8;
+    QByteArray ifd, extra;
+    put64(ifd, static_cast<quint64>(entries.size()));
+    foreach(const IFDEntry &e, entries) {
+        put16(ifd, e.tag);
+        put16(ifd, e.type);
+        put64(ifd, e.count);
+        if (e.payload.size()<=8) {
+            // values are stored in the entry itself
+            QByteArray value = e.payload;
+            value.append(QByteArray(8 - value.size(), '\0'));
+            ifd.append(value);
+        } else {
+            put64(ifd, static_cast<quint64>(ifd_pos + ifd_size + extra.size()));
+            extra.append(e.payload);
+            if (extra.size() % 2)
+                extra.append('\0');
+        }
+    }
+    put64(ifd, 0); // next IFD: none (yet)
+    mFile.seek(ifd_pos);
+    mFile.write(ifd);
+    mFile.write(extra);
+
+    // link the new IFD to the previous IFD (or the header)
+    QByteArray link;
+    put64(link, static_cast<quint64>(ifd_pos));
+    mFile.seek(mNextIFDPos);
+    mFile.write(link);
+    mNextIFDPos = ifd_pos + 8 + entries.size()*20;
+    if (!mFile.flush())
+        throw IException(QString("RasterWriter: error writing to '%1'.").arg(mFile.fileName()));
+    ++mPages;
+    return mFile.size() - start_size;
+}
@@ -0,0 +1,72 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef RASTERWRITER_H
+#define RASTERWRITER_H
+#include <QtCore/QFile>
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+/** RasterWriter writes typed, tiled and (deflate-) compressed rasters as (Big)GeoTIFF files.
+  @ingroup tools
+  A file contains one variable; each call to writePage() appends a new image (a TIFF "page", e.g. one per year)
+  to the file. The files are BigTIFF (64 bit offsets, i.e. no 4GB limit) and carry the georeference (pixel size and
+  the upper left corner in world coordinates) and the no-data value (GDAL tag). GDAL (and hence QGIS, R, Python, ...)
+  opens the first page as the default dataset and the other pages as subdatasets ("GTIFF_DIR:<n>:<file>").
+  The data passed to writePage() is row-major, with the *northernmost* row first, and uses the data type of the file.
+  */
+class RasterWriter
+{
+public:
+    enum DataType { UInt8=0, Int16=1, Int32=2, Float32=3 };
+    RasterWriter(): mWidth(0), mHeight(0), mTileSize(256), mCompress(true), mType(Float32), mNoData(-9999.),
+                    mLeft(0.), mTop(0.), mCellsize(0.), mNextIFDPos(0), mPages(0) {}
+    ~RasterWriter() { close(); }
+    /// create the file 'fileName' for a raster with 'width' x 'height' cells of type 'type'.
+    /// 'left' and 'top' are the world coordinates of the upper left corner, 'cellsize' the cell size (m).
+    void open(const QString &fileName, const DataType type, const int width, const int height,
+              const double left, const double top, const double cellsize, const double no_data=-9999.,
+              const int tile_size=256, const bool compress=true);
+    bool isOpen() const { return mFile.isOpen(); }
+    void close();
+    /// append an image (width*height values of the type of the file) with an (optional) description, e.g. 'year=2020'.
+    /// Returns the number of bytes written to the file.
+    qint64 writePage(const char *data, const QString &description=QString());
+    int pages() const { return mPages; }
+    const QString fileName() const { return mFile.fileName(); }
+
+    /// size (bytes) of a single value of 'type'
+    static int typeSize(const DataType type) { switch (type) { case UInt8: return 1; case Int16: return 2; case Int32: return 4; default: return 4; } }
+    /// parse a type name (uint8, int16, int32, float32); throws an exception for invalid names.
+    static DataType typeFromString(const QString &name);
+    /// store 'value' (converted to 'type') at 'dest'
+    static void setValue(char *dest, const DataType type, const double value);
+private:
+    QFile mFile;
+    int mWidth, mHeight;
+    int mTileSize;
+    bool mCompress;
+    DataType mType;
+    double mNoData;
+    double mLeft, mTop, mCellsize;
+    qint64 mNextIFDPos; ///< file position of the pointer to the next image file directory (IFD)
+    int mPages; ///< number of pages written
+};
+
+#endif // RASTERWRITER_H
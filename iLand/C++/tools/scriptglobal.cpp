@@ -55,6 +55,7 @@
 #include "scriptgrid.h"
 #include "customaggout.h"
 #include "microclimate.h"
+#include "statechecksum.h"
 
 #ifdef ILAND_GUI
 #include "mainwindow.h"
@@ -639,6 +640,44 @@ bool ScriptGlobal::saveDebugOutputs(bool do_clear)
     return true;
 }
 
+QString ScriptGlobal::compareChecksums(QString file1, QString file2)
+{
+    try {
+        return StateChecksum::compare(GlobalSettings::instance()->path(file1), GlobalSettings::instance()->path(file2));
+    } catch (const IException &e) {
+        throwError(e.message());
+    }
+    return QString();
+}
+
+int ScriptGlobal::validateTorusKernels()
+{
+    if (!GlobalSettings::instance()->model() || !Model::settings().torusMode) {
+        throwError("validateTorusKernels(): requires a model in torus mode.");
+        return -1;
+    }
+    int differences = Tree::validateTorusKernels();
+    if (differences>0)
+        throwError(QString("validateTorusKernels(): %1 differences between the torus kernels and the reference implementation.").arg(differences));
+    return differences;
+}
+
+double ScriptGlobal::validateLDDSampler(QString species, int n)
+{
+    Model *model = GlobalSettings::instance()->model();
+    Species *s = model && model->speciesSet() ? model->speciesSet()->species(species) : nullptr;
+    if (!s || !s->seedDispersal()) {
+        throwError(QString("validateLDDSampler(): invalid species '%1' or no seed dispersal.").arg(species));
+        return -1.;
+    }
+    try {
+        return s->seedDispersal()->validateLDDSampler(n);
+    } catch (const IException &e) {
+        throwError(e.message());
+    }
+    return -1.;
+}
+
 bool ScriptGlobal::screenshot(QString file_name)
 {
     if (GlobalSettings::instance()->controller())
@@ -176,6 +176,10 @@ public slots:
     // debug outputs
     void debugOutputFilter(QList<int> ru_indices); ///< enable debug outputs for a list of resource units (output for other RUs are suppressed)
     bool saveDebugOutputs(bool do_clear); ///< save debug outputs to file; if do_clear=true then debug data is cleared from memory
+    QString compareChecksums(QString file1, QString file2); ///< compare two state checksum logs (see system.settings.checksums) and return the first difference
+    // verification of optimized kernels (a script error is raised if a check fails)
+    int validateTorusKernels(); ///< compare the torus kernels (LIP, LIF, height grid) with the reference implementation for the current state; returns the number of differences
+    double validateLDDSampler(QString species, int n=1000000); ///< compare the LDD alias sampler of 'species' with the reference sampler ('n' samples per ring); returns the largest total variation distance
     // miscellaneous stuff
     void setViewport(double x, double y, double scale_px_per_m); ///< set the viewport of the main project area view
     bool screenshot(QString file_name); ///< make a screenshot from the central viewing widget
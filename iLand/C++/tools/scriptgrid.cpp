@@ -26,6 +26,8 @@
 #include "expressionwrapper.h"
 #include "model.h"
 #include "tree.h"
+#include "resourceunit.h"
+#include "threadrunner.h"
 
 
 #include <QJSEngine>
@@ -34,6 +36,160 @@
 int ScriptGrid::mDeleted = 0;
 int ScriptGrid::mCreated = 0;
 
+// grid algebra: grids are processed in tiles of rows. The tiling depends only on the grid size
+// (not on the number of threads), and partial results are combined in tile order; therefore the
+// results are identical for single- and multithreaded execution.
+static const int cCellsPerTile = 16384;
+
+struct GridTile {
+    int from, to; ///< range of cell indices (target grid)
+    const Expression *expr;
+    double *values; ///< data of the target grid
+    QVector<const double*> sources; ///< data of input grids (combine())
+    const Grid<double> *source; ///< source grid (resample(), aggregate())
+    Grid<double> *target; ///< target grid (resample(), aggregate())
+    int factor; ///< aggregation factor
+    double *results; ///< values of the expression per cell (sum())
+    QString error;
+};
+
+// create tiles of full rows with (roughly) cCellsPerTile cells
+static QVector<GridTile> createTiles(int size_x, int size_y)
+{
+    QVector<GridTile> tiles;
+    int rows = std::max(1, cCellsPerTile / std::max(size_x, 1));
+    for (int y=0; y<size_y; y+=rows) {
+        GridTile t;
+        t.from = y * size_x;
+        t.to = std::min(y + rows, size_y) * size_x;
+        t.expr = nullptr; t.values = nullptr; t.results = nullptr; t.source = nullptr; t.target = nullptr;
+        t.factor = 1;
+        tiles.push_back(t);
+    }
+    return tiles;
+}
+
+// run 'funcptr' for all tiles (in parallel if possible) and throw the first error (in tile order)
+static void runTiles(void (*funcptr)(GridTile&), QVector<GridTile> &tiles, bool force_serial=false)
+{
+    Model *model = GlobalSettings::instance()->model();
+    if (model && !force_serial && tiles.size()>1) {
+        model->threadExec().run(funcptr, tiles);
+    } else {
+        for (int i=0;i<tiles.size();++i)
+            (*funcptr)(tiles[i]);
+    }
+    for (int i=0;i<tiles.size();++i)
+        if (!tiles[i].error.isEmpty())
+            throw IException(tiles[i].error);
+}
+
+// the variable 'x' (apply(), sum()) is the first variable of the expression.
+// Each tile uses its own variable space (the expression itself is not modified).
+static void nc_applyTile(GridTile &tile)
+{
+    double vars[EXPRNLOCALVARS] = {0.};
+    try {
+        for (int i=tile.from; i<tile.to; ++i) {
+            vars[0] = tile.values[i];
+            tile.values[i] = tile.expr->execute(vars);
+        }
+    } catch (const IException &e) {
+        tile.error = e.message();
+    }
+}
+
+// evaluate the expression for each cell (the values are summed up in cell order by sum())
+static void nc_sumTile(GridTile &tile)
+{
+    double vars[EXPRNLOCALVARS] = {0.};
+    try {
+        for (int i=tile.from; i<tile.to; ++i) {
+            vars[0] = tile.values[i];
+            tile.results[i] = tile.expr->execute(vars);
+        }
+    } catch (const IException &e) {
+        tile.error = e.message();
+    }
+}
+
+// the variables of the expression are the names of the input grids (same order)
+static void nc_combineTile(GridTile &tile)
+{
+    double vars[EXPRNLOCALVARS] = {0.};
+    const int n = tile.sources.size();
+    const double * const *src = tile.sources.constData();
+    try {
+        for (int i=tile.from; i<tile.to; ++i) {
+            for (int v=0; v<n; ++v)
+                vars[v] = src[v][i];
+            tile.values[i] = tile.expr->execute(vars);
+        }
+    } catch (const IException &e) {
+        tile.error = e.message();
+    }
+}
+
+static void nc_resampleTile(GridTile &tile)
+{
+    for (int i=tile.from; i<tile.to; ++i) {
+        QPointF p = tile.target->cellCenterPoint(i);
+        if (tile.source->coordValid(p))
+            tile.target->valueAtIndex(i) = tile.source->constValueAt(p);
+        else
+            tile.target->valueAtIndex(i) = 0.; // should be NA
+    }
+}
+
+// averaging of factor x factor cells (same order of summation as Grid::averaged())
+static void nc_aggregateTile(GridTile &tile)
+{
+    const Grid<double> *src = tile.source;
+    const int f = tile.factor;
+    const double fsquare = f*f;
+    for (int i=tile.from; i<tile.to; ++i) {
+        QPoint t = tile.target->indexOf(i);
+        double sum = 0.;
+        for (int x=t.x()*f; x<std::min((t.x()+1)*f, src->sizeX()); ++x)
+            for (int y=t.y()*f; y<std::min((t.y()+1)*f, src->sizeY()); ++y)
+                sum += src->constValueAtIndex(x, y);
+        tile.target->valueAtIndex(i) = sum / fsquare;
+    }
+}
+
+// trees of a single resource unit for sumTrees()
+struct TreeSumJob {
+    ResourceUnit *ru;
+    const Expression *expr;
+    const Expression *filter; ///< null if no filter is used
+    const Grid<double> *grid;
+    QVector< QPair<int, double> > values; ///< grid index and value of each tree
+    QString error;
+};
+
+static void nc_sumTreesRU(TreeSumJob &job)
+{
+    TreeWrapper tw;
+    double vars[EXPRNLOCALVARS] = {0.};
+    const Grid<double> *grid = job.grid;
+    try {
+        QVector<Tree> &trees = job.ru->trees();
+        for (int i=0;i<trees.size();++i) {
+            const Tree &t = trees[i];
+            // only trees on the grid area:
+            if (!grid->coordValid(t.position()))
+                continue;
+            tw.setTree(&t);
+            if (job.filter && !job.filter->execute(vars, &tw))
+                continue;
+            QPoint idx = grid->indexAt(t.position());
+            job.values.push_back(QPair<int, double>(idx.y()*grid->sizeX() + idx.x(), job.expr->execute(vars, &tw)));
+        }
+    } catch (const IException &e) {
+        job.error = e.message();
+    }
+}
+
 ScriptGrid::ScriptGrid(QObject *parent) : QObject(parent)
 {
     mGrid = nullptr;
@@ -177,7 +333,7 @@ void ScriptGrid::apply(QString expression)
         return;
 
     Expression expr;
-    double *varptr = expr.addVar(mVariableName);
+    expr.addVar(mVariableName); // the first variable of the expression (see nc_applyTile())
     try {
         expr.setExpression(expression);
         expr.parse();
@@ -187,9 +343,15 @@ void ScriptGrid::apply(QString expression)
     }
 
     // now apply function on grid
-    for (double *p = mGrid->begin(); p!=mGrid->end(); ++p) {
-        *varptr = *p;
-        *p = expr.execute();
+    QVector<GridTile> tiles = createTiles(mGrid->sizeX(), mGrid->sizeY());
+    for (int i=0;i<tiles.size();++i) {
+        tiles[i].expr = &expr;
+        tiles[i].values = mGrid->begin();
+    }
+    try {
+        runTiles(nc_applyTile, tiles, expr.isOrderDependent());
+    } catch(const IException &e) {
+        qDebug() << "JS - grid:apply(): ERROR: " << e.message();
     }
 
 }
@@ -231,13 +393,20 @@ void ScriptGrid::combine(QString expression, QJSValue grid_object)
         return;
     }
 
-    // now apply function on grid
-    for (int i=0;i<mGrid->count();++i) {
-        // set variable values in the expression object
-        for (int v=0;v<names.count();++v)
-            *vars[v] = grids[v]->valueAtIndex(i);
-        double result = expr.execute();
-        mGrid->valueAtIndex(i) = result; // write back value
+    // now apply function on grid: the input grids are read directly (the variable 'i' has the index 'i')
+    QVector<const double*> sources;
+    for (int v=0;v<names.count();++v)
+        sources.push_back(grids[v]->begin());
+    QVector<GridTile> tiles = createTiles(mGrid->sizeX(), mGrid->sizeY());
+    for (int i=0;i<tiles.size();++i) {
+        tiles[i].expr = &expr;
+        tiles[i].values = mGrid->begin();
+        tiles[i].sources = sources;
+    }
+    try {
+        runTiles(nc_combineTile, tiles, expr.isOrderDependent());
+    } catch(const IException &e) {
+        qDebug() << "JS - grid:combine(): expression ERROR: " << e.message();
     }
 }
 
@@ -253,14 +422,12 @@ QJSValue ScriptGrid::resample(QJSValue grid_object)
         Grid<double> *src = qobject_cast<ScriptGrid*>(o)->grid();
         Grid<double> *new_grid = new Grid<double>(src->metricRect(), src->cellsize());
         // now copy content for all cells of the new grid:
-        QPointF p;
-        for (int i=0;i<new_grid->count();++i) {
-            p=new_grid->cellCenterPoint(i);
-            if (mGrid->coordValid(p))
-                (*new_grid)[i] = (*mGrid)[p];
-            else
-                (*new_grid)[i] = 0.; // should be NA
+        QVector<GridTile> tiles = createTiles(new_grid->sizeX(), new_grid->sizeY());
+        for (int i=0;i<tiles.size();++i) {
+            tiles[i].source = mGrid;
+            tiles[i].target = new_grid;
         }
+        runTiles(nc_resampleTile, tiles);
         // free the original grid...
         delete mGrid;
         mGrid = new_grid;
@@ -282,9 +449,17 @@ void ScriptGrid::aggregate(int factor)
     if (!mGrid) {
         throw IException("ERROR in ScriptGrid::aggregate(): not a valid grid!");
     }
-    Grid<double> res = mGrid->averaged(factor);
-    // make a copy on the heap
-    Grid<double> *new_grid = new Grid<double>(res);
+    if (factor<1)
+        throw IException("ERROR in ScriptGrid::aggregate(): invalid factor!");
+    Grid<double> *new_grid = new Grid<double>(mGrid->metricRect(), mGrid->cellsize()*factor);
+    // each cell of the new grid is the average of factor x factor cells (see also Grid::averaged())
+    QVector<GridTile> tiles = createTiles(new_grid->sizeX(), new_grid->sizeY());
+    for (int i=0;i<tiles.size();++i) {
+        tiles[i].source = mGrid;
+        tiles[i].target = new_grid;
+        tiles[i].factor = factor;
+    }
+    runTiles(nc_aggregateTile, tiles);
     // delete the old data, and use the new data instead
     delete mGrid;
     mGrid = new_grid;
@@ -310,7 +485,7 @@ double ScriptGrid::sum(QString expression)
         return -1.;
 
     Expression expr;
-    double *varptr = expr.addVar(mVariableName);
+    expr.addVar(mVariableName); // the first variable of the expression (see nc_sumTile())
     try {
         expr.setExpression(expression);
         expr.parse();
@@ -319,12 +494,24 @@ double ScriptGrid::sum(QString expression)
         return -1.;
     }
 
-    // now apply function on grid
-    double sum = 0.;
-    for (double *p = mGrid->begin(); p!=mGrid->end(); ++p) {
-        *varptr = *p;
-        sum += expr.execute();
+    // now apply function on grid: the expression is evaluated in parallel tiles, and the values
+    // are summed up in cell order (i.e. the same result as a single loop over all cells).
+    QVector<double> results(mGrid->count());
+    QVector<GridTile> tiles = createTiles(mGrid->sizeX(), mGrid->sizeY());
+    for (int i=0;i<tiles.size();++i) {
+        tiles[i].expr = &expr;
+        tiles[i].values = mGrid->begin();
+        tiles[i].results = results.data();
     }
+    try {
+        runTiles(nc_sumTile, tiles, expr.isOrderDependent());
+    } catch(const IException &e) {
+        qDebug() << "JS - grid:sum(): ERROR: " << e.message();
+        return -1.;
+    }
+    double sum = 0.;
+    for (int i=0;i<results.size();++i)
+        sum += results[i];
     return sum;
 }
 
@@ -342,26 +529,38 @@ void ScriptGrid::sumTrees(QString expression, QString filter)
         custom_expr.setExpression(expression);
         custom_expr.setModelObject(&tw);
 
+        custom_expr.parse(&tw);
+
         Expression filterexpr;
         bool do_filter = !filter.isEmpty();
         filterexpr.setExpression(filter);
         filterexpr.setModelObject(&tw);
-
-        AllTreeIterator ati(GlobalSettings::instance()->model());
-        while (Tree *t = ati.next()) {
-
-            // only trees on the grid area:
-            if (!mGrid->coordValid(t->position()))
+        if (do_filter)
+            filterexpr.parse(&tw);
+
+        // evaluate trees per resource unit (in parallel), and add the values to the grid
+        // in the order of resource units and trees
+        Model *model = GlobalSettings::instance()->model();
+        QVector<TreeSumJob> jobs;
+        foreach(ResourceUnit *ru, model->ruList()) {
+            if (ru->trees().isEmpty())
                 continue;
-
-            // apply filter
-            tw.setTree(t);
-            if (do_filter && !filterexpr.execute())
-                continue;
-
-            // calculate
-            double val=custom_expr.execute();
-            mGrid->valueAt(t->position()) += val;
+            TreeSumJob job;
+            job.ru = ru;
+            job.expr = &custom_expr;
+            job.filter = do_filter ? &filterexpr : nullptr;
+            job.grid = mGrid;
+            jobs.push_back(job);
+        }
+        bool serial = custom_expr.isOrderDependent() || (do_filter && filterexpr.isOrderDependent());
+        model->threadExec().run(nc_sumTreesRU, jobs, serial);
+
+        for (int j=0;j<jobs.size();++j) {
+            if (!jobs[j].error.isEmpty())
+                throw IException(jobs[j].error);
+            const QVector< QPair<int, double> > &values = jobs[j].values;
+            for (int i=0;i<values.size();++i)
+                mGrid->valueAtIndex(values[i].first) += values[i].second;
         }
 
     } catch(const IException &e) {
@@ -25,6 +25,7 @@
 #include "helper.h"
 #include "resourceunit.h"
 #include "scriptgrid.h"
+#include "patchlabeler.h"
 
 #include <QJSEngine>
 #include <QJSValue>
@@ -51,80 +52,22 @@ double SpatialAnalysis::rumpleIndexFullArea()
 /// extract patches (clumps) from the grid 'src'.
 /// Patches are defined as adjacent pixels (8-neighborhood)
 /// Return: vector with number of pixels per patch (first element: patch 1, second element: patch 2, ...)
+/// The labelling uses a (parallel) union-find algorithm (see PatchLabeler); patch ids are
+/// ordered by the first pixel of a patch (as with the previously used flood fill).
 QList<int> SpatialAnalysis::extractPatches(Grid<double> &src, int min_size, QString fileName)
 {
-    mClumpGrid.setup(src.metricRect(), src.cellsize());
-    mClumpGrid.wipe();
+    PatchLabeler labeler;
+    int n_patches = labeler.label(src, mClumpGrid, min_size, PatchLabeler::Neighbors8);
 
-    // now loop over all pixels and run a floodfill algorithm
-    QPoint start;
-    QQueue<QPoint> pqueue; // for the flood fill algorithm
     QList<int> counts;
-    int patch_index = 0;
     int total_size = 0;
-    int patches_skipped = 0;
-    for (int i=0;i<src.count();++i) {
-        if (src[i]>0. && mClumpGrid[i]==0) {
-            start = src.indexOf(i);
-            pqueue.clear();
-            patch_index++;
-
-            // quick and dirty implementation of the flood fill algroithm.
-            // based on: http://en.wikipedia.org/wiki/Flood_fill
-            // returns the number of pixels colored
-
-            pqueue.enqueue(start);
-            int found = 0;
-            while (!pqueue.isEmpty()) {
-                QPoint p = pqueue.dequeue();
-                if (!src.isIndexValid(p))
-                    continue;
-                if (src.valueAtIndex(p)>0. && mClumpGrid.valueAtIndex(p) == 0) {
-                    mClumpGrid.valueAtIndex(p) = patch_index;
-                    pqueue.enqueue(p+QPoint(-1,0));
-                    pqueue.enqueue(p+QPoint(1,0));
-                    pqueue.enqueue(p+QPoint(0,-1));
-                    pqueue.enqueue(p+QPoint(0,1));
-                    pqueue.enqueue(p+QPoint(1,1));
-                    pqueue.enqueue(p+QPoint(-1,1));
-                    pqueue.enqueue(p+QPoint(-1,-1));
-                    pqueue.enqueue(p+QPoint(1,-1));
-                    ++found;
-                }
-            }
-            if (found<min_size) {
-                // delete the patch again
-                pqueue.enqueue(start);
-                while (!pqueue.isEmpty()) {
-                    QPoint p = pqueue.dequeue();
-                    if (!src.isIndexValid(p))
-                        continue;
-                    if (mClumpGrid.valueAtIndex(p) == patch_index) {
-                        mClumpGrid.valueAtIndex(p) = -1;
-                        pqueue.enqueue(p+QPoint(-1,0));
-                        pqueue.enqueue(p+QPoint(1,0));
-                        pqueue.enqueue(p+QPoint(0,-1));
-                        pqueue.enqueue(p+QPoint(0,1));
-                        pqueue.enqueue(p+QPoint(1,1));
-                        pqueue.enqueue(p+QPoint(-1,1));
-                        pqueue.enqueue(p+QPoint(-1,-1));
-                        pqueue.enqueue(p+QPoint(1,-1));
-                    }
-                }
-                --patch_index;
-                patches_skipped++;
-
-            } else {
-                // save the patch in the result
-                counts.push_back(found);
-                total_size+=found;
-            }
-        }
+    mLastPatchList = labeler.patches();
+    for (int i=0;i<mLastPatchList.size();++i) {
+        counts.push_back(mLastPatchList[i].area);
+        total_size += mLastPatchList[i].area;
     }
-    // remove the -1 again...
-    mClumpGrid.limit(0,999999);
 
-    qDebug() << "extractPatches: found" << patch_index << "patches, total valid pixels:" << total_size << "skipped" << patches_skipped;
+    qDebug() << "extractPatches: found" << n_patches << "patches, total valid pixels:" << total_size << "skipped" << labeler.patchesSkipped();
     if (!fileName.isEmpty()) {
         qDebug() << "extractPatches: save to file:" << GlobalSettings::instance()->path(fileName);
         Helper::saveToTextFile(GlobalSettings::instance()->path(fileName), gridToESRIRaster(mClumpGrid) );
@@ -21,6 +21,7 @@
 ********************************************************************************************/
 #include "grid.h"
 #include "layeredgrid.h"
+#include "patchlabeler.h"
 
 #include <QObject>
 #include <QJSValue>
@@ -48,6 +49,8 @@ public:
     /// the number of pixels for each patch-id
     QList<int> extractPatches(Grid<double> &src, int min_size, QString fileName);
     QList<int> patchsizes() const { return mLastPatches; }
+    /// area, bounding box and centroid of the patches of the last call to extractPatches()
+    const QVector<PatchLabeler::Patch> &patchList() const { return mLastPatchList; }
 
     static void runCrownProjection2m(FloatGrid *agrid=nullptr); ///< internal function that prepares crown cover for the whole landscape
 
@@ -67,6 +70,7 @@ private:
     FloatGrid mCrownCoverGrid;
     Grid<int> mClumpGrid;
     QList<int> mLastPatches;
+    QVector<PatchLabeler::Patch> mLastPatchList;
     friend class SpatialLayeredGrid;
 
 };
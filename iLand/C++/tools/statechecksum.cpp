@@ -0,0 +1,329 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "statechecksum.h"
+
+#include "globalsettings.h"
+#include "xmlhelper.h"
+#include "model.h"
+#include "resourceunit.h"
+#include "tree.h"
+#include "species.h"
+#include "saplings.h"
+#include "soil.h"
+#include "snag.h"
+#include "randomgenerator.h"
+#include "threadrunner.h"
+
+#include <cstring>
+
+// static members
+bool StateChecksum::mEnabled = false;
+bool StateChecksum::mPerResourceUnit = true;
+QFile *StateChecksum::mFile = nullptr;
+
+namespace {
+// finalizer of splitmix64: a cheap hash with good avalanche behavior
+inline quint64 mix(quint64 x)
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+// add the value 'v' to the hash 'h' of a single element (the order of the fields matters)
+inline quint64 combine(const quint64 h, const quint64 v) { return mix(h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2))); }
+inline quint64 bits(const float v) { quint32 u; memcpy(&u, &v, 4); return u; }
+inline quint64 bits(const double v) { quint64 u; memcpy(&u, &v, 8); return u; }
+
+// the hash of a grid cell includes the position of the cell (i.e. a shifted pattern has a different checksum)
+inline quint64 lifCell(const FloatGrid *grid, const int x, const int y)
+{
+    return combine(mix(static_cast<quint64>(y)*grid->sizeX() + x), bits(grid->constValueAtIndex(x, y)));
+}
+inline quint64 heightCell(const HeightGrid *grid, const int x, const int y)
+{
+    const HeightGridValue &v = grid->constValueAtIndex(x, y);
+    quint64 h = combine(mix(static_cast<quint64>(y)*grid->sizeX() + x), bits(v.height));
+    h = combine(h, static_cast<quint64>(v.count()));
+    return combine(h, (v.isValid() ? 1 : 0) | (v.isForestOutside() ? 2 : 0));
+}
+
+quint64 treeHash(const Tree &t)
+{
+    quint64 h = mix(static_cast<quint64>(t.id()));
+    h = combine(h, static_cast<quint64>(t.species()->index()));
+    h = combine(h, (static_cast<quint64>(t.positionIndex().x()) << 32) | static_cast<quint32>(t.positionIndex().y()));
+    h = combine(h, bits(t.dbh()));
+    h = combine(h, bits(t.height()));
+    h = combine(h, bits(t.lightResourceIndex()));
+    h = combine(h, bits(t.leafArea()));
+    h = combine(h, bits(t.stressIndex()));
+    h = combine(h, bits(t.biomassFoliage()));
+    h = combine(h, bits(t.biomassStem()));
+    h = combine(h, bits(t.biomassCoarseRoot()));
+    h = combine(h, bits(t.biomassFineRoot()));
+    h = combine(h, static_cast<quint64>(t.age()));
+    return combine(h, t.isDead() ? 1 : 0);
+}
+
+// the fields are hashed individually (the structs contain padding bytes)
+quint64 saplingCellHash(const SaplingCell &cell, const int index)
+{
+    quint64 h = combine(mix(static_cast<quint64>(index)), static_cast<quint64>(cell.state));
+    for (int i=0;i<NSAPCELLS;++i) {
+        const SaplingTree &s = cell.saplings[i];
+        h = combine(h, bits(s.height));
+        h = combine(h, static_cast<quint64>(s.age));
+        h = combine(h, static_cast<quint64>(static_cast<quint16>(s.species_index)));
+        h = combine(h, (static_cast<quint64>(s.stress_years) << 8) | s.flags);
+    }
+    return h;
+}
+
+quint64 cnHash(quint64 h, const CNPair &p) { return combine(combine(h, bits(p.C)), bits(p.N)); }
+quint64 cnHash(quint64 h, const CNPool &p) { return combine(cnHash(h, static_cast<const CNPair&>(p)), bits(p.parameter())); }
+} // namespace
+
+void StateChecksum::setup(const XmlHelper &xml)
+{
+    finalize(); // close a previous log (if any)
+    mEnabled = xml.valueBool("system.settings.checksums.enabled", false);
+    mPerResourceUnit = xml.valueBool("system.settings.checksums.resourceUnits", true);
+    if (!mEnabled)
+        return;
+
+    const QString file_name = GlobalSettings::instance()->path(xml.value("system.settings.checksums.file", "checksums.txt"), "output");
+    mFile = new QFile(file_name);
+    if (!mFile->open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        delete mFile; mFile = nullptr;
+        mEnabled = false;
+        throw IException(QString("StateChecksum: cannot create the checksum file '%1'.").arg(file_name));
+    }
+    mFile->write("# iLand state checksums\n# year phase component ru_index ru_id checksum\n");
+    qDebug() << "State checksums enabled, file:" << file_name << "(per resource unit:" << mPerResourceUnit << ")";
+}
+
+void StateChecksum::finalize()
+{
+    if (mFile) {
+        mFile->close();
+        delete mFile;
+        mFile = nullptr;
+    }
+    mEnabled = false;
+}
+
+QString StateChecksum::phaseName(const Phase phase)
+{
+    switch (phase) {
+    case ApplyPattern: return "applyPattern";
+    case ReadPattern: return "readPattern";
+    case Grow: return "grow";
+    case Regeneration: return "regeneration";
+    case CarbonCycle: return "carbonCycle";
+    case YearEnd: return "yearEnd";
+    }
+    return "invalid";
+}
+
+void StateChecksum::writeLine(const int year, const QString &phase, const char *component, const int ru_index, const int ru_id, const quint64 hash)
+{
+    mFile->write(QString("%1 %2 %3 %4 %5 %6\n").arg(year).arg(phase).arg(component).arg(ru_index).arg(ru_id)
+                 .arg(hash, 16, 16, QChar('0')).toLatin1());
+}
+
+void StateChecksum::ruJob(RUJob &job)
+{
+    ResourceUnit *ru = job.ru;
+    job.hash[0] = job.hash[1] = 0;
+    Model *model = GlobalSettings::instance()->model();
+    switch (job.phase) {
+    case ApplyPattern: {
+        // the cells of the RU (LIF: 50x50 cells, height grid: 10x10 cells)
+        const FloatGrid *lif = model->grid();
+        const HeightGrid *hg = model->heightGrid();
+        const QPoint o = lif->indexAt(ru->boundingBox().topLeft());
+        for (int y=0;y<cPxPerRU;++y)
+            for (int x=0;x<cPxPerRU;++x)
+                job.hash[0] += lifCell(lif, o.x()+x, o.y()+y);
+        const QPoint oh = hg->indexAt(ru->boundingBox().topLeft());
+        for (int y=0;y<cHeightPerRU;++y)
+            for (int x=0;x<cHeightPerRU;++x)
+                job.hash[1] += heightCell(hg, oh.x()+x, oh.y()+y);
+        break;
+    }
+    case ReadPattern:
+    case Grow:
+    case YearEnd: {
+        const QVector<Tree> &trees = ru->constTrees();
+        for (int i=0;i<trees.size();++i)
+            job.hash[0] += treeHash(trees[i]);
+        break;
+    }
+    case Regeneration: {
+        const SaplingCell *cells = ru->saplingCellArray();
+        if (cells)
+            for (int i=0;i<cPxPerHectare;++i)
+                job.hash[0] += saplingCellHash(cells[i], i);
+        break;
+    }
+    case CarbonCycle: {
+        if (const Soil *soil = ru->soil()) {
+            quint64 h = cnHash(mix(1), soil->youngLabile());
+            h = cnHash(h, soil->youngRefractory());
+            h = cnHash(h, soil->oldOrganicMatter());
+            job.hash[0] = combine(h, bits(soil->availableNitrogen()));
+        }
+        if (const Snag *snag = ru->snag()) {
+            quint64 h = combine(mix(2), bits(snag->totalCarbon()));
+            h = cnHash(h, snag->totalSWD());
+            h = cnHash(h, snag->totalOtherWood());
+            h = cnHash(h, snag->labileFlux());
+            job.hash[1] = cnHash(h, snag->refractoryFlux());
+        }
+        break;
+    }
+    }
+}
+
+void StateChecksum::record(const Phase phase)
+{
+    if (!mEnabled || !mFile)
+        return;
+    Model *model = GlobalSettings::instance()->model();
+    const int year = GlobalSettings::instance()->currentYear();
+    const QString phase_name = phaseName(phase);
+
+    QVector<RUJob> jobs;
+    jobs.reserve(model->ruList().size());
+    foreach(ResourceUnit *ru, model->ruList()) {
+        RUJob job = { ru, phase, {0, 0} };
+        jobs.push_back(job);
+    }
+    model->threadExec().run(ruJob, jobs);
+
+    // the components of the phase
+    const char *components[2] = { nullptr, nullptr };
+    switch (phase) {
+    case ApplyPattern: components[0] = "lif"; components[1] = "height"; break;
+    case Regeneration: components[0] = "saplings"; break;
+    case CarbonCycle: components[0] = "soil"; components[1] = "snags"; break;
+    default: components[0] = "trees"; break;
+    }
+
+    for (int c=0;c<2;++c) {
+        if (!components[c])
+            continue;
+        // total: grids are hashed as a whole (including the buffer around the project area), otherwise the sum over RUs
+        quint64 total = 0;
+        if (phase==ApplyPattern && c==0) {
+            const FloatGrid *lif = model->grid();
+            for (int y=0;y<lif->sizeY();++y)
+                for (int x=0;x<lif->sizeX();++x)
+                    total += lifCell(lif, x, y);
+        } else if (phase==ApplyPattern && c==1) {
+            const HeightGrid *hg = model->heightGrid();
+            for (int y=0;y<hg->sizeY();++y)
+                for (int x=0;x<hg->sizeX();++x)
+                    total += heightCell(hg, x, y);
+        } else {
+            for (int i=0;i<jobs.size();++i)
+                total += jobs[i].hash[c];
+        }
+        writeLine(year, phase_name, components[c], -1, -1, total);
+        if (mPerResourceUnit)
+            for (int i=0;i<jobs.size();++i)
+                writeLine(year, phase_name, components[c], jobs[i].ru->index(), jobs[i].ru->id(), jobs[i].hash[c]);
+    }
+
+    // position of the random number generator (number of random numbers drawn so far)
+    writeLine(year, phase_name, "rng", -1, -1, static_cast<quint64>(RandomGenerator::debugNRandomNumbers()));
+    mFile->flush();
+}
+
+namespace {
+struct ChecksumLine {
+    int line; ///< line number in the file
+    QString key; ///< year, phase, component, RU index
+    QStringList fields;
+    quint64 hash;
+    bool isTotal() const { return fields[3]=="-1"; }
+    QString block() const { return fields[0] + " " + fields[1] + " " + fields[2]; } ///< year, phase, component
+};
+
+QVector<ChecksumLine> loadChecksums(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        throw IException(QString("StateChecksum: cannot open the checksum file '%1'.").arg(fileName));
+    QVector<ChecksumLine> lines;
+    int line_no = 0;
+    while (!file.atEnd()) {
+        const QString line = QString::fromLatin1(file.readLine()).trimmed();
+        ++line_no;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        ChecksumLine cl;
+        cl.line = line_no;
+        cl.fields = line.split(' ', Qt::SkipEmptyParts);
+        if (cl.fields.size()!=6)
+            throw IException(QString("StateChecksum: invalid line %1 in '%2'.").arg(line_no).arg(fileName));
+        cl.key = cl.fields.mid(0, 4).join(' ');
+        bool ok;
+        cl.hash = cl.fields[5].toULongLong(&ok, 16);
+        if (!ok)
+            throw IException(QString("StateChecksum: invalid checksum in line %1 in '%2'.").arg(line_no).arg(fileName));
+        lines.push_back(cl);
+    }
+    return lines;
+}
+} // namespace
+
+QString StateChecksum::compare(const QString &fileName1, const QString &fileName2)
+{
+    const QVector<ChecksumLine> a = loadChecksums(fileName1);
+    const QVector<ChecksumLine> b = loadChecksums(fileName2);
+    const int n = qMin(a.size(), b.size());
+    for (int i=0;i<n;++i) {
+        if (a[i].key != b[i].key)
+            return QString("structural difference at line %1/%2: '%3' vs '%4' (different settings or number of resource units?)")
+                    .arg(a[i].line).arg(b[i].line).arg(a[i].key, b[i].key);
+        if (a[i].hash == b[i].hash)
+            continue;
+
+        const QStringList &f = a[i].fields;
+        QString result = QString("first difference: year %1, phase '%2', component '%3'").arg(f[0], f[1], f[2]);
+        if (a[i].isTotal()) {
+            // look for the first resource unit with a difference in the same block
+            for (int j=i+1; j<n && a[j].block()==a[i].block() && b[j].key==a[j].key; ++j)
+                if (a[j].hash != b[j].hash)
+                    return result + QString(", resource unit index %1 (id %2)").arg(a[j].fields[3], a[j].fields[4]);
+            if (f[2]=="lif" || f[2]=="height")
+                return result + " (outside of the resource units, i.e. in the buffer around the project area)";
+            return result + " (no resource unit level checksums available)";
+        }
+        return result + QString(", resource unit index %1 (id %2)").arg(f[3], f[4]);
+    }
+    if (a.size() != b.size())
+        return QString("the files are identical up to line %1, but '%2' has more checksums (%3 vs %4).")
+                .arg(n>0 ? a[n-1].line : 0).arg(a.size()>b.size() ? fileName1 : fileName2).arg(a.size()).arg(b.size());
+    return QString("identical (%1 checksums)").arg(n);
+}
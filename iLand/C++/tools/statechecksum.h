@@ -0,0 +1,76 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef STATECHECKSUM_H
+#define STATECHECKSUM_H
+#include <QtCore>
+
+class XmlHelper;
+class ResourceUnit;
+
+/** StateChecksum records checksums of the model state after the phases of a simulation year (verification mode).
+  @ingroup tools
+  The checksums allow to verify that a change (e.g. multithreading, a new allocator, an optimized kernel) does not
+  change the results: two runs with the same random seed are compared with compare(), which reports the first
+  phase, year and resource unit where the runs diverge.
+  Checksums are calculated for:
+  after applyPattern: the LIF grid ('lif') and the height grid ('height');
+  after readPattern and after growth: the state of the trees ('trees': id, position, dimensions, biomass, LRI, stress, ...);
+  after regeneration: the sapling cells ('saplings');
+  after the carbon cycle: the soil pools ('soil') and the snag pools ('snags');
+  at the end of the year (after disturbance modules and management): the trees;
+  in all phases: the position of the random number generator ('rng').
+  Each checksum is the sum of the hashes of the elements (cells, trees, ...), i.e. independent of the order of the elements
+  (and of the order of execution in multithreaded code). A checksum is recorded for each resource unit and as total
+  for the landscape (grids: including the buffer around the project area).
+  The log is a text file with one line per checksum: year, phase, component, RU index (-1: total), RU id, checksum (hex).
+
+  Settings (project file, system.settings.checksums):
+  enabled: true/false (default: false)
+  file: file name of the log (default: checksums.txt in the 'output' folder)
+  resourceUnits: true (default): record checksums per resource unit; false: only totals
+  */
+class StateChecksum
+{
+public:
+    enum Phase { ApplyPattern, ReadPattern, Grow, Regeneration, CarbonCycle, YearEnd };
+    static void setup(const XmlHelper &xml);
+    static bool enabled() { return mEnabled; }
+    /// calculate and write the checksums for 'phase' (no worker threads must be active)
+    static void record(const Phase phase);
+    /// close the log file
+    static void finalize();
+
+    /// compare two checksum logs and return a report of the first difference (or that the logs are identical)
+    static QString compare(const QString &fileName1, const QString &fileName2);
+    static QString phaseName(const Phase phase);
+private:
+    struct RUJob {
+        ResourceUnit *ru;
+        Phase phase;
+        quint64 hash[2];
+    };
+    static void ruJob(RUJob &job);
+    static void writeLine(const int year, const QString &phase, const char *component, const int ru_index, const int ru_id, const quint64 hash);
+    static bool mEnabled;
+    static bool mPerResourceUnit;
+    static QFile *mFile;
+};
+
+#endif // STATECHECKSUM_H
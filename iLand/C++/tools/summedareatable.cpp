@@ -0,0 +1,210 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "summedareatable.h"
+
+#include "globalsettings.h"
+#include "model.h"
+#include "threadrunner.h"
+
+// helper struct for the parallel setup of the integral images
+struct SATBuildChunk {
+    int from, to; // rows (pass 1) or columns (pass 2), [from, to)
+    const FloatGrid *source;
+    Grid<double> *sum;
+    Grid<double> *sum2;
+};
+
+// pass 1: cumulative sums along each row
+static void nc_sat_rows(SATBuildChunk &chunk)
+{
+    const int nx = chunk.source->sizeX();
+    for (int y=chunk.from; y<chunk.to; ++y) {
+        const float *src = chunk.source->begin() + y*nx;
+        double *s = chunk.sum->ptr(0, y);
+        double *s2 = chunk.sum2->ptr(0, y);
+        double acc=0., acc2=0.;
+        for (int x=0; x<nx; ++x) {
+            const double v = src[x];
+            acc += v; acc2 += v*v;
+            s[x] = acc; s2[x] = acc2;
+        }
+    }
+}
+
+// pass 2: cumulative sums along the columns (of the row sums)
+static void nc_sat_cols(SATBuildChunk &chunk)
+{
+    const int nx = chunk.sum->sizeX();
+    const int ny = chunk.sum->sizeY();
+    for (int y=1; y<ny; ++y) {
+        double *s = chunk.sum->ptr(0, y);
+        double *s2 = chunk.sum2->ptr(0, y);
+        for (int x=chunk.from; x<chunk.to; ++x) {
+            s[x] += s[x-nx];
+            s2[x] += s2[x-nx];
+        }
+    }
+}
+
+// run 'funcptr' for all chunks, either via the ThreadRunner of the model or serially
+template<class T>
+static void runChunks(void (*funcptr)(T&), QVector<T> &chunks)
+{
+    if (GlobalSettings::instance()->model()) {
+        GlobalSettings::instance()->model()->threadExec().run(funcptr, chunks);
+    } else {
+        for (int i=0;i<chunks.size();++i)
+            (*funcptr)(chunks[i]);
+    }
+}
+
+void SummedAreaTable::setup(const FloatGrid &source)
+{
+    mSizeX = source.sizeX();
+    mSizeY = source.sizeY();
+    mSum.setup(source.metricRect(), source.cellsize());
+    mSum2.setup(source.metricRect(), source.cellsize());
+    if (source.isEmpty())
+        return;
+
+    QVector<SATBuildChunk> chunks;
+    QVector<QPair<int,int> > rows = NeighborhoodStatistics::rowTiles(mSizeY);
+    for (int i=0;i<rows.size();++i) {
+        SATBuildChunk c = { rows[i].first, rows[i].second, &source, &mSum, &mSum2 };
+        chunks.push_back(c);
+    }
+    runChunks(nc_sat_rows, chunks);
+
+    // the columns are processed in blocks (rows are still traversed sequentially within a block)
+    chunks.clear();
+    QVector<QPair<int,int> > cols = NeighborhoodStatistics::rowTiles(mSizeX, 64);
+    for (int i=0;i<cols.size();++i) {
+        SATBuildChunk c = { cols[i].first, cols[i].second, &source, &mSum, &mSum2 };
+        chunks.push_back(c);
+    }
+    runChunks(nc_sat_cols, chunks);
+}
+
+double SummedAreaTable::mean(int x0, int y0, int x1, int y1) const
+{
+    if (!clip(x0, y0, x1, y1))
+        return 0.;
+    const int n = (x1-x0+1)*(y1-y0+1);
+    return rectSum(mSum, x0, y0, x1, y1) / n;
+}
+
+double SummedAreaTable::variance(int x0, int y0, int x1, int y1) const
+{
+    if (!clip(x0, y0, x1, y1))
+        return 0.;
+    const double n = (x1-x0+1)*(y1-y0+1);
+    double m = rectSum(mSum, x0, y0, x1, y1) / n;
+    double m2 = rectSum(mSum2, x0, y0, x1, y1) / n;
+    return std::max(m2 - m*m, 0.); // avoid tiny negative values due to rounding
+}
+
+double SummedAreaTable::annulusMean(const QPoint &center, int inner_radius, int outer_radius) const
+{
+    int x0=center.x()-outer_radius, y0=center.y()-outer_radius, x1=center.x()+outer_radius, y1=center.y()+outer_radius;
+    int ix0=center.x()-inner_radius, iy0=center.y()-inner_radius, ix1=center.x()+inner_radius, iy1=center.y()+inner_radius;
+    double s = sum(x0, y0, x1, y1) - sum(ix0, iy0, ix1, iy1);
+    int n = count(x0, y0, x1, y1) - count(ix0, iy0, ix1, iy1);
+    return n>0 ? s / n : 0.;
+}
+
+double SummedAreaTable::diskSum(const QPoint &center, int radius, int &rCount, int max_offset) const
+{
+    max_offset = std::min(max_offset, radius);
+    const int r2 = radius*radius;
+    double s = 0.;
+    rCount = 0;
+    for (int dy=-radius; dy<=max_offset; ++dy) {
+        int y = center.y() + dy;
+        if (y<0 || y>=mSizeY)
+            continue;
+        // half width of the disk in row dy: largest w with w^2 <= r^2-dy^2
+        int rest = r2 - dy*dy;
+        int w = static_cast<int>(sqrt(static_cast<double>(rest)));
+        while (w*w > rest) --w;
+        while ((w+1)*(w+1) <= rest) ++w;
+        int x0 = std::max(center.x() - w, 0);
+        int x1 = std::min(center.x() + std::min(w, max_offset), mSizeX-1);
+        if (x0>x1)
+            continue;
+        s += rectSum(mSum, x0, y, x1, y);
+        rCount += x1-x0+1;
+    }
+    return s;
+}
+
+QVector<QPair<int, int> > NeighborhoodStatistics::rowTiles(int size_y, int min_rows)
+{
+    QVector<QPair<int,int> > tiles;
+    // aim at a couple of tiles per thread to balance the load
+    int n_tiles = std::max(QThread::idealThreadCount()*4, 1);
+    int rows = std::max(min_rows, (size_y + n_tiles - 1) / n_tiles);
+    for (int y=0; y<size_y; y+=rows)
+        tiles.push_back(QPair<int,int>(y, std::min(y+rows, size_y)));
+    return tiles;
+}
+
+void NeighborhoodStatistics::calculate(FloatGrid &target, Statistic stat, int radius, int inner_radius) const
+{
+    if (target.sizeX()!=mSource.sizeX() || target.sizeY()!=mSource.sizeY())
+        target.setup(mSource.metricRect(), mSource.cellsize());
+
+    QVector<Tile> tiles;
+    QVector<QPair<int,int> > rows = rowTiles(mSource.sizeY());
+    for (int i=0;i<rows.size();++i) {
+        Tile t = { rows[i].first, rows[i].second, this, &target, stat, radius, inner_radius };
+        tiles.push_back(t);
+    }
+    runChunks(processTile, tiles);
+}
+
+void NeighborhoodStatistics::processTile(NeighborhoodStatistics::Tile &tile)
+{
+    const SummedAreaTable &sat = tile.stats->mTable;
+    const FloatGrid &src = tile.stats->mSource;
+    const int nx = src.sizeX();
+    const int r = tile.radius;
+    int n;
+    for (int y=tile.y_from; y<tile.y_to; ++y) {
+        float *p = tile.target->ptr(0, y);
+        for (int x=0; x<nx; ++x, ++p) {
+            switch (tile.stat) {
+            case BoxMean: *p = static_cast<float>(sat.mean(x-r, y-r, x+r, y+r)); break;
+            case BoxSum: *p = static_cast<float>(sat.sum(x-r, y-r, x+r, y+r)); break;
+            case BoxVariance: *p = static_cast<float>(sat.variance(x-r, y-r, x+r, y+r)); break;
+            case AnnulusMean: *p = static_cast<float>(sat.annulusMean(QPoint(x,y), tile.inner_radius, r)); break;
+            case DiskMean: {
+                double s = sat.diskSum(QPoint(x,y), r, n);
+                *p = n>0 ? static_cast<float>(s / n) : 0.f;
+                break; }
+            case TopographicPosition: {
+                // same window as the classic (brute force) TPI: offsets -r..r-1 within the circle
+                double s = sat.diskSum(QPoint(x,y), r, n, r-1);
+                *p = n>0 ? static_cast<float>(src.constValueAtIndex(x, y) - s / static_cast<double>(n)) : 0.f;
+                break; }
+            }
+        }
+    }
+}
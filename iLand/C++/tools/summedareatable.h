@@ -0,0 +1,116 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef SUMMEDAREATABLE_H
+#define SUMMEDAREATABLE_H
+#include "grid.h"
+
+/** SummedAreaTable is an integral image of a FloatGrid for neighborhood statistics.
+  @ingroup tools
+  The table stores for each cell (x/y) the sum (and the sum of squares) of all cells
+  with indices <= x and <= y. Sums over any rectangle of the source grid are then
+  available in O(1) (4 lookups), which makes box and annulus statistics independent
+  of the window size. Circular windows are evaluated row by row in O(radius).
+  All rectangles are given in indices (inclusive) and are clipped to the grid.
+  */
+class SummedAreaTable
+{
+public:
+    SummedAreaTable(): mSizeX(0), mSizeY(0) {}
+    SummedAreaTable(const FloatGrid &source) { setup(source); }
+    /// build the table from 'source' (multithreaded, if enabled)
+    void setup(const FloatGrid &source);
+    bool isEmpty() const { return mSum.isEmpty(); }
+    int sizeX() const { return mSizeX; }
+    int sizeY() const { return mSizeY; }
+
+    // rectangle queries (indices, inclusive, clipped to the grid)
+    /// sum of all cells in the rectangle (x0/y0) - (x1/y1)
+    double sum(int x0, int y0, int x1, int y1) const { if (!clip(x0,y0,x1,y1)) return 0.; return rectSum(mSum, x0, y0, x1, y1); }
+    /// sum of squared values in the rectangle
+    double sumSquares(int x0, int y0, int x1, int y1) const { if (!clip(x0,y0,x1,y1)) return 0.; return rectSum(mSum2, x0, y0, x1, y1); }
+    /// number of cells of the rectangle within the grid
+    int count(int x0, int y0, int x1, int y1) const { if (!clip(x0,y0,x1,y1)) return 0; return (x1-x0+1)*(y1-y0+1); }
+    double mean(int x0, int y0, int x1, int y1) const;
+    /// (population) variance of the cell values in the rectangle
+    double variance(int x0, int y0, int x1, int y1) const;
+
+    // windows around a center cell
+    /// mean of a square window with (2*radius+1)^2 cells centered on 'center'
+    double boxMean(const QPoint &center, int radius) const { return mean(center.x()-radius, center.y()-radius, center.x()+radius, center.y()+radius); }
+    double boxVariance(const QPoint &center, int radius) const { return variance(center.x()-radius, center.y()-radius, center.x()+radius, center.y()+radius); }
+    /// mean of the square ring between 'inner_radius' (exclusive) and 'outer_radius' (inclusive)
+    double annulusMean(const QPoint &center, int inner_radius, int outer_radius) const;
+    /// sum of the cells (dx,dy) with dx^2+dy^2 <= radius^2 and dx,dy in [-radius, max_offset]
+    /// 'max_offset' is limited to 'radius' (symmetric disk). Returns the sum and the number of cells in 'rCount'.
+    double diskSum(const QPoint &center, int radius, int &rCount, int max_offset=std::numeric_limits<int>::max()) const;
+
+private:
+    bool clip(int &x0, int &y0, int &x1, int &y1) const {
+        x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+        x1 = std::min(x1, mSizeX-1); y1 = std::min(y1, mSizeY-1);
+        return x0<=x1 && y0<=y1;
+    }
+    inline double at(const Grid<double> &g, int x, int y) const { return (x<0 || y<0) ? 0. : g.constValueAtIndex(x, y); }
+    inline double rectSum(const Grid<double> &g, int x0, int y0, int x1, int y1) const {
+        return at(g, x1, y1) - at(g, x0-1, y1) - at(g, x1, y0-1) + at(g, x0-1, y0-1);
+    }
+    Grid<double> mSum; ///< integral of values
+    Grid<double> mSum2; ///< integral of squared values
+    int mSizeX;
+    int mSizeY;
+    friend class NeighborhoodStatistics;
+};
+
+/** NeighborhoodStatistics calculates focal statistics for full grids.
+  @ingroup tools
+  The target grid is split into row tiles that are processed in parallel via the ThreadRunner.
+  Each result cell is derived from the SummedAreaTable of the source, i.e. the cost per
+  cell does not depend on the window size (except for circular windows: O(radius)).
+  */
+class NeighborhoodStatistics
+{
+public:
+    enum Statistic { BoxMean, BoxSum, BoxVariance, AnnulusMean, DiskMean, TopographicPosition };
+    NeighborhoodStatistics(const FloatGrid &source): mSource(source), mTable(source) {}
+    const SummedAreaTable &table() const { return mTable; }
+
+    /// fill 'target' (same size as source) with the statistic 'stat' evaluated for each cell.
+    /// 'radius' (and 'inner_radius' for AnnulusMean) are given in cells.
+    /// TopographicPosition: value of the cell minus the mean of the surrounding disk (see DEM::topographicPositionIndex()).
+    void calculate(FloatGrid &target, Statistic stat, int radius, int inner_radius=0) const;
+
+    /// a rectangular part of a grid that is processed by one thread
+    struct Tile {
+        int y_from, y_to; ///< rows [y_from, y_to)
+        const NeighborhoodStatistics *stats;
+        FloatGrid *target;
+        Statistic stat;
+        int radius;
+        int inner_radius;
+    };
+    /// split the rows of a grid with 'size_y' rows into tiles of at least 'min_rows' rows
+    static QVector<QPair<int,int> > rowTiles(int size_y, int min_rows=16);
+private:
+    static void processTile(Tile &tile);
+    const FloatGrid &mSource;
+    SummedAreaTable mTable;
+};
+
+#endif // SUMMEDAREATABLE_H
@@ -0,0 +1,190 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#include "global.h"
+#include "tracer.h"
+
+#include "globalsettings.h"
+#include "xmlhelper.h"
+#include "helper.h"
+
+// static members
+bool Tracer::mEnabled = false;
+bool Tracer::mPerResourceUnit = false;
+QElapsedTimer Tracer::mClock;
+QList<Tracer::Buffer*> Tracer::mBuffers;
+QHash<QByteArray, const char*> Tracer::mNames;
+QMap<QByteArray, Tracer::Summary> Tracer::mSummary;
+QFile *Tracer::mFile = nullptr;
+QString Tracer::mFileName;
+bool Tracer::mFirstEvent = true;
+
+static QMutex tracer_mutex; // used for registering buffers and names only
+static thread_local Tracer::Buffer *tls_trace_buffer = nullptr;
+
+void Tracer::setup(const XmlHelper &xml)
+{
+    finalize(); // close a previous trace (if any)
+    mEnabled = xml.valueBool("system.settings.trace.enabled", false);
+    mPerResourceUnit = xml.valueBool("system.settings.trace.perResourceUnit", false);
+    if (!mEnabled)
+        return;
+
+    mFileName = GlobalSettings::instance()->path(xml.value("system.settings.trace.file", "trace.json"), "temp");
+    mSummary.clear();
+    mFirstEvent = true;
+    mClock.start();
+    qDebug() << "Tracing enabled, trace file:" << mFileName << "(per resource unit:" << mPerResourceUnit << ")";
+}
+
+const char *Tracer::intern(const QString &name)
+{
+    QByteArray key = name.toUtf8();
+    QMutexLocker lock(&tracer_mutex);
+    QHash<QByteArray, const char*>::const_iterator it = mNames.constFind(key);
+    if (it != mNames.constEnd())
+        return it.value();
+    char *copy = new char[key.size()+1];
+    memcpy(copy, key.constData(), key.size()+1);
+    mNames.insert(key, copy);
+    return copy;
+}
+
+Tracer::Buffer *Tracer::threadBuffer()
+{
+    if (!tls_trace_buffer) {
+        QMutexLocker lock(&tracer_mutex);
+        Buffer *b = new Buffer;
+        b->thread_index = mBuffers.size();
+        b->depth = 0;
+        b->events.reserve(1024);
+        mBuffers.append(b);
+        tls_trace_buffer = b;
+    }
+    return tls_trace_buffer;
+}
+
+void TraceScope::begin(const char *name, int ru)
+{
+    mName = name;
+    mRU = ru;
+    mBuffer = Tracer::threadBuffer();
+    mBuffer->depth++;
+    mYear = GlobalSettings::instance()->currentYear();
+    mStart = Tracer::now();
+}
+
+void TraceScope::end()
+{
+    qint64 end_time = Tracer::now();
+    mBuffer->depth--;
+    Tracer::Event e = { mName, mStart, end_time - mStart, mYear, mRU, mBuffer->depth };
+    mBuffer->events.push_back(e);
+}
+
+static QByteArray escapeJson(const char *s)
+{
+    QByteArray r(s);
+    r.replace('\\', "\\\\");
+    r.replace('"', "\\\"");
+    return r;
+}
+
+void Tracer::flush()
+{
+    if (!mEnabled || mFileName.isEmpty())
+        return;
+    if (!mFile) {
+        mFile = new QFile(mFileName);
+        if (!mFile->open(QIODevice::WriteOnly | QIODevice::Text)) {
+            qWarning() << "Tracer: cannot open trace file" << mFileName << "- tracing disabled.";
+            delete mFile; mFile = nullptr;
+            mEnabled = false;
+            return;
+        }
+        mFile->write("{\"traceEvents\":[\n");
+        mFirstEvent = true;
+    }
+    QMutexLocker lock(&tracer_mutex);
+    QByteArray line;
+    for (int b=0; b<mBuffers.size(); ++b) {
+        Buffer *buf = mBuffers[b];
+        for (int i=0; i<buf->events.size(); ++i) {
+            const Event &e = buf->events[i];
+            // Chrome trace format: complete events ("X") with timestamps in microseconds
+            line = QByteArray(mFirstEvent ? "" : ",\n");
+            line += "{\"name\":\"" + escapeJson(e.name) + "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + QByteArray::number(buf->thread_index) +
+                    ",\"ts\":" + QByteArray::number(e.start/1000.,'f',3) +
+                    ",\"dur\":" + QByteArray::number(e.duration/1000.,'f',3) +
+                    ",\"args\":{\"year\":" + QByteArray::number(e.year);
+            if (e.ru>=0)
+                line += ",\"ru\":" + QByteArray::number(e.ru);
+            line += ",\"depth\":" + QByteArray::number(e.depth) + "}}";
+            mFile->write(line);
+            mFirstEvent = false;
+
+            // summary (aggregated over all threads)
+            Summary &s = mSummary[QByteArray(e.name)];
+            double ms = e.duration / 1000000.;
+            if (s.count==0) { s.total_ms = 0.; s.max_ms = 0.; s.max_year = e.year; }
+            s.count++;
+            s.total_ms += ms;
+            if (ms > s.max_ms) { s.max_ms = ms; s.max_year = e.year; }
+        }
+        buf->events.clear();
+    }
+    mFile->flush();
+}
+
+QHash<QString, double> Tracer::totals()
+{
+    QHash<QString, double> result;
+    for (QMap<QByteArray, Summary>::const_iterator it=mSummary.constBegin(); it!=mSummary.constEnd(); ++it)
+        result[QString::fromUtf8(it.key())] = it.value().total_ms;
+    return result;
+}
+
+void Tracer::finalize()
+{
+    if (!mEnabled)
+        return;
+    flush();
+    if (mFile) {
+        mFile->write("\n]}\n");
+        mFile->close();
+        delete mFile;
+        mFile = nullptr;
+    }
+
+    // flat summary per phase
+    QStringList lines;
+    lines << "name;count;total_ms;mean_ms;max_ms;max_year";
+    qDebug() << "Trace summary (per phase)\n=========================";
+    for (QMap<QByteArray, Summary>::const_iterator it=mSummary.constBegin(); it!=mSummary.constEnd(); ++it) {
+        const Summary &s = it.value();
+        lines << QString("%1;%2;%3;%4;%5;%6").arg(QString::fromUtf8(it.key())).arg(s.count)
+                 .arg(s.total_ms).arg(s.count>0 ? s.total_ms / s.count : 0.).arg(s.max_ms).arg(s.max_year);
+        qDebug() << it.key() << ": n=" << s.count << "total:" << s.total_ms << "ms, max:" << s.max_ms << "ms (year" << s.max_year << ")";
+    }
+    QString summary_file = mFileName;
+    summary_file.replace(QRegularExpression("\\.json$"), "");
+    Helper::saveToTextFile(summary_file + "_summary.csv", lines.join("\n"));
+    qDebug() << "Trace written to" << mFileName << "and" << summary_file + "_summary.csv";
+    mEnabled = false;
+}
@@ -0,0 +1,117 @@
+/********************************************************************************************
+**    iLand - an individual based forest landscape and disturbance model
+**    https://iland-model.org
+**    Copyright (C) 2009-  Werner Rammer, Rupert Seidl
+**
+**    This program is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    This program is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+********************************************************************************************/
+
+#ifndef TRACER_H
+#define TRACER_H
+#include <QtCore>
+#include <QElapsedTimer>
+
+class XmlHelper;
+
+/** Tracer is a low overhead tracing facility for the phases of a simulation year.
+  @ingroup tools
+  Scopes are recorded with the TraceScope class (or the TRACE_SCOPE() macro) into buffers that are local
+  to each thread, i.e. recording a scope does not require any locking. Each record stores the (static) name,
+  start time, duration, nesting depth, simulation year and (optionally) the resource unit.
+  The buffers are flushed once per year (Model::runYear(), when no worker threads are active) to a file in the
+  Chrome trace event format (load with chrome://tracing or https://ui.perfetto.dev) and aggregated
+  into a flat per-phase summary that is written when the model run stops.
+  When tracing is disabled (the default), a scope costs a single test of a static flag.
+
+  Settings (project file, system.settings.trace):
+  enabled: true/false
+  perResourceUnit: true: record also scopes on resource unit level (e.g. growth of each RU); default: false
+  file: file name of the trace file (default: trace.json in the 'temp' folder); the summary is written to the same name with "_summary.csv"
+  */
+class Tracer
+{
+public:
+    /// a single recorded scope
+    struct Event {
+        const char *name;
+        qint64 start; ///< ns since start of tracing
+        qint64 duration; ///< ns
+        int year;
+        int ru; ///< index of the resource unit (or -1)
+        int depth; ///< nesting level within the thread
+    };
+    /// buffer for a single thread
+    struct Buffer {
+        int thread_index;
+        int depth;
+        QVector<Event> events;
+    };
+
+    static bool enabled() { return mEnabled; }
+    static bool perResourceUnit() { return mEnabled && mPerResourceUnit; }
+    /// setup from the project file and start the clock
+    static void setup(const XmlHelper &xml);
+    /// returns a (persistent) pointer to a copy of 'name' (for names that are not string literals)
+    static const char *intern(const QString &name);
+    /// write all buffered events to the trace file and update the summary. Call only if no worker threads are active.
+    static void flush();
+    /// flush, close the trace file and write the summary. Tracing is disabled afterwards.
+    static void finalize();
+    /// total time (ms, summed over all threads) per scope name of all events flushed so far
+    static QHash<QString, double> totals();
+    /// get the buffer of the current thread (creates a buffer on first access)
+    static Buffer *threadBuffer();
+    static qint64 now() { return mClock.nsecsElapsed(); }
+private:
+    struct Summary {
+        int count;
+        double total_ms;
+        double max_ms;
+        int max_year;
+    };
+    static bool mEnabled;
+    static bool mPerResourceUnit;
+    static QElapsedTimer mClock;
+    static QList<Buffer*> mBuffers;
+    static QHash<QByteArray, const char*> mNames;
+    static QMap<QByteArray, Summary> mSummary;
+    static QFile *mFile;
+    static QString mFileName;
+    static bool mFirstEvent;
+};
+
+/** TraceScope records the time between construction and destruction as a span of the Tracer.
+  'name' is expected to be a string literal (or a string returned by Tracer::intern()).
+  A 'name' of nullptr disables the scope.
+  */
+class TraceScope
+{
+public:
+    TraceScope(const char *name, int ru=-1) { if (Tracer::enabled() && name) begin(name, ru); else mName=nullptr; }
+    TraceScope(const QString &name) { if (Tracer::enabled()) begin(Tracer::intern(name), -1); else mName=nullptr; }
+    ~TraceScope() { if (mName) end(); }
+private:
+    void begin(const char *name, int ru);
+    void end();
+    const char *mName;
+    Tracer::Buffer *mBuffer;
+    qint64 mStart;
+    int mRU;
+    int mYear;
+};
+
+#define TRACE_SCOPE(name) TraceScope trace_scope_(name)
+#define TRACE_SCOPE_RU(name, ru_index) TraceScope trace_scope_ru_(Tracer::perResourceUnit() ? name : nullptr, ru_index)
+
+#endif // TRACER_H